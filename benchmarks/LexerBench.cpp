@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "IncrementalLexer.h"
+#include "Lexer.h"
+#include "ParallelLexer.h"
+
+// Count all heap allocations made by the program so that the number of
+// allocations per token can be reported.
+static size_t allocationCount = 0;
+
+void* operator new(size_t size)
+{
+    ++allocationCount;
+    if (void* p = std::malloc(size == 0 ? 1 : size))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+// The corpora are generated from a fixed seed. The standard distributions
+// differ between library implementations, so a generator of our own is used
+// to get the same corpora everywhere.
+class Random
+{
+public:
+    explicit Random(uint32_t seed) : state(seed) {}
+
+    size_t next(size_t limit)
+    {
+        // xorshift32
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state % limit;
+    }
+
+private:
+    uint32_t state;
+};
+
+// Mixed statements as found in ordinary programs
+static void addProgram(std::string& corpus, size_t i, Random&)
+{
+    auto n = std::to_string(i);
+    corpus += "let value_" + n + " = fn(x, y) { return x * " + n + " + (y - 42) / 7; };\n";
+    corpus += "    if (value_" + n + "(1, 2) != 10) { true; } else { !false; };\n";
+}
+
+// Deeply nested arithmetic expressions
+static void addDeepArithmetic(std::string& corpus, size_t i, Random& random)
+{
+    static const char* operators[] = {" + ", " - ", " * ", " / "};
+    const size_t depth = 32;
+    corpus += "let r" + std::to_string(i) + " = ";
+    corpus.append(depth, '(');
+    corpus += std::to_string(random.next(1000));
+    for (size_t level = 0; level < depth; ++level)
+    {
+        corpus += operators[random.next(4)];
+        corpus += std::to_string(random.next(100000));
+        corpus += ')';
+    }
+    corpus += ";\n";
+}
+
+// Many short let statements
+static void addLets(std::string& corpus, size_t i, Random& random)
+{
+    corpus += "let a" + std::to_string(i) + " = " + std::to_string(random.next(1000000)) + ";\n";
+}
+
+// Identifiers of 32 to 128 characters
+static void addLongIdentifiers(std::string& corpus, size_t, Random& random)
+{
+    auto identifier = [&random]()
+    {
+        std::string name(32 + random.next(97), 'x');
+        for (auto& c : name)
+        {
+            auto r = random.next(27);
+            c = r == 26 ? '_' : static_cast<char>('a' + r);
+        }
+        return name;
+    };
+    corpus += "let " + identifier() + " = " + identifier() + "(" + identifier() + ");\n";
+}
+
+// Tokens separated by long runs of spaces, tabs and newlines
+static void addWhiteSpace(std::string& corpus, size_t, Random& random)
+{
+    static const char whiteSpace[] = {' ', ' ', ' ', '\t', '\n'};
+    static const char* tokens[] = {"let", "x", "=", "1", ";", "fn", "(", ")", "{", "}"};
+    corpus += tokens[random.next(std::size(tokens))];
+    for (size_t n = 4 + random.next(60); n > 0; --n)
+    {
+        corpus += whiteSpace[random.next(std::size(whiteSpace))];
+    }
+}
+
+struct Corpus
+{
+    const char* name;
+    std::function<void(std::string&, size_t, Random&)> add;
+};
+
+static std::string generate(const Corpus& corpus, size_t size)
+{
+    std::string text;
+    text.reserve(size + 4096);
+    Random random(2020);
+    for (size_t i = 0; text.size() < size; ++i)
+    {
+        corpus.add(text, i, random);
+    }
+    return text;
+}
+
+// Run the tokenizer a number of rounds over the source and print the average
+// as a JSON object
+template<typename Tokenizer>
+static void benchmark(const char* corpus, const std::string& mode, unsigned threads,
+                      const std::shared_ptr<const SourceBuffer>& source, Tokenizer tokenize, bool first)
+{
+    // Small sources are run more often to get a stable measurement
+    const int rounds = static_cast<int>(std::clamp<size_t>((64u << 20) / (source->size() + 1), 1, 100));
+    size_t tokens = 0;
+    size_t allocations = 0;
+    std::chrono::duration<double> elapsed {};
+    for (int round = 0; round < rounds; ++round)
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto allocationsBefore = allocationCount;
+        Lexer lexer(source);
+        tokens = tokenize(lexer);
+        allocations = allocationCount - allocationsBefore;
+        elapsed += std::chrono::steady_clock::now() - start;
+    }
+
+    auto seconds = elapsed.count() / rounds;
+    std::cout << (first ? "  " : ",\n  ")
+              << "{\"corpus\": \"" << corpus << "\""
+              << ", \"mode\": \"" << mode << "\""
+              << ", \"threads\": " << threads
+              << ", \"bytes\": " << source->size()
+              << ", \"tokens\": " << tokens
+              << ", \"tokens_per_sec\": " << static_cast<size_t>(tokens / seconds)
+              << ", \"bytes_per_sec\": " << static_cast<size_t>(source->size() / seconds)
+              << ", \"allocations_per_token\": " << static_cast<double>(allocations) / tokens
+              << "}" << std::flush;
+}
+
+// Insert a character at random places and remove it again, and report the
+// average time per edit
+static void benchmarkEdits(const char* corpus, const std::shared_ptr<const SourceBuffer>& source)
+{
+    const int edits = 1000;
+    IncrementalLexer lexer(source);
+    Random random(13);
+    std::chrono::duration<double> elapsed {};
+    for (int i = 0; i < edits; i += 2)
+    {
+        auto offset = random.next(source->size());
+        auto start = std::chrono::steady_clock::now();
+        lexer.apply({offset, 0, "x"});
+        lexer.apply({offset, 1, ""});
+        elapsed += std::chrono::steady_clock::now() - start;
+    }
+
+    std::cout << ",\n  {\"corpus\": \"" << corpus << "\""
+              << ", \"mode\": \"incrementalEdit\""
+              << ", \"bytes\": " << source->size()
+              << ", \"edits\": " << edits
+              << ", \"microseconds_per_edit\": " << elapsed.count() / edits * 1e6
+              << "}" << std::flush;
+}
+
+// Sizes may have a K or M suffix
+static size_t parseSize(const std::string& argument)
+{
+    size_t end;
+    size_t size = std::stoul(argument, &end);
+    if (end < argument.size())
+    {
+        switch (argument[end])
+        {
+            case 'k':
+            case 'K':
+                return size << 10;
+            case 'm':
+            case 'M':
+                return size << 20;
+            default:
+                throw std::invalid_argument(argument);
+        }
+    }
+    return size;
+}
+
+// Usage: lexer_bench [--threads N] [size...]
+int main(int argc, char *argv[])
+{
+    unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<size_t> sizes;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument(argv[i]);
+        if (argument == "--threads" && i + 1 < argc)
+        {
+            maxThreads = static_cast<unsigned>(std::stoul(argv[++i]));
+        }
+        else
+        {
+            sizes.push_back(parseSize(argument));
+        }
+    }
+    if (sizes.empty())
+    {
+        sizes = {64u << 10, 4u << 20, 64u << 20};
+    }
+
+    const Corpus corpora[] = {
+        {"program", addProgram},
+        {"deep_arithmetic", addDeepArithmetic},
+        {"lets", addLets},
+        {"long_identifiers", addLongIdentifiers},
+        {"white_space", addWhiteSpace},
+    };
+
+    bool first = true;
+    std::cout << "[\n";
+    for (const auto& corpus : corpora)
+    {
+        for (auto size : sizes)
+        {
+            auto source = std::make_shared<const SourceBuffer>(generate(corpus, size));
+
+            benchmark(corpus.name, "nextToken", 1, source, [](Lexer& lexer)
+            {
+                size_t tokens = 0;
+                while (lexer.nextToken() != nullptr)
+                {
+                    ++tokens;
+                }
+                return tokens;
+            }, first);
+            first = false;
+
+            benchmark(corpus.name, "tokenizeAll", 1, source, [](Lexer& lexer)
+            {
+                return lexer.tokenizeAll().size();
+            }, first);
+
+            for (unsigned threads = 2; threads <= maxThreads; ++threads)
+            {
+                benchmark(corpus.name, "parallel", threads, source, [&](Lexer&)
+                {
+                    return ParallelLexer::tokenize(source, threads).size();
+                }, first);
+            }
+
+            benchmarkEdits(corpus.name, source);
+        }
+    }
+    std::cout << "\n]" << std::endl;
+    return 0;
+}
@@ -0,0 +1,371 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include <algorithm>
+#include <filesystem>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "AstCache.h"
+#include "IncrementalLexer.h"
+#include "IncrementalParser.h"
+#include "Lexer.h"
+#include "Parser.h"
+
+// Count all heap allocations made by the program
+static size_t allocationCount = 0;
+
+void* operator new(size_t size)
+{
+    ++allocationCount;
+    if (void* p = std::malloc(size == 0 ? 1 : size))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+// Lines as typed into the REPL
+static const char* replLines[] = {
+    "5 + 5 * 2;",
+    "let x = 10;",
+    "if (x > 5) { true } else { false };",
+    "let add = fn(a, b) { a + b };",
+    "add(1, 2 * 3);",
+    "!(1 < 2) == false;",
+    "-(4 - 2) / 2;",
+    "return 42;",
+};
+
+static std::string generateProgram(size_t size)
+{
+    std::string text;
+    text.reserve(size + 256);
+    for (size_t i = 0; text.size() < size; ++i)
+    {
+        // Identifiers cannot contain digits, so the number is spelled in letters
+        auto n = std::to_string(i);
+        auto name = "value_" + n;
+        std::transform(n.begin(), n.end(), name.end() - n.size(), [](char c) { return c - '0' + 'a'; });
+        text += "let " + name + " = fn(x, y) { return x * " + n + " + (y - 42) / 7; };\n";
+        text += "if (" + name + "(1, 2) != 10) { true; } else { !false; };\n";
+    }
+    return text;
+}
+
+// One expression nested as deeply as the size allows, as emitted by code
+// generators
+static std::string generateDeepExpression(size_t size)
+{
+    auto depth = size / 32;
+    std::string text = "let r = ";
+    text.reserve(size + 256);
+    for (size_t i = 0; i < depth; ++i)
+    {
+        text += i % 2 == 0 ? "(1 + " : "-(2 * ";
+    }
+    text += "3";
+    text.append(depth, ')');
+    return text + ";\n";
+}
+
+// Statements with syntax errors, as found by bulk checks of broken files
+static const char* brokenStatements[] = {
+    "let = 5;\n",
+    "let x 5;\n",
+    "(3 + 4;\n",
+    "5 + * 2;\n",
+    "add(1, 2;\n",
+    "let y = 99999999999999999999;\n",
+    "let z = x * (y - 1);\n",
+};
+
+static std::string generateBrokenProgram(size_t size)
+{
+    std::string text;
+    text.reserve(size + 256);
+    for (size_t i = 0; text.size() < size; ++i)
+    {
+        text += brokenStatements[i % std::size(brokenStatements)];
+    }
+    return text;
+}
+
+// Parse each line with a lexer and parser of its own, as the REPL does, and
+// report the average time per line
+static void benchmarkReplLines()
+{
+    const int rounds = 20000;
+    size_t allocations = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round)
+    {
+        for (const char* line : replLines)
+        {
+            auto allocationsBefore = allocationCount;
+            Lexer lexer(line);
+            Parser parser(lexer);
+            auto program = parser.parseProgram();
+            allocations += allocationCount - allocationsBefore;
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    auto lines = static_cast<double>(rounds) * std::size(replLines);
+    std::cout << "  {\"mode\": \"replLine\""
+              << ", \"lines\": " << static_cast<size_t>(lines)
+              << ", \"microseconds_per_line\": " << elapsed.count() / lines * 1e6
+              << ", \"allocations_per_line\": " << allocations / lines
+              << "}" << std::flush;
+}
+
+// A threads count of 0 parses sequentially
+static void benchmarkProgram(const char* mode, const std::string& text, unsigned threads = 0)
+{
+    auto source = std::make_shared<const SourceBuffer>(text);
+    const int rounds = static_cast<int>(std::clamp<size_t>((64u << 20) / (source->size() + 1), 1, 100));
+    size_t statements = 0;
+    size_t errors = 0;
+    std::chrono::duration<double> elapsed {};
+    for (int round = 0; round < rounds; ++round)
+    {
+        auto start = std::chrono::steady_clock::now();
+        Lexer lexer(source);
+        Parser parser(lexer);
+        auto program = threads == 0 ? parser.parseProgram() : parser.parseProgramInParallel(threads);
+        statements = program->statements.size();
+        errors = parser.errors.size();
+        elapsed += std::chrono::steady_clock::now() - start;
+    }
+
+    auto seconds = elapsed.count() / rounds;
+    std::cout << ",\n  {\"mode\": \"" << mode << "\""
+              << ", \"threads\": " << std::max(threads, 1u)
+              << ", \"bytes\": " << source->size()
+              << ", \"statements\": " << statements
+              << ", \"errors\": " << errors
+              << ", \"bytes_per_sec\": " << static_cast<size_t>(source->size() / seconds)
+              << "}" << std::flush;
+}
+
+// Parse without building the program, as a syntax check does, and report the
+// allocations made per statement on top of the speed
+static void benchmarkCheck(const std::string& text)
+{
+    auto source = std::make_shared<const SourceBuffer>(text);
+    const int rounds = static_cast<int>(std::clamp<size_t>((64u << 20) / (source->size() + 1), 1, 100));
+    size_t statements = 0;
+    size_t allocations = 0;
+    std::chrono::duration<double> elapsed {};
+    for (int round = 0; round < rounds; ++round)
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto allocationsBefore = allocationCount;
+        Lexer lexer(source);
+        Parser parser(lexer);
+        parser.setCheckOnly(true);
+        parser.parseProgram();
+        allocations = allocationCount - allocationsBefore;
+        elapsed += std::chrono::steady_clock::now() - start;
+    }
+    {
+        Lexer lexer(source);
+        Parser parser(lexer);
+        statements = parser.parseProgram()->statements.size();
+    }
+
+    auto seconds = elapsed.count() / rounds;
+    std::cout << ",\n  {\"mode\": \"check\""
+              << ", \"bytes\": " << source->size()
+              << ", \"statements\": " << statements
+              << ", \"bytes_per_sec\": " << static_cast<size_t>(source->size() / seconds)
+              << ", \"allocations_per_statement\": " << static_cast<double>(allocations) / std::max<size_t>(statements, 1)
+              << "}" << std::flush;
+}
+
+// Parse with function bodies left lazy, and report the arena bytes used on top
+// of the speed, next to those of a full parse
+static void benchmarkLazy(const std::string& text)
+{
+    auto source = std::make_shared<const SourceBuffer>(text);
+    const int rounds = static_cast<int>(std::clamp<size_t>((64u << 20) / (source->size() + 1), 1, 100));
+    size_t statements = 0;
+    size_t arenaBytes = 0;
+    size_t lazyBodies = 0;
+    std::chrono::duration<double> elapsed {};
+    for (int round = 0; round < rounds; ++round)
+    {
+        auto start = std::chrono::steady_clock::now();
+        Lexer lexer(source);
+        Parser parser(lexer);
+        parser.setLazyFunctionBodies(true);
+        auto program = parser.parseProgram();
+        elapsed += std::chrono::steady_clock::now() - start;
+        statements = program->statements.size();
+        arenaBytes = program->arena.bytesUsed();
+        lazyBodies = program->lazyBodies.size();
+    }
+    size_t fullArenaBytes;
+    {
+        Lexer lexer(source);
+        Parser parser(lexer);
+        fullArenaBytes = parser.parseProgram()->arena.bytesUsed();
+    }
+
+    auto seconds = elapsed.count() / rounds;
+    std::cout << ",\n  {\"mode\": \"lazyProgram\""
+              << ", \"bytes\": " << source->size()
+              << ", \"statements\": " << statements
+              << ", \"lazy_bodies\": " << lazyBodies
+              << ", \"bytes_per_sec\": " << static_cast<size_t>(source->size() / seconds)
+              << ", \"arena_bytes\": " << arenaBytes
+              << ", \"full_arena_bytes\": " << fullArenaBytes
+              << "}" << std::flush;
+}
+
+// Read the program back from an AST cache in a temporary directory, in place
+// of lexing and parsing it
+static void benchmarkCacheLoad(const std::string& text)
+{
+    auto directory = std::filesystem::temp_directory_path() / ("parser_bench_cache." + std::to_string(getpid()));
+    SourceBuffer source(text);
+    AstCache cache(directory.string());
+    {
+        Lexer lexer(text.c_str());
+        Parser parser(lexer);
+        cache.store(source, *parser.parseProgram());
+    }
+
+    const int rounds = static_cast<int>(std::clamp<size_t>((64u << 20) / (source.size() + 1), 1, 100));
+    size_t statements = 0;
+    std::chrono::duration<double> elapsed {};
+    for (int round = 0; round < rounds; ++round)
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto program = cache.load(source);
+        statements = program ? program->statements.size() : 0;
+        elapsed += std::chrono::steady_clock::now() - start;
+    }
+    std::filesystem::remove_all(directory);
+
+    auto seconds = elapsed.count() / rounds;
+    std::cout << ",\n  {\"mode\": \"cacheLoad\""
+              << ", \"bytes\": " << source.size()
+              << ", \"statements\": " << statements
+              << ", \"bytes_per_sec\": " << static_cast<size_t>(source.size() / seconds)
+              << "}" << std::flush;
+}
+
+// Change one number in the middle of the program back and forth, and report
+// the average time of the incremental parser per edit, without the lexer
+static void benchmarkIncrementalEdit(const std::string& text)
+{
+    IncrementalLexer lexer(std::make_shared<const SourceBuffer>(text));
+    IncrementalParser parser(lexer.getTokens());
+    auto offset = text.find("42", text.size() / 2);
+
+    const int rounds = 200;
+    size_t reparsed = 0;
+    std::chrono::duration<double> elapsed {};
+    for (int round = 0; round < rounds; ++round)
+    {
+        auto change = lexer.apply({offset, 2, round % 2 == 0 ? "43" : "42"});
+        auto start = std::chrono::steady_clock::now();
+        reparsed += parser.update(lexer.getTokens(), change);
+        elapsed += std::chrono::steady_clock::now() - start;
+    }
+
+    std::cout << ",\n  {\"mode\": \"incrementalEdit\""
+              << ", \"bytes\": " << text.size()
+              << ", \"statements\": " << parser.getProgram()->statements.size()
+              << ", \"statements_reparsed_per_edit\": " << static_cast<double>(reparsed) / rounds
+              << ", \"microseconds_per_edit\": " << elapsed.count() / rounds * 1e6
+              << "}" << std::flush;
+}
+
+// Sizes may have a K or M suffix
+static size_t parseSize(const std::string& argument)
+{
+    size_t end;
+    size_t size = std::stoul(argument, &end);
+    if (end < argument.size())
+    {
+        switch (argument[end])
+        {
+            case 'k':
+            case 'K':
+                return size << 10;
+            case 'm':
+            case 'M':
+                return size << 20;
+            default:
+                throw std::invalid_argument(argument);
+        }
+    }
+    return size;
+}
+
+// Usage: parser_bench [--threads N] [size...]
+int main(int argc, char *argv[])
+{
+    unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<size_t> sizes;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument(argv[i]);
+        if (argument == "--threads" && i + 1 < argc)
+        {
+            maxThreads = static_cast<unsigned>(std::stoul(argv[++i]));
+        }
+        else
+        {
+            sizes.push_back(parseSize(argument));
+        }
+    }
+    if (sizes.empty())
+    {
+        sizes = {64u << 10, 4u << 20};
+    }
+
+    std::cout << "[\n";
+    benchmarkReplLines();
+    for (auto size : sizes)
+    {
+        auto program = generateProgram(size);
+        benchmarkProgram("program", program);
+        for (unsigned threads = 2; threads <= maxThreads; ++threads)
+        {
+            benchmarkProgram("parallelProgram", program, threads);
+        }
+        benchmarkCheck(program);
+        benchmarkLazy(program);
+        benchmarkCacheLoad(program);
+        benchmarkIncrementalEdit(program);
+        benchmarkProgram("brokenProgram", generateBrokenProgram(size));
+        benchmarkProgram("deepExpression", generateDeepExpression(size));
+    }
+    std::cout << "\n]" << std::endl;
+    return 0;
+}
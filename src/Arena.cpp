@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include "Arena.h"
+
+Arena::Arena() :
+        freeSpace(nullptr),
+        freeSize(0),
+        nextBlockSize(firstBlockSize),
+        allocated(0),
+        used(0),
+        destructors(nullptr) {}
+
+// Objects are destroyed in the reverse order of their creation
+Arena::~Arena()
+{
+    for (auto destructor = destructors; destructor != nullptr; destructor = destructor->next)
+    {
+        destructor->destroy(destructor->object);
+    }
+}
+
+void* Arena::allocate(size_t size, size_t alignment)
+{
+    auto padding = (alignment - reinterpret_cast<uintptr_t>(freeSpace) % alignment) % alignment;
+    if (freeSpace == nullptr || padding + size > freeSize)
+    {
+        addBlock(size + alignment);
+        padding = (alignment - reinterpret_cast<uintptr_t>(freeSpace) % alignment) % alignment;
+    }
+    auto result = freeSpace + padding;
+    freeSpace += padding + size;
+    freeSize -= padding + size;
+    used += padding + size;
+    return result;
+}
+
+void Arena::adopt(Arena& other)
+{
+    for (auto& block : other.blocks)
+    {
+        blocks.push_back(std::move(block));
+    }
+    allocated += other.allocated;
+    used += other.used;
+
+    // The adopted objects are destroyed first
+    if (other.destructors != nullptr)
+    {
+        auto last = other.destructors;
+        while (last->next != nullptr)
+        {
+            last = last->next;
+        }
+        last->next = destructors;
+        destructors = other.destructors;
+    }
+
+    other.blocks.clear();
+    other.freeSpace = nullptr;
+    other.freeSize = 0;
+    other.allocated = 0;
+    other.used = 0;
+    other.destructors = nullptr;
+}
+
+size_t Arena::blockCount() const
+{
+    return blocks.size();
+}
+
+size_t Arena::bytesAllocated() const
+{
+    return allocated;
+}
+
+size_t Arena::bytesUsed() const
+{
+    return used;
+}
+
+void Arena::addBlock(size_t minimumSize)
+{
+    auto size = std::max(nextBlockSize, minimumSize);
+    blocks.emplace_back(new char[size]);
+    freeSpace = blocks.back().get();
+    freeSize = size;
+    allocated += size;
+    nextBlockSize = std::min(nextBlockSize * 2, maxBlockSize);
+}
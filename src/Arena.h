@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#ifndef INTERPRETER_ARENA_H
+#define INTERPRETER_ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// A bump allocator. Objects are placed one after the other in large blocks and
+// are all released together when the arena is destroyed. The blocks double in
+// size up to maxBlockSize, so a large tree takes only a few of them.
+//
+// Objects with a trivial destructor cost nothing to release. The destructors
+// of other objects are recorded in a list (also kept in the blocks) and run
+// when the arena is destroyed.
+class Arena
+{
+public:
+    Arena();
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    ~Arena();
+
+    template<typename T, typename... Args>
+    T* create(Args&&... args);
+
+    // For objects whose destructor is known to have no effect, e.g. because
+    // the resources it would release are held elsewhere
+    template<typename T, typename... Args>
+    T* createWithoutDestructor(Args&&... args);
+
+    // Copy the elements into the arena
+    template<typename T>
+    T* copyArray(const T* elements, size_t count);
+
+    void* allocate(size_t size, size_t alignment);
+
+    // Take over the blocks and objects of the other arena, which is left
+    // empty. The objects keep their addresses.
+    void adopt(Arena& other);
+
+    size_t blockCount() const;
+    size_t bytesAllocated() const;
+    // The bytes handed out, including alignment padding
+    size_t bytesUsed() const;
+
+private:
+    static constexpr size_t firstBlockSize = 16 * 1024;
+    static constexpr size_t maxBlockSize = 16 * 1024 * 1024;
+
+    struct Destructor
+    {
+        void (*destroy)(void*);
+        void* object;
+        Destructor* next;
+    };
+
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char* freeSpace;
+    size_t freeSize;
+    size_t nextBlockSize;
+    size_t allocated;
+    size_t used;
+    Destructor* destructors;
+
+    void addBlock(size_t minimumSize);
+};
+
+template<typename T, typename... Args>
+T* Arena::create(Args&&... args)
+{
+    T* object = createWithoutDestructor<T>(std::forward<Args>(args)...);
+    if constexpr (!std::is_trivially_destructible_v<T>)
+    {
+        auto destructor = static_cast<Destructor*>(allocate(sizeof(Destructor), alignof(Destructor)));
+        destructor->destroy = [](void* p) { static_cast<T*>(p)->~T(); };
+        destructor->object = object;
+        destructor->next = destructors;
+        destructors = destructor;
+    }
+    return object;
+}
+
+template<typename T, typename... Args>
+T* Arena::createWithoutDestructor(Args&&... args)
+{
+    return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+}
+
+template<typename T>
+T* Arena::copyArray(const T* elements, size_t count)
+{
+    static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>,
+                  "Only plain elements can be copied into the arena");
+    if (count == 0)
+    {
+        return nullptr;
+    }
+    auto copy = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    std::uninitialized_copy(elements, elements + count, copy);
+    return copy;
+}
+
+#endif //INTERPRETER_ARENA_H
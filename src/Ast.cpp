@@ -6,17 +6,20 @@
  *
  */
 
+#include <algorithm>
+#include <cstdint>
+#include <utility>
 #include "Ast.h"
+#include "SourceBuffer.h"
 
 // Identifier
-Identifier::Identifier(std::unique_ptr<Token> token) : token(std::move(token))
-{
-    value = this->token->literal;
-}
+Identifier::Identifier(std::string_view value, uint32_t symbol) :
+        symbol(symbol),
+        value(value) {}
 
 std::string Identifier::string()
 {
-    return std::string(*value);
+    return std::string(value);
 }
 
 void Identifier::accept(AstVisitor &visitor)
@@ -25,10 +28,8 @@ void Identifier::accept(AstVisitor &visitor)
 }
 
 // Integer
-Integer::Integer(std::unique_ptr<Token> token) : token(std::move(token))
-{
-    value = 0;
-}
+Integer::Integer(int64_t value) :
+        value(value) {}
 
 std::string Integer::string()
 {
@@ -41,8 +42,7 @@ void Integer::accept(AstVisitor &visitor)
 }
 
 // Boolean
-Boolean::Boolean(std::unique_ptr<Token> token, bool value) :
-        token(std::move(token)),
+Boolean::Boolean(bool value) :
         value{value} {}
 
 std::string Boolean::string()
@@ -56,12 +56,23 @@ void Boolean::accept(AstVisitor &visitor)
 }
 
 // Function
-Function::Function(std::unique_ptr<Token> token) :
-        token(std::move(token)) {}
+Function::Function() :
+        body(nullptr),
+        lazyBody(nullptr) {}
+
+Statement* Function::getBody()
+{
+    if (lazyBody != nullptr)
+    {
+        body = lazyBody->parse(*lazyBody);
+        lazyBody = nullptr;
+    }
+    return body;
+}
 
 std::string Function::string()
 {
-    auto expression = std::string(*token->literal + "(");
+    auto expression = std::string("fn(");
     for (const auto& parameter: parameters)
     {
         expression += parameter->string();
@@ -71,7 +82,7 @@ std::string Function::string()
         }
     }
     expression += ") { ";
-    expression += body->string();
+    expression += getBody()->string();
     expression += " }";
 
     return expression;
@@ -83,8 +94,7 @@ void Function::accept(AstVisitor &visitor)
 }
 
 // CallExpression
-CallExpression::CallExpression(std::unique_ptr<Token> token) :
-        token(std::move(token)),
+CallExpression::CallExpression() :
         function(nullptr) {}
 
 std::string CallExpression::string()
@@ -108,13 +118,13 @@ void CallExpression::accept(AstVisitor &visitor)
 }
 
 // PrefixExpression
-PrefixExpression::PrefixExpression(std::unique_ptr<Token> token) :
-        token(std::move(token)),
+PrefixExpression::PrefixExpression(Token::TokenType op) :
+        op(op),
         right{nullptr} {}
 
 std::string PrefixExpression::string()
 {
-    return std::string("(" + op + right->string() + ")");
+    return "(" + std::string(Token::getLiteral(op)) + right->string() + ")";
 }
 
 void PrefixExpression::accept(AstVisitor &visitor)
@@ -123,14 +133,14 @@ void PrefixExpression::accept(AstVisitor &visitor)
 }
 
 // InfixExpression
-InfixExpression::InfixExpression(std::unique_ptr<Token> token) :
+InfixExpression::InfixExpression(Token::TokenType op) :
+        op(op),
         left{nullptr},
-        token(std::move(token)),
         right{nullptr} {}
 
 std::string InfixExpression::string()
 {
-    return std::string("(" + left->string() + " " + op + " " + right->string() + ")");
+    return "(" + left->string() + " " + std::string(Token::getLiteral(op)) + " " + right->string() + ")";
 }
 
 void InfixExpression::accept(AstVisitor &visitor)
@@ -139,16 +149,15 @@ void InfixExpression::accept(AstVisitor &visitor)
 }
 
 // IfExpression
-IfExpression::IfExpression(std::unique_ptr<Token> token) :
-        token(std::move(token)),
+IfExpression::IfExpression() :
         condition(nullptr),
         consequence(nullptr),
         alternative(nullptr) {}
 
 std::string IfExpression::string()
 {
-    auto expression = std::string(*token->literal + " " + condition->string() + " { " +
-                                  consequence->string() + " }");
+    auto expression = "if " + condition->string() + " { " +
+                      consequence->string() + " }";
     if(alternative != nullptr)
     {
         expression += " else { " + alternative->string() + " }";
@@ -164,15 +173,13 @@ void IfExpression::accept(AstVisitor &visitor)
 }
 
 // Statements
-LetStatement::LetStatement() : token(nullptr), identifier(nullptr), expression(nullptr) {}
-LetStatement::LetStatement(std::unique_ptr<Token> token) :
-        token(std::move(token)),
+LetStatement::LetStatement() :
         identifier(nullptr),
         expression(nullptr) {}
 
 std::string LetStatement::string()
 {
-    std::string statement = *(token->literal) + " ";
+    std::string statement = "let ";
     statement += identifier->string();
     statement += " = ";
     if (expression != nullptr)
@@ -188,14 +195,12 @@ void LetStatement::accept(AstVisitor &visitor)
     visitor.visitLetStatement(*this);
 }
 
-ReturnStatement::ReturnStatement() : token(nullptr), expression(nullptr) {}
-ReturnStatement::ReturnStatement(std::unique_ptr<Token> token) :
-        token(std::move(token)),
+ReturnStatement::ReturnStatement() :
         expression(nullptr) {}
 
 std::string ReturnStatement::string()
 {
-    std::string statement = *(token->literal) + " ";
+    std::string statement = "return ";
     if (expression != nullptr)
     {
         statement += expression->string();
@@ -210,7 +215,9 @@ void ReturnStatement::accept(AstVisitor &visitor)
 }
 
 // Expressions
-ExpressionStatement::ExpressionStatement() : expression(nullptr) {}
+ExpressionStatement::ExpressionStatement() :
+        expression(nullptr) {}
+
 std::string ExpressionStatement::string()
 {
     std::string statement;
@@ -227,6 +234,8 @@ void ExpressionStatement::accept(AstVisitor &visitor)
 }
 
 // BlockStatement
+BlockStatement::BlockStatement() = default;
+
 std::string BlockStatement::string()
 {
     std::string block;
@@ -242,10 +251,403 @@ void BlockStatement::accept(AstVisitor &visitor)
     visitor.visitBlockStatement(*this);
 }
 
+namespace
+{
+    // Copies trees into the arena of a program without recursion. The nodes
+    // are first listed in depth-first order. Walking the list backwards meets
+    // the children of each node before the node, and leaves the copies of the
+    // children on a stack with the first child on top.
+    //
+    // Also records which of the given sources the copied nodes point into, and
+    // the copies of the block statements if asked to.
+    class Copier : public AstVisitor
+    {
+    public:
+        Copier(Program& target, const std::vector<std::shared_ptr<const SourceBuffer>>& sources,
+               std::unordered_map<const BlockStatement*, BlockStatement*>* blockCopies) :
+                target(target),
+                used(sources.size(), false),
+                blockCopies(blockCopies)
+        {
+            for (size_t i = 0; i < sources.size(); ++i)
+            {
+                starts.emplace_back(reinterpret_cast<uintptr_t>(sources[i]->data()), i);
+                buffers.push_back(sources[i].get());
+            }
+            std::sort(starts.begin(), starts.end());
+        }
+
+        Statement* copy(Statement* statement)
+        {
+            pending.push_back(statement);
+            while (!pending.empty())
+            {
+                auto node = pending.back();
+                pending.pop_back();
+                order.push_back(node);
+                node->accept(*this);
+            }
+            building = true;
+            for (auto node = order.rbegin(); node != order.rend(); ++node)
+            {
+                (*node)->accept(*this);
+            }
+            building = false;
+            order.clear();
+            return take(statement);
+        }
+
+        bool isUsed(size_t source) const
+        {
+            return used[source];
+        }
+
+        void visitIdentifier(Identifier& identifier) override
+        {
+            if (building)
+            {
+                useText(identifier.value.data());
+                results.push_back(target.create<Identifier>(identifier.value, identifier.symbol));
+            }
+        }
+
+        void visitInteger(Integer& integer) override
+        {
+            if (building)
+            {
+                results.push_back(target.create<Integer>(integer.value));
+            }
+        }
+
+        void visitBoolean(Boolean& boolean) override
+        {
+            if (building)
+            {
+                results.push_back(target.create<Boolean>(boolean.value));
+            }
+        }
+
+        void visitFunction(Function& function) override
+        {
+            if (!building)
+            {
+                list(function.body);
+                listAll(function.parameters);
+                return;
+            }
+            auto copy = target.create<Function>();
+            copy->parameters = takeAll(function.parameters);
+            copy->body = take(function.body);
+            if (function.lazyBody != nullptr)
+            {
+                copy->lazyBody = target.arena.create<LazyBody>(*function.lazyBody);
+                copy->lazyBody->program = &target;
+                target.lazyBodies.push_back(copy->lazyBody);
+                useSource(function.lazyBody->source);
+            }
+            results.push_back(copy);
+        }
+
+        void visitCallExpression(CallExpression& expression) override
+        {
+            if (!building)
+            {
+                listAll(expression.arguments);
+                list(expression.function);
+                return;
+            }
+            auto copy = target.create<CallExpression>();
+            copy->function = take(expression.function);
+            copy->arguments = takeAll(expression.arguments);
+            results.push_back(copy);
+        }
+
+        void visitPrefixExpression(PrefixExpression& expression) override
+        {
+            if (!building)
+            {
+                list(expression.right);
+                return;
+            }
+            auto copy = target.create<PrefixExpression>(static_cast<Token::TokenType>(expression.op));
+            copy->right = take(expression.right);
+            results.push_back(copy);
+        }
+
+        void visitInfixExpression(InfixExpression& expression) override
+        {
+            if (!building)
+            {
+                list(expression.right);
+                list(expression.left);
+                return;
+            }
+            auto copy = target.create<InfixExpression>(static_cast<Token::TokenType>(expression.op));
+            copy->left = take(expression.left);
+            copy->right = take(expression.right);
+            results.push_back(copy);
+        }
+
+        void visitIfExpression(IfExpression& expression) override
+        {
+            if (!building)
+            {
+                list(expression.alternative);
+                list(expression.consequence);
+                list(expression.condition);
+                return;
+            }
+            auto copy = target.create<IfExpression>();
+            copy->condition = take(expression.condition);
+            copy->consequence = take(expression.consequence);
+            copy->alternative = take(expression.alternative);
+            results.push_back(copy);
+        }
+
+        void visitLetStatement(LetStatement& statement) override
+        {
+            if (!building)
+            {
+                list(statement.expression);
+                list(statement.identifier);
+                return;
+            }
+            auto copy = target.create<LetStatement>();
+            copy->identifier = take(statement.identifier);
+            copy->expression = take(statement.expression);
+            results.push_back(copy);
+        }
+
+        void visitReturnStatement(ReturnStatement& statement) override
+        {
+            if (!building)
+            {
+                list(statement.expression);
+                return;
+            }
+            auto copy = target.create<ReturnStatement>();
+            copy->expression = take(statement.expression);
+            results.push_back(copy);
+        }
+
+        void visitExpressionStatement(ExpressionStatement& statement) override
+        {
+            if (!building)
+            {
+                list(statement.expression);
+                return;
+            }
+            auto copy = target.create<ExpressionStatement>();
+            copy->expression = take(statement.expression);
+            results.push_back(copy);
+        }
+
+        void visitBlockStatement(BlockStatement& statement) override
+        {
+            if (!building)
+            {
+                listAll(statement.statements);
+                return;
+            }
+            auto copy = target.create<BlockStatement>();
+            copy->statements = takeAll(statement.statements);
+            if (blockCopies != nullptr)
+            {
+                (*blockCopies)[&statement] = copy;
+            }
+            results.push_back(copy);
+        }
+
+        void visitProgram(Program&) override {}
+        void visitControlToken(ControlToken&) override {}
+
+    private:
+        Program& target;
+        std::vector<std::pair<uintptr_t, size_t>> starts;
+        std::vector<const SourceBuffer*> buffers;
+        std::vector<bool> used;
+        std::unordered_map<const BlockStatement*, BlockStatement*>* blockCopies;
+        std::vector<Node*> pending;
+        std::vector<Node*> order;
+        std::vector<Node*> results;
+        bool building = false;
+
+        // The children are listed in the reverse of the order they are taken in
+        void list(Node* node)
+        {
+            if (node != nullptr)
+            {
+                pending.push_back(node);
+            }
+        }
+
+        template<typename T>
+        void listAll(const NodeList<T>& nodes)
+        {
+            for (auto node = nodes.rbegin(); node != nodes.rend(); ++node)
+            {
+                list(*node);
+            }
+        }
+
+        template<typename T>
+        T* take(T* original)
+        {
+            if (original == nullptr)
+            {
+                return nullptr;
+            }
+            auto copy = results.back();
+            results.pop_back();
+            return static_cast<T*>(copy);
+        }
+
+        template<typename T>
+        NodeList<T> takeAll(const NodeList<T>& nodes)
+        {
+            if (nodes.empty())
+            {
+                return NodeList<T>();
+            }
+            auto items = static_cast<T**>(target.arena.allocate(sizeof(T*) * nodes.size(), alignof(T*)));
+            for (size_t i = 0; i < nodes.size(); ++i)
+            {
+                items[i] = take(nodes[i]);
+            }
+            return NodeList<T>(items, nodes.size());
+        }
+
+        // Names read back from a cache point into the symbol table instead
+        void useText(const char* text)
+        {
+            auto address = reinterpret_cast<uintptr_t>(text);
+            auto next = std::upper_bound(starts.begin(), starts.end(), std::make_pair(address, SIZE_MAX));
+            if (next != starts.begin())
+            {
+                auto source = (next - 1)->second;
+                if (address <= (next - 1)->first + buffers[source]->size())
+                {
+                    used[source] = true;
+                }
+            }
+        }
+
+        void useSource(const SourceBuffer* source)
+        {
+            auto found = std::find(buffers.begin(), buffers.end(), source);
+            if (found != buffers.end())
+            {
+                used[found - buffers.begin()] = true;
+            }
+        }
+    };
+}
+
 // Program
-void Program::addStatement(std::shared_ptr<Statement> statement)
+void Program::addStatement(Statement* statement)
+{
+    statements.push_back(statement);
+}
+
+void Program::append(Program& other)
+{
+    splice(statements.size(), 0, other);
+}
+
+// An edit mostly replaces as many statements as there were, which is done in
+// place so that the statements after them are not moved
+void Program::splice(size_t first, size_t count, Program& other)
+{
+    if (other.statements.size() == count)
+    {
+        std::copy(other.statements.begin(), other.statements.end(), statements.begin() + first);
+    }
+    else
+    {
+        auto position = statements.erase(statements.begin() + first, statements.begin() + first + count);
+        statements.insert(position, other.statements.begin(), other.statements.end());
+    }
+    other.statements.clear();
+    adopt(other);
+}
+
+// The list of a block is in the arena and belongs to the block alone, so it
+// is written in place if it keeps its size
+void Program::splice(BlockStatement& block, size_t first, size_t count, Program& other)
+{
+    const auto& added = other.statements;
+    auto& list = block.statements;
+    if (added.size() == count)
+    {
+        std::copy(added.begin(), added.end(), const_cast<Statement**>(list.begin()) + first);
+    }
+    else
+    {
+        auto size = list.size() - count + added.size();
+        auto items = static_cast<Statement**>(arena.allocate(sizeof(Statement*) * size, alignof(Statement*)));
+        std::copy(list.begin(), list.begin() + first, items);
+        std::copy(added.begin(), added.end(), items + first);
+        std::copy(list.begin() + first + count, list.end(), items + first + added.size());
+        list = NodeList<Statement>(items, size);
+    }
+    other.statements.clear();
+    adopt(other);
+}
+
+// Take over the nodes, sources and lazy bodies of the other program
+void Program::adopt(Program& other)
+{
+    arena.adopt(other.arena);
+    for (auto& source : other.sources)
+    {
+        if (std::find(sources.begin(), sources.end(), source) == sources.end())
+        {
+            sources.push_back(std::move(source));
+        }
+    }
+    other.sources.clear();
+    for (auto lazyBody : other.lazyBodies)
+    {
+        lazyBody->program = this;
+        lazyBodies.push_back(lazyBody);
+    }
+    other.lazyBodies.clear();
+    bodyDiagnostics.insert(bodyDiagnostics.end(), other.bodyDiagnostics.begin(), other.bodyDiagnostics.end());
+    other.bodyDiagnostics.clear();
+}
+
+// The old nodes are released with the old arena at the end
+void Program::compact(std::unordered_map<const BlockStatement*, BlockStatement*>* blockCopies)
 {
-    statements.push_back(std::move(statement));
+    Arena old;
+    old.adopt(arena);
+    lazyBodies.clear();
+
+    Copier copier(*this, sources, blockCopies);
+    for (auto& statement : statements)
+    {
+        statement = copier.copy(statement);
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+        if (copier.isUsed(i))
+        {
+            sources[kept++] = std::move(sources[i]);
+        }
+    }
+    sources.resize(kept);
+}
+
+// Nodes of one program mostly come from the same source, so only a change
+// from the last one is recorded
+void Program::keepSource(const std::shared_ptr<const SourceBuffer>& source)
+{
+    if (source != nullptr && (sources.empty() || sources.back() != source))
+    {
+        sources.push_back(source);
+    }
 }
 
 std::string Program::string()
@@ -9,134 +9,191 @@
 #ifndef INTERPRETER_AST_H
 #define INTERPRETER_AST_H
 
+#include <iterator>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
+#include "Arena.h"
 #include "Token.h"
 #include "Object.h"
 #include "AstVisitor.h"
 
+class Program;
+class SourceBuffer;
+class SymbolTable;
+class Statement;
+class BlockStatement;
+
+// Nodes are allocated in the arena of the Program they belong to. Child nodes
+// are referred to by plain pointers. The destructors of the nodes do nothing,
+// so releasing the arena does not need to visit the tree.
+//
+// Nodes keep no tokens or source positions. Operators are kept as their token
+// type, and the text of keywords and operators follows from the type of the
+// node or operator.
 class Node
 {
 public:
-    virtual ~Node() = default;
     virtual std::string string() = 0;
     virtual void accept(AstVisitor&) = 0;
+
+protected:
+    Node() = default;
+    ~Node() = default;
 };
 
-class Expression : public Node
+// A list of child nodes, stored in the arena
+template<typename T>
+class NodeList
 {
 public:
-    ~Expression() override = default;
+    NodeList() : items(nullptr), count(0) {}
+    NodeList(T* const* items, size_t count) : items(items), count(count) {}
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T* operator[](size_t index) const { return items[index]; }
+    T* front() const { return items[0]; }
+    T* back() const { return items[count - 1]; }
+    T* const* begin() const { return items; }
+    T* const* end() const { return items + count; }
+    std::reverse_iterator<T* const*> rbegin() const { return std::reverse_iterator<T* const*>(end()); }
+    std::reverse_iterator<T* const*> rend() const { return std::reverse_iterator<T* const*>(begin()); }
+
+private:
+    T* const* items;
+    size_t count;
+};
+
+class Expression : public Node
+{
+protected:
+    Expression() = default;
 };
 
 class Statement : public Node
 {
-public:
-    ~Statement() override = default;
+protected:
+    Statement() = default;
 };
 
+// The fields of the nodes are ordered so that small ones fill the space after
+// the vtable pointer
+
 class Identifier : public Expression
 {
 public:
-    explicit Identifier(std::unique_ptr<Token> token);
-    ~Identifier() override = default;
+    Identifier(std::string_view value, uint32_t symbol);
     std::string string() override;
     void accept(AstVisitor&) override;
 
-    std::shared_ptr<Token> token;
-    std::shared_ptr<std::string> value;
+    // The symbol of the name in the symbol table of the lexer
+    uint32_t symbol;
+    // A view into the source, which the program keeps alive
+    std::string_view value;
 };
 
 class Integer : public Expression
 {
 public:
-    explicit Integer(std::unique_ptr<Token> token);
-    ~Integer() override = default;
+    explicit Integer(int64_t value);
     std::string string() override;
     void accept(AstVisitor&) override;
 
-    std::shared_ptr<Token> token;
     int64_t value;
 };
 
 class Boolean : public Expression
 {
 public:
-    explicit Boolean(std::unique_ptr<Token> token, bool value);
-    ~Boolean() override = default;
+    explicit Boolean(bool value);
     std::string string() override;
     void accept(AstVisitor&) override;
 
-    std::shared_ptr<Token> token;
     bool value;
 };
 
+// The body of a function whose braces have only been matched, to be parsed
+// when it is first needed. It is parsed by the parse function that the parser
+// left, with the nodes in the program of the function.
+struct LazyBody
+{
+    // Kept up to date when the program is spliced into another one
+    Program* program;
+    // Kept alive by the program
+    const SourceBuffer* source;
+    SymbolTable* symbols;
+    // The offsets in the source of the first character after the opening
+    // brace and of the closing brace
+    size_t first;
+    size_t end;
+    Statement* (*parse)(const LazyBody&);
+};
+
 class Function : public Expression
 {
 public:
-    explicit Function(std::unique_ptr<Token> token);
-    ~Function() override = default;
+    Function();
     std::string string() override;
     void accept(AstVisitor&) override;
 
-    std::shared_ptr<Token> token;
-    std::vector<std::shared_ptr<Identifier>> parameters;
-    std::shared_ptr<Statement> body;
+    // Parses a lazy body first. Not thread-safe.
+    Statement* getBody();
+
+    NodeList<Identifier> parameters;
+    // Null while the body is lazy
+    Statement* body;
+    // Null once the body is parsed
+    LazyBody* lazyBody;
 };
 
 class CallExpression : public Expression
 {
 public:
-    explicit CallExpression(std::unique_ptr<Token> token);
-    ~CallExpression() override = default;
+    CallExpression();
     std::string string() override;
     void accept(AstVisitor&) override;
 
-    std::shared_ptr<Token> token;
-    std::shared_ptr<Expression> function;
-    std::vector<std::shared_ptr<Expression>> arguments;
+    Expression* function;
+    NodeList<Expression> arguments;
 };
 
 class PrefixExpression : public Expression
 {
 public:
-    explicit PrefixExpression(std::unique_ptr<Token> token);
-    ~PrefixExpression() override = default;
+    explicit PrefixExpression(Token::TokenType op);
     std::string string() override;
     void accept(AstVisitor&) override;
 
-    std::shared_ptr<Token> token;
-    std::string op;
-    std::shared_ptr<Expression> right;
+    Token::TokenType op : 8;
+    Expression* right;
 };
 
 class InfixExpression : public Expression
 {
 public:
-    explicit InfixExpression(std::unique_ptr<Token> token);
-    ~InfixExpression() override = default;
+    explicit InfixExpression(Token::TokenType op);
     std::string string() override;
     void accept(AstVisitor&) override;
 
-    std::shared_ptr<Token> token;
-    std::shared_ptr<Expression> left;
-    std::string op;
-    std::shared_ptr<Expression> right;
+    Token::TokenType op : 8;
+    Expression* left;
+    Expression* right;
 };
 
 class IfExpression : public Expression
 {
 public:
-    explicit IfExpression(std::unique_ptr<Token> token);
-    ~IfExpression() override = default;
+    IfExpression();
     std::string string() override;
     void accept(AstVisitor&) override;
 
-    std::shared_ptr<Token> token;
-    std::shared_ptr<Expression> condition;
-    std::shared_ptr<Statement> consequence;
-    std::shared_ptr<Statement> alternative;
+    Expression* condition;
+    Statement* consequence;
+    Statement* alternative;
 };
 
 // Statements
@@ -144,64 +201,95 @@ class LetStatement : public Statement
 {
 public:
     LetStatement();
-    explicit LetStatement(std::unique_ptr<Token> token);
-    ~LetStatement() override = default;
     std::string string() override;
     void accept(AstVisitor&) override;
 
-    std::shared_ptr<Token> token;
-    std::shared_ptr<Identifier> identifier;
-    std::shared_ptr<Expression> expression;
+    Identifier* identifier;
+    Expression* expression;
 };
 
 class ReturnStatement : public Statement
 {
 public:
     ReturnStatement();
-    explicit ReturnStatement(std::unique_ptr<Token> token);
-    ~ReturnStatement() override = default;
     std::string string() override;
     void accept(AstVisitor&) override;
 
-    std::shared_ptr<Token> token;
-    std::shared_ptr<Expression> expression;
+    Expression* expression;
 };
 
 class ExpressionStatement : public Statement
 {
 public:
     ExpressionStatement();
-    ~ExpressionStatement() override = default;
     std::string string() override;
     void accept(AstVisitor&) override;
 
-    std::shared_ptr<Expression> expression;
+    Expression* expression;
 };
 
 class BlockStatement : public Statement
 {
 public:
-    BlockStatement() = default;
-    ~BlockStatement() override = default;
+    BlockStatement();
     std::string string() override;
     void accept(AstVisitor&) override;
 
-    std::vector<std::shared_ptr<Statement>> statements;
+    NodeList<Statement> statements;
 };
 
 // Program
+// The Program owns the arena with all of its nodes, and the source buffers
+// that the names of its identifiers point into
 class Program : public Node
 {
 public:
     Program() = default;
-    ~Program() override = default;
+    ~Program() = default;
     std::string string() override;
 
     void accept(AstVisitor&) override;
-    void addStatement(std::shared_ptr<Statement> statement);
-
-    std::vector<std::shared_ptr<Statement>> statements;
+    void addStatement(Statement* statement);
+    // Move the statements of the other program, with their nodes and
+    // sources, after the statements of this program
+    void append(Program& other);
+    // Replace count statements from first with the statements of the other
+    // program, taking over its nodes and sources. The nodes of the replaced
+    // statements stay in the arena until the program is compacted.
+    void splice(size_t first, size_t count, Program& other);
+    // The same for the statements of a block of this program
+    void splice(BlockStatement& block, size_t first, size_t count, Program& other);
+    // Copy the nodes of the statements into a new arena, which leaves out the
+    // nodes that are no longer part of the tree, and release the sources that
+    // no node points into. The statements and their nodes get new addresses.
+    // The copy of each block statement is added to blockCopies if given.
+    void compact(std::unordered_map<const BlockStatement*, BlockStatement*>* blockCopies = nullptr);
+
+    template<typename T, typename... Args>
+    T* create(Args&&... args);
+
+    // Keep the source alive for the nodes that point into it
+    void keepSource(const std::shared_ptr<const SourceBuffer>& source);
+
+    std::vector<Statement*> statements;
+    Arena arena;
+    std::vector<std::shared_ptr<const SourceBuffer>> sources;
+    // The lazy function bodies of the nodes, which refer to the program
+    std::vector<LazyBody*> lazyBodies;
+    // The errors found in lazy function bodies when they were parsed,
+    // prefixed with "line:column: "
+    std::vector<std::string> bodyDiagnostics;
+
+private:
+    void adopt(Program& other);
 };
 
+template<typename T, typename... Args>
+T* Program::create(Args&&... args)
+{
+    static_assert(std::is_trivially_destructible_v<T>, "Nodes must not need a destructor");
+    return arena.create<T>(std::forward<Args>(args)...);
+}
+
 #endif //INTERPRETER_AST_H
 
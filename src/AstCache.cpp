@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+#include <utility>
+#include <unistd.h>
+#include "AstCache.h"
+#include "FlatAst.h"
+
+AstCache::AstCache(std::string directory) : directory(std::move(directory)) {}
+
+std::shared_ptr<Program> AstCache::load(const SourceBuffer& source) const
+{
+    auto expected = digest(source.text());
+    std::shared_ptr<SourceBuffer> file;
+    try
+    {
+        file = SourceBuffer::fromFile(path(expected));
+    }
+    catch (std::system_error&)
+    {
+        return nullptr;
+    }
+
+    auto text = file->text();
+    Digest found;
+    if (text.size() < sizeof(found))
+    {
+        return nullptr;
+    }
+    std::memcpy(&found, text.data(), sizeof(found));
+    if (found.low != expected.low || found.high != expected.high || found.size != expected.size)
+    {
+        return nullptr;
+    }
+    auto ast = FlatAst::deserialize(text.substr(sizeof(found)));
+    return ast != nullptr ? ast->toProgram() : nullptr;
+}
+
+bool AstCache::store(const SourceBuffer& source, Program& program) const
+{
+    auto header = digest(source.text());
+    auto data = FlatAst(program).serialize();
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+
+    auto target = path(header);
+    auto temporary = target + "." + std::to_string(getpid()) + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!out.flush())
+        {
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+    std::filesystem::rename(temporary, target, error);
+    if (error)
+    {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::string AstCache::path(const SourceBuffer& source) const
+{
+    return path(digest(source.text()));
+}
+
+std::string AstCache::path(const Digest& digest) const
+{
+    char name[64];
+    std::snprintf(name, sizeof(name), "%016llx-%llu.v%u.ast", static_cast<unsigned long long>(digest.low),
+                  static_cast<unsigned long long>(digest.size), static_cast<unsigned>(FlatAst::formatVersion));
+    return (std::filesystem::path(directory) / name).string();
+}
+
+namespace
+{
+    uint64_t rotate(uint64_t value, int bits)
+    {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    uint64_t finish(uint64_t value)
+    {
+        value ^= value >> 33;
+        value *= 0xff51afd7ed558ccdull;
+        value ^= value >> 33;
+        value *= 0xc4ceb9fe1a85ec53ull;
+        return value ^ (value >> 33);
+    }
+
+    uint64_t word(const char* bytes)
+    {
+        uint64_t value;
+        std::memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+}
+
+// After the 128-bit MurmurHash3 for 64-bit machines: each step mixes sixteen
+// bytes into two lanes
+AstCache::Digest AstCache::digest(std::string_view text)
+{
+    constexpr uint64_t c1 = 0x87c37b91114253d5ull;
+    constexpr uint64_t c2 = 0x4cf5ad432745937full;
+    uint64_t h1 = 0;
+    uint64_t h2 = 0;
+    size_t i = 0;
+    for (; i + 16 <= text.size(); i += 16)
+    {
+        h1 ^= rotate(word(text.data() + i) * c1, 31) * c2;
+        h1 = (rotate(h1, 27) + h2) * 5 + 0x52dce729;
+        h2 ^= rotate(word(text.data() + i + 8) * c2, 33) * c1;
+        h2 = (rotate(h2, 31) + h1) * 5 + 0x38495ab5;
+    }
+
+    // The last bytes, padded with zeros
+    char tail[16] = {};
+    if (i < text.size())
+    {
+        std::memcpy(tail, text.data() + i, text.size() - i);
+    }
+    h1 ^= rotate(word(tail) * c1, 31) * c2;
+    h2 ^= rotate(word(tail + 8) * c2, 33) * c1;
+
+    h1 ^= text.size();
+    h2 ^= text.size();
+    h1 += h2;
+    h2 += h1;
+    h1 = finish(h1);
+    h2 = finish(h2);
+    h1 += h2;
+    h2 += h1;
+    return {h1, h2, text.size()};
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#ifndef INTERPRETER_ASTCACHE_H
+#define INTERPRETER_ASTCACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include "Ast.h"
+#include "SourceBuffer.h"
+
+// Keeps the programs of sources in a directory in serialized form (see
+// FlatAst::serialize), so that a source that has been parsed before can be
+// read back without parsing it again.
+//
+// A file is named by a hash and the size of the source and by the format
+// version, so an edited source or a new format is simply not found. The file
+// starts with a 128-bit digest and the size of the source, and a file whose
+// header does not match the source is not used, so a source whose name hash
+// collides with that of another one is parsed rather than given the wrong
+// program. Files are written under a temporary name and then renamed, so a
+// concurrent run never reads a partly written file.
+class AstCache
+{
+public:
+    // The directory is created when the first program is stored
+    explicit AstCache(std::string directory);
+
+    // The program stored for the source, or null if there is none or the
+    // file cannot be read
+    std::shared_ptr<Program> load(const SourceBuffer& source) const;
+    // Returns false if the file cannot be written
+    bool store(const SourceBuffer& source, Program& program) const;
+
+    std::string path(const SourceBuffer& source) const;
+
+private:
+    std::string directory;
+
+    // The header of a file
+    struct Digest
+    {
+        uint64_t low;
+        uint64_t high;
+        uint64_t size;
+    };
+
+    static Digest digest(std::string_view text);
+    std::string path(const Digest& digest) const;
+};
+
+#endif //INTERPRETER_ASTCACHE_H
@@ -6,18 +6,17 @@
  *
  */
 #include "AstPrinter.h"
-#include "ControlToken.h"
 
 AstPrinter::AstPrinter() : output ("") {}
 
 std::string AstPrinter::printCode(const std::shared_ptr <Node>& startNode)
 {
-    visitStack.push(startNode);
+    visitStack.push(startNode.get());
 
     // Visit all nodes in the visitList - nodes are added and removed dynamically
     while (!visitStack.empty())
     {
-        std::shared_ptr<Node> node = visitStack.top();
+        Node* node = visitStack.top();
         visitStack.pop();
         node->accept(*this);
     }
@@ -27,7 +26,7 @@ std::string AstPrinter::printCode(const std::shared_ptr <Node>& startNode)
 
 void AstPrinter::visitIdentifier(Identifier &identifier)
 {
-    output.append(*identifier.value);
+    output.append(identifier.value);
 }
 
 void AstPrinter::visitInteger(Integer &integer)
@@ -43,13 +42,13 @@ void AstPrinter::visitBoolean(Boolean &boolean)
 void AstPrinter::visitFunction(Function &function)
 {
     output.append("fn(");
-    visitStack.push(function.body);
-    visitStack.push(std::make_shared<ControlToken>(") "));
+    visitStack.push(function.getBody());
+    visitStack.push(control(") "));
     for(auto parameter = function.parameters.rbegin(); parameter != function.parameters.rend(); parameter++)
     {
         if (parameter != function.parameters.rbegin())
         {
-            visitStack.push(std::make_shared<ControlToken>(", "));
+            visitStack.push(control(", "));
         }
         visitStack.push(*parameter);
     }
@@ -57,29 +56,29 @@ void AstPrinter::visitFunction(Function &function)
 
 void AstPrinter::visitCallExpression(CallExpression &expression)
 {
-    visitStack.push(std::make_shared<ControlToken>(")"));
+    visitStack.push(control(")"));
     for(auto arg = expression.arguments.rbegin(); arg != expression.arguments.rend(); arg++)
     {
         if (arg != expression.arguments.rbegin())
         {
-            visitStack.push(std::make_shared<ControlToken>(", "));
+            visitStack.push(control(", "));
         }
         visitStack.push(*arg);
     }
-    visitStack.push(std::make_shared<ControlToken>("("));
+    visitStack.push(control("("));
     visitStack.push(expression.function);
 }
 
 void AstPrinter::visitPrefixExpression(PrefixExpression &expression)
 {
-    output.append(expression.op);
+    output.append(Token::getLiteral(expression.op));
     visitStack.push(expression.right);
 }
 
 void AstPrinter::visitInfixExpression(InfixExpression &expression)
 {
     visitStack.push(expression.right);
-    visitStack.push(std::make_shared<ControlToken>(expression.op));
+    visitStack.push(control(Token::getLiteral(expression.op)));
     visitStack.push(expression.left);
 }
 
@@ -89,10 +88,10 @@ void AstPrinter::visitIfExpression(IfExpression &expression)
     if(expression.alternative != nullptr)
     {
         visitStack.push(expression.alternative);
-        visitStack.push(std::make_shared<ControlToken>(" else "));
+        visitStack.push(control(" else "));
     }
     visitStack.push(expression.consequence);
-    visitStack.push(std::make_shared<ControlToken>(") "));
+    visitStack.push(control(") "));
     visitStack.push(expression.condition);
 }
 
@@ -101,27 +100,27 @@ void AstPrinter::visitLetStatement(LetStatement &statement)
     output.append("let ");
     output.append(statement.identifier->string());
     output.append("=");
-    visitStack.push(std::make_shared<ControlToken>(";"));
+    visitStack.push(control(";"));
     visitStack.push(statement.expression);
 }
 
 void AstPrinter::visitExpressionStatement(ExpressionStatement &statement)
 {
-    visitStack.push(std::make_shared<ControlToken>(";"));
+    visitStack.push(control(";"));
     visitStack.push(statement.expression);
 }
 
 void AstPrinter::visitReturnStatement(ReturnStatement &statement)
 {
     output.append("return ");
-    visitStack.push(std::make_shared<ControlToken>(";"));
+    visitStack.push(control(";"));
     visitStack.push(statement.expression);
 }
 
 void AstPrinter::visitBlockStatement(BlockStatement &statement)
 {
     output.append("{");
-    visitStack.push(std::make_shared<ControlToken>("}"));
+    visitStack.push(control("}"));
     addStatements(statement.statements);
 }
 
@@ -141,7 +140,14 @@ void AstPrinter::visitControlToken(ControlToken &controlToken)
     output.append(controlToken.string());
 }
 
-void AstPrinter::addStatements(std::vector<std::shared_ptr<Statement>> statements)
+// The control tokens live as long as the printer, the nodes in the arena
+ControlToken* AstPrinter::control(std::string_view string)
+{
+    return &controlTokens.emplace_back(string);
+}
+
+template<typename List>
+void AstPrinter::addStatements(const List& statements)
 {
     // Push all statements to be visited in the reverse order
     for(auto statement = statements.rbegin(); statement != statements.rend(); statement++)
@@ -8,10 +8,13 @@
 #ifndef INTERPRETER_ASTPRINTER_H
 #define INTERPRETER_ASTPRINTER_H
 
+#include <deque>
 #include <string>
+#include <string_view>
 #include <memory>
 #include <stack>
 #include "Ast.h"
+#include "ControlToken.h"
 
 class AstPrinter : public AstVisitor
 {
@@ -36,8 +39,12 @@ public:
 
 private:
     std::string output;
-    std::stack<std::shared_ptr<Node>> visitStack;
-    void addStatements(std::vector<std::shared_ptr<Statement>> statements);
+    std::stack<Node*> visitStack;
+    std::deque<ControlToken> controlTokens;
+    ControlToken* control(std::string_view string);
+
+    template<typename List>
+    void addStatements(const List& statements);
 };
 
 
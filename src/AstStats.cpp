@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+#include <cstdio>
+#include "AstStats.h"
+
+const std::array<size_t, AstStats::KIND_COUNT> AstStats::nodeSizes = {
+    sizeof(Identifier),
+    sizeof(Integer),
+    sizeof(Boolean),
+    sizeof(Function),
+    sizeof(CallExpression),
+    sizeof(PrefixExpression),
+    sizeof(InfixExpression),
+    sizeof(IfExpression),
+    sizeof(LetStatement),
+    sizeof(ReturnStatement),
+    sizeof(ExpressionStatement),
+    sizeof(BlockStatement),
+    sizeof(LazyBody),
+};
+
+AstStats::AstStats(Program& program)
+{
+    program.accept(*this);
+    while (!visitStack.empty())
+    {
+        Node* node = visitStack.top();
+        visitStack.pop();
+        node->accept(*this);
+    }
+}
+
+const char* AstStats::kindName(Kind kind)
+{
+    static const char* names[KIND_COUNT] = {
+        "identifier", "integer", "boolean", "function", "call", "prefix", "infix", "if", "let", "return",
+        "expression statement", "block", "lazy body"
+    };
+    return names[kind];
+}
+
+size_t AstStats::nodeCount() const
+{
+    size_t count = 0;
+    for (size_t kind = 0; kind < KIND_COUNT; ++kind)
+    {
+        count += counts[kind];
+    }
+    return count;
+}
+
+size_t AstStats::nodeBytes() const
+{
+    size_t bytes = 0;
+    for (size_t kind = 0; kind < KIND_COUNT; ++kind)
+    {
+        bytes += nodeBytes(static_cast<Kind>(kind));
+    }
+    return bytes;
+}
+
+std::string AstStats::report() const
+{
+    std::string result;
+    char line[128];
+    std::snprintf(line, sizeof(line), "%-22s %10s %6s %12s\n", "kind", "nodes", "size", "bytes");
+    result += line;
+    for (size_t kind = 0; kind < KIND_COUNT; ++kind)
+    {
+        std::snprintf(line, sizeof(line), "%-22s %10zu %6zu %12zu\n", kindName(static_cast<Kind>(kind)),
+                      counts[kind], nodeSizes[kind], nodeBytes(static_cast<Kind>(kind)));
+        result += line;
+    }
+    std::snprintf(line, sizeof(line), "%-22s %10zu %6s %12zu\n", "all nodes", nodeCount(), "", nodeBytes());
+    result += line;
+    std::snprintf(line, sizeof(line), "%-40s %12zu\n", "child lists", lists);
+    result += line;
+    std::snprintf(line, sizeof(line), "%-40s %12zu\n", "statement list", statementList);
+    result += line;
+    std::snprintf(line, sizeof(line), "%-40s %12zu\n", "arena used", arenaUsed);
+    result += line;
+    std::snprintf(line, sizeof(line), "%-40s %12zu\n", "arena allocated", arenaAllocated);
+    result += line;
+    if (nodeCount() > 0)
+    {
+        std::snprintf(line, sizeof(line), "%-40s %12.1f\n", "arena bytes per node",
+                      static_cast<double>(arenaUsed) / static_cast<double>(nodeCount()));
+        result += line;
+    }
+    return result;
+}
+
+void AstStats::push(Node* node)
+{
+    if (node != nullptr)
+    {
+        visitStack.push(node);
+    }
+}
+
+template<typename T>
+void AstStats::pushList(const NodeList<T>& list)
+{
+    lists += list.size() * sizeof(T*);
+    for (auto node : list)
+    {
+        push(node);
+    }
+}
+
+void AstStats::visitIdentifier(Identifier &)
+{
+    ++counts[IDENTIFIER];
+}
+
+void AstStats::visitInteger(Integer &)
+{
+    ++counts[INTEGER];
+}
+
+void AstStats::visitBoolean(Boolean &)
+{
+    ++counts[BOOLEAN];
+}
+
+void AstStats::visitFunction(Function &function)
+{
+    ++counts[FUNCTION];
+    pushList(function.parameters);
+    if (function.lazyBody != nullptr)
+    {
+        ++counts[LAZY_BODY];
+    }
+    push(function.body);
+}
+
+void AstStats::visitCallExpression(CallExpression &expression)
+{
+    ++counts[CALL];
+    push(expression.function);
+    pushList(expression.arguments);
+}
+
+void AstStats::visitPrefixExpression(PrefixExpression &expression)
+{
+    ++counts[PREFIX];
+    push(expression.right);
+}
+
+void AstStats::visitInfixExpression(InfixExpression &expression)
+{
+    ++counts[INFIX];
+    push(expression.left);
+    push(expression.right);
+}
+
+void AstStats::visitIfExpression(IfExpression &expression)
+{
+    ++counts[IF];
+    push(expression.condition);
+    push(expression.consequence);
+    push(expression.alternative);
+}
+
+void AstStats::visitLetStatement(LetStatement &statement)
+{
+    ++counts[LET];
+    push(statement.identifier);
+    push(statement.expression);
+}
+
+void AstStats::visitReturnStatement(ReturnStatement &statement)
+{
+    ++counts[RETURN];
+    push(statement.expression);
+}
+
+void AstStats::visitExpressionStatement(ExpressionStatement &statement)
+{
+    ++counts[EXPRESSION_STATEMENT];
+    push(statement.expression);
+}
+
+void AstStats::visitBlockStatement(BlockStatement &statement)
+{
+    ++counts[BLOCK];
+    pushList(statement.statements);
+}
+
+void AstStats::visitProgram(Program &program)
+{
+    statementList = program.statements.capacity() * sizeof(Statement*);
+    arenaUsed = program.arena.bytesUsed();
+    arenaAllocated = program.arena.bytesAllocated();
+    for (auto statement : program.statements)
+    {
+        push(statement);
+    }
+}
+
+void AstStats::visitControlToken(ControlToken &) {}
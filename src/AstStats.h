@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+#ifndef INTERPRETER_ASTSTATS_H
+#define INTERPRETER_ASTSTATS_H
+
+#include <array>
+#include <stack>
+#include <string>
+#include "Ast.h"
+
+// Counts the nodes of a program and the memory they take, by kind of node.
+// The tree is walked with an explicit stack, as by the AstPrinter. Lazy
+// function bodies are counted as they are, without parsing them.
+class AstStats : public AstVisitor
+{
+public:
+    enum Kind
+    {
+        IDENTIFIER,
+        INTEGER,
+        BOOLEAN,
+        FUNCTION,
+        CALL,
+        PREFIX,
+        INFIX,
+        IF,
+        LET,
+        RETURN,
+        EXPRESSION_STATEMENT,
+        BLOCK,
+        // The record of a function body that has not been parsed
+        LAZY_BODY,
+        KIND_COUNT
+    };
+
+    explicit AstStats(Program& program);
+
+    static const char* kindName(Kind kind);
+
+    size_t nodeCount(Kind kind) const { return counts[kind]; }
+    // The bytes of the nodes themselves, without their lists
+    size_t nodeBytes(Kind kind) const { return counts[kind] * nodeSizes[kind]; }
+    size_t nodeCount() const;
+    size_t nodeBytes() const;
+    // The bytes of the child lists of functions, calls and blocks
+    size_t listBytes() const { return lists; }
+    // The bytes of the list of top-level statements of the program
+    size_t statementListBytes() const { return statementList; }
+    size_t arenaBytesUsed() const { return arenaUsed; }
+    size_t arenaBytesAllocated() const { return arenaAllocated; }
+
+    // A table of the counts and sizes, one kind per line
+    std::string report() const;
+
+    void visitIdentifier(Identifier &identifier) override;
+    void visitInteger(Integer &integer) override;
+    void visitBoolean(Boolean &boolean) override;
+    void visitFunction(Function &function) override;
+    void visitCallExpression(CallExpression &expression) override;
+    void visitPrefixExpression(PrefixExpression &expression) override;
+    void visitInfixExpression(InfixExpression &expression) override;
+    void visitIfExpression(IfExpression &expression) override;
+    void visitLetStatement(LetStatement &statement) override;
+    void visitReturnStatement(ReturnStatement &statement) override;
+    void visitExpressionStatement(ExpressionStatement &statement) override;
+    void visitBlockStatement(BlockStatement &statement) override;
+    void visitProgram(Program &program) override;
+    void visitControlToken(ControlToken &controlToken) override;
+
+private:
+    static const std::array<size_t, KIND_COUNT> nodeSizes;
+
+    std::array<size_t, KIND_COUNT> counts {};
+    size_t lists = 0;
+    size_t statementList = 0;
+    size_t arenaUsed = 0;
+    size_t arenaAllocated = 0;
+    std::stack<Node*> visitStack;
+
+    void push(Node* node);
+    template<typename T>
+    void pushList(const NodeList<T>& list);
+};
+
+#endif //INTERPRETER_ASTSTATS_H
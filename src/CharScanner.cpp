@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include "CharScanner.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__) && defined(__GNUC__)
+#define CHARSCANNER_X86
+#include <immintrin.h>
+#endif
+
+// The aligned loads of the vectorized scanners may read the bytes of their
+// block before the start and after the end of the input. They stay within the
+// page, but AddressSanitizer would report them, so it does not check the
+// scanners.
+#if defined(__GNUC__)
+#define CHARSCANNER_NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address))
+#else
+#define CHARSCANNER_NO_SANITIZE_ADDRESS
+#endif
+
+namespace
+{
+    enum CharClass
+    {
+        WHITESPACE,
+        LETTER,
+        DIGIT
+    };
+
+    typedef const char* (*ScanFunction)(const char*);
+
+    struct Scanners
+    {
+        CharScanner::Implementation implementation;
+        ScanFunction whiteSpace;
+        ScanFunction letters;
+        ScanFunction digits;
+    };
+
+    template<CharClass charClass>
+    inline bool isInClass(char c)
+    {
+        switch (charClass)
+        {
+            case WHITESPACE:
+                return CharScanner::isWhiteSpace(c);
+            case LETTER:
+                return CharScanner::isLetter(c);
+            case DIGIT:
+                return CharScanner::isDigit(c);
+        }
+        return false;
+    }
+
+    template<CharClass charClass>
+    const char* scanScalar(const char* position)
+    {
+        while (isInClass<charClass>(*position))
+        {
+            ++position;
+        }
+        return position;
+    }
+
+#ifdef CHARSCANNER_X86
+    // Characters >= 0x80 are negative as signed bytes and thus never fall
+    // within any of the (positive) ranges below.
+    template<CharClass charClass>
+    inline __m128i classifySse2(__m128i chars)
+    {
+        switch (charClass)
+        {
+            case WHITESPACE:
+                return _mm_or_si128(
+                        _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8(' ')),
+                                     _mm_cmpeq_epi8(chars, _mm_set1_epi8('\t'))),
+                        _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8('\n')),
+                                     _mm_cmpeq_epi8(chars, _mm_set1_epi8('\r'))));
+            case LETTER:
+            {
+                // Setting bit 5 maps 'A'-'Z' onto 'a'-'z'
+                auto lower = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+                auto letter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                            _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+                return _mm_or_si128(letter, _mm_cmpeq_epi8(chars, _mm_set1_epi8('_')));
+            }
+            case DIGIT:
+                return _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('0' - 1)),
+                                     _mm_cmplt_epi8(chars, _mm_set1_epi8('9' + 1)));
+        }
+        return _mm_setzero_si128();
+    }
+
+    template<CharClass charClass>
+    CHARSCANNER_NO_SANITIZE_ADDRESS const char* scanSse2(const char* position)
+    {
+        // Start with the aligned block that contains the position and ignore
+        // the bytes before it
+        auto offset = reinterpret_cast<uintptr_t>(position) & 15u;
+        auto block = position - offset;
+        uint32_t ignore = (1u << offset) - 1;
+
+        while (true)
+        {
+            auto chars = _mm_load_si128(reinterpret_cast<const __m128i*>(block));
+            uint32_t outside = ~static_cast<uint32_t>(_mm_movemask_epi8(classifySse2<charClass>(chars))) & 0xffffu;
+            outside &= ~ignore;
+            if (outside != 0)
+            {
+                return block + __builtin_ctz(outside);
+            }
+            block += 16;
+            ignore = 0;
+        }
+    }
+
+    template<CharClass charClass>
+    __attribute__((target("avx2"))) inline __m256i classifyAvx2(__m256i chars)
+    {
+        switch (charClass)
+        {
+            case WHITESPACE:
+                return _mm256_or_si256(
+                        _mm256_or_si256(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8(' ')),
+                                        _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\t'))),
+                        _mm256_or_si256(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\n')),
+                                        _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\r'))));
+            case LETTER:
+            {
+                auto lower = _mm256_or_si256(chars, _mm256_set1_epi8(0x20));
+                auto letter = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+                                               _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+                return _mm256_or_si256(letter, _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('_')));
+            }
+            case DIGIT:
+                return _mm256_and_si256(_mm256_cmpgt_epi8(chars, _mm256_set1_epi8('0' - 1)),
+                                        _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), chars));
+        }
+        return _mm256_setzero_si256();
+    }
+
+    template<CharClass charClass>
+    __attribute__((target("avx2"))) CHARSCANNER_NO_SANITIZE_ADDRESS const char* scanAvx2(const char* position)
+    {
+        auto offset = reinterpret_cast<uintptr_t>(position) & 31u;
+        auto block = position - offset;
+        uint32_t ignore = offset == 0 ? 0 : (1u << offset) - 1;
+
+        while (true)
+        {
+            auto chars = _mm256_load_si256(reinterpret_cast<const __m256i*>(block));
+            uint32_t outside = ~static_cast<uint32_t>(_mm256_movemask_epi8(classifyAvx2<charClass>(chars)));
+            outside &= ~ignore;
+            if (outside != 0)
+            {
+                return block + __builtin_ctz(outside);
+            }
+            block += 32;
+            ignore = 0;
+        }
+    }
+#endif
+
+    // Convert eight ASCII digits to their value using SWAR (SIMD within a
+    // register): adjacent digits, then pairs and then quads are combined
+    // with one multiplication each.
+    inline uint64_t parseEightDigits(const char* digits)
+    {
+        uint64_t chunk = 0;
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+        std::memcpy(&chunk, digits, sizeof(chunk));
+#else
+        for (int i = 7; i >= 0; --i)
+        {
+            chunk = (chunk << 8) | static_cast<unsigned char>(digits[i]);
+        }
+#endif
+        chunk -= 0x3030303030303030u;
+        chunk = (chunk * 10 + (chunk >> 8)) & 0x00ff00ff00ff00ffu;
+        chunk = (chunk * 100 + (chunk >> 16)) & 0x0000ffff0000ffffu;
+        chunk = (chunk * 10000 + (chunk >> 32)) & 0x00000000ffffffffu;
+        return chunk;
+    }
+
+    Scanners createScanners(CharScanner::Implementation implementation)
+    {
+        switch (implementation)
+        {
+#ifdef CHARSCANNER_X86
+            case CharScanner::AVX2:
+                return {implementation, &scanAvx2<WHITESPACE>, &scanAvx2<LETTER>, &scanAvx2<DIGIT>};
+            case CharScanner::SSE2:
+                return {implementation, &scanSse2<WHITESPACE>, &scanSse2<LETTER>, &scanSse2<DIGIT>};
+#endif
+            default:
+                return {CharScanner::SCALAR, &scanScalar<WHITESPACE>, &scanScalar<LETTER>, &scanScalar<DIGIT>};
+        }
+    }
+
+    Scanners selectBestScanners()
+    {
+        if (CharScanner::isSupported(CharScanner::AVX2))
+        {
+            return createScanners(CharScanner::AVX2);
+        }
+        if (CharScanner::isSupported(CharScanner::SSE2))
+        {
+            return createScanners(CharScanner::SSE2);
+        }
+        return createScanners(CharScanner::SCALAR);
+    }
+
+    Scanners& activeScanners()
+    {
+        static Scanners scanners = selectBestScanners();
+        return scanners;
+    }
+}
+
+const char* CharScanner::scanWhiteSpace(const char* position)
+{
+    return activeScanners().whiteSpace(position);
+}
+
+const char* CharScanner::scanLetters(const char* position)
+{
+    return activeScanners().letters(position);
+}
+
+const char* CharScanner::scanDigits(const char* position)
+{
+    return activeScanners().digits(position);
+}
+
+bool CharScanner::parseDecimal(const char* begin, const char* end, int64_t& value)
+{
+    uint64_t result = 0;
+    bool overflow = false;
+
+    while (end - begin >= 8)
+    {
+        overflow |= __builtin_mul_overflow(result, 100000000u, &result);
+        overflow |= __builtin_add_overflow(result, parseEightDigits(begin), &result);
+        begin += 8;
+    }
+    while (begin < end)
+    {
+        overflow |= __builtin_mul_overflow(result, 10u, &result);
+        overflow |= __builtin_add_overflow(result, static_cast<uint64_t>(*begin - '0'), &result);
+        ++begin;
+    }
+
+    if (overflow || (result > static_cast<uint64_t>(std::numeric_limits<int64_t>::max())))
+    {
+        return false;
+    }
+    value = static_cast<int64_t>(result);
+    return true;
+}
+
+bool CharScanner::isSupported(CharScanner::Implementation implementation)
+{
+    switch (implementation)
+    {
+        case SCALAR:
+            return true;
+#ifdef CHARSCANNER_X86
+        case SSE2:
+            return true;
+        case AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+void CharScanner::setImplementation(CharScanner::Implementation implementation)
+{
+    if (isSupported(implementation))
+    {
+        activeScanners() = createScanners(implementation);
+    }
+}
+
+CharScanner::Implementation CharScanner::getImplementation()
+{
+    return activeScanners().implementation;
+}
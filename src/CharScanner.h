@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#ifndef INTERPRETER_CHARSCANNER_H
+#define INTERPRETER_CHARSCANNER_H
+
+#include <cstdint>
+
+// Finds the end of runs of characters of the same class (white space, letters
+// or digits). Each function returns a pointer to the first character after
+// the run starting at the given position. The input must be terminated by a
+// zero character, which ends every run.
+//
+// Several bytes are classified per step using SSE2 or AVX2 when the CPU
+// supports it. The vectorized versions only use aligned loads, so they never
+// read across a page boundary beyond the terminating zero.
+class CharScanner
+{
+public:
+    enum Implementation
+    {
+        SCALAR,
+        SSE2,
+        AVX2
+    };
+
+    static const char* skipWhiteSpace(const char* position);
+    static const char* skipLetters(const char* position);
+    static const char* skipDigits(const char* position);
+
+    static bool isWhiteSpace(char c);
+    static bool isLetter(char c);
+    static bool isDigit(char c);
+
+    // Convert the decimal digits in [begin, end) to an integer, eight digits
+    // at a time. Returns false if the number does not fit in an int64_t.
+    static bool parseDecimal(const char* begin, const char* end, int64_t& value);
+
+    // The best implementation supported by the CPU is selected at start-up.
+    // Selecting another one is mainly intended for testing and benchmarking.
+    static bool isSupported(Implementation implementation);
+    static void setImplementation(Implementation implementation);
+    static Implementation getImplementation();
+
+private:
+    // Most runs in source code are short. They are handled inline before
+    // the vectorized scan of the remaining characters is called.
+    static constexpr int shortRunLength = 8;
+
+    static const char* scanWhiteSpace(const char* position);
+    static const char* scanLetters(const char* position);
+    static const char* scanDigits(const char* position);
+};
+
+inline bool CharScanner::isWhiteSpace(char c)
+{
+    return (c == ' ') || (c == '\t') || (c == '\n') || (c == '\r');
+}
+
+inline bool CharScanner::isLetter(char c)
+{
+    return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || (c == '_');
+}
+
+inline bool CharScanner::isDigit(char c)
+{
+    return ('0' <= c && c <= '9');
+}
+
+inline const char* CharScanner::skipWhiteSpace(const char* position)
+{
+    for (int i = 0; i < shortRunLength; ++i, ++position)
+    {
+        if (!isWhiteSpace(*position))
+        {
+            return position;
+        }
+    }
+    return scanWhiteSpace(position);
+}
+
+inline const char* CharScanner::skipLetters(const char* position)
+{
+    for (int i = 0; i < shortRunLength; ++i, ++position)
+    {
+        if (!isLetter(*position))
+        {
+            return position;
+        }
+    }
+    return scanLetters(position);
+}
+
+inline const char* CharScanner::skipDigits(const char* position)
+{
+    for (int i = 0; i < shortRunLength; ++i, ++position)
+    {
+        if (!isDigit(*position))
+        {
+            return position;
+        }
+    }
+    return scanDigits(position);
+}
+
+#endif //INTERPRETER_CHARSCANNER_H
@@ -7,11 +7,11 @@
  */
 #include "ControlToken.h"
 
-ControlToken::ControlToken(std::string string) : _string(std::move(string)) {}
+ControlToken::ControlToken(std::string_view string) : _string(string) {}
 
 std::string ControlToken::string()
 {
-    return _string;
+    return std::string(_string);
 }
 
 void ControlToken::accept(AstVisitor &visitor)
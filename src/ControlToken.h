@@ -9,18 +9,19 @@
 #define INTERPRETER_CONTROLTOKEN_H
 
 #include <string>
+#include <string_view>
 #include "Object.h"
 #include "Ast.h"
 
 class ControlToken : public Node
 {
 public:
-    explicit ControlToken(std::string);
+    explicit ControlToken(std::string_view);
     std::string string() override;
     void accept(AstVisitor &visitor) override;
 
 private:
-    std::string _string;
+    std::string_view _string;
 };
 
 #endif //INTERPRETER_CONTROLTOKEN_H
@@ -9,16 +9,16 @@
 #include "ControlToken.h"
 #include "Evaluator.h"
 
-Evaluator::Evaluator() : goingUp(false), breakBlock(false) {}
+Evaluator::Evaluator() : goingUp(false), breakBlock(false), goUp("") {}
 
 std::shared_ptr<Object> Evaluator::eval(const std::shared_ptr<Node>& startNode)
 {
-    visitStack.push(startNode);
+    visitStack.push(startNode.get());
 
     // Visit all nodes in the visitList - nodes are added and removed dynamically
     while (!visitStack.empty())
     {
-        std::shared_ptr<Node> node = visitStack.top();
+        Node* node = visitStack.top();
         visitStack.pop();
         node->accept(*this);
     }
@@ -29,6 +29,11 @@ std::shared_ptr<Object> Evaluator::eval(const std::shared_ptr<Node>& startNode)
     return result;
 }
 
+bool Evaluator::hasReturned() const
+{
+    return breakBlock;
+}
+
 void Evaluator::visitIdentifier(Identifier &identifier)
 {
 }
@@ -64,11 +69,11 @@ void Evaluator::visitPrefixExpression(PrefixExpression &expression)
         auto rightEvaluated = evalStack.top();
         evalStack.pop();
 
-        if (expression.token->type == Token::MINUS)
+        if (expression.op == Token::MINUS)
         {
             evalStack.push(evalMinusPrefixExpression(rightEvaluated));
         }
-        else if(expression.token->type == Token::BANG)
+        else if(expression.op == Token::BANG)
         {
             evalStack.push(evalBangPrefixExpression(rightEvaluated));
         }
@@ -79,8 +84,8 @@ void Evaluator::visitPrefixExpression(PrefixExpression &expression)
     }
     else
     {
-        visitStack.push(std::make_shared<PrefixExpression>(expression));
-        visitStack.push(std::make_shared<ControlToken>(""));
+        visitStack.push(&expression);
+        visitStack.push(&goUp);
         visitStack.push(expression.right);
     }
 }
@@ -99,14 +104,14 @@ void Evaluator::visitInfixExpression(InfixExpression &expression)
         if ((leftEvaluated->getType() == Object::Type::INTEGER) &&
             (rightEvaluated->getType() == Object::Type::INTEGER))
         {
-            evalStack.push(evalIntegerInfixExpression(expression.token->type,
+            evalStack.push(evalIntegerInfixExpression(expression.op,
                     dynamic_cast<IntegerObject *>(leftEvaluated.get()),
                     dynamic_cast<IntegerObject *>(rightEvaluated.get())));
         }
         else if ((leftEvaluated->getType() == Object::Type::BOOLEAN) &&
                 (rightEvaluated->getType() == Object::Type::BOOLEAN))
         {
-            evalStack.push(evalBooleanInfixExpression(expression.token->type,
+            evalStack.push(evalBooleanInfixExpression(expression.op,
                     dynamic_cast<BooleanObject *>(leftEvaluated.get()),
                     dynamic_cast<BooleanObject *>(rightEvaluated.get())));
         }
@@ -117,8 +122,8 @@ void Evaluator::visitInfixExpression(InfixExpression &expression)
     }
     else
     {
-        visitStack.push(std::make_shared<InfixExpression>(expression));
-        visitStack.push(std::make_shared<ControlToken>(""));
+        visitStack.push(&expression);
+        visitStack.push(&goUp);
         visitStack.push(expression.right);
         visitStack.push(expression.left);
     }
@@ -151,8 +156,8 @@ void Evaluator::visitIfExpression(IfExpression &expression)
     }
     else
     {
-        visitStack.push(std::make_shared<IfExpression>(expression));
-        visitStack.push(std::make_shared<ControlToken>(""));
+        visitStack.push(&expression);
+        visitStack.push(&goUp);
         visitStack.push(expression.condition);
     }
 }
@@ -171,8 +176,8 @@ void Evaluator::visitReturnStatement(ReturnStatement &statement)
     }
     else
     {
-        visitStack.push(std::make_shared<ReturnStatement>(statement));
-        visitStack.push(std::make_shared<ControlToken>(""));
+        visitStack.push(&statement);
+        visitStack.push(&goUp);
         visitStack.push(statement.expression);
     }
 }
@@ -206,7 +211,8 @@ void Evaluator::visitControlToken(ControlToken &controlToken)
     goingUp = true;
 }
 
-void Evaluator::addStatements(std::vector<std::shared_ptr<Statement>> statements)
+template<typename List>
+void Evaluator::addStatements(const List& statements)
 {
     // Push all statements to be visited in the reverse order
     for(auto statement = statements.rbegin(); statement != statements.rend(); statement++)
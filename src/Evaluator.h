@@ -12,6 +12,7 @@
 #include "AstVisitor.h"
 #include "Object.h"
 #include "Ast.h"
+#include "ControlToken.h"
 
 class Evaluator : public AstVisitor
 {
@@ -32,13 +33,19 @@ public:
     void visitProgram(Program &program) override;
     void visitControlToken(ControlToken &controlToken) override;
     std::shared_ptr<Object> eval(const std::shared_ptr<Node>& startNode);
+    // A return statement was evaluated, which ends the program
+    bool hasReturned() const;
 
 private:
     bool goingUp;
     bool breakBlock;
-    std::stack<std::shared_ptr<Node>> visitStack;
+    std::stack<Node*> visitStack;
     std::stack<std::shared_ptr<Object>> evalStack;
-    void addStatements(std::vector<std::shared_ptr<Statement>> statements);
+    // Pushed above a node to revisit it once its children are evaluated
+    ControlToken goUp;
+
+    template<typename List>
+    void addStatements(const List& statements);
     static std::shared_ptr<Object> evalMinusPrefixExpression(const std::shared_ptr<Object>& right);
     static std::shared_ptr<Object> evalBangPrefixExpression(const std::shared_ptr<Object>& right);
     static std::shared_ptr<Object> evalIntegerInfixExpression(Token::TokenType op, IntegerObject *left,
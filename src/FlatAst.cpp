@@ -0,0 +1,777 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include <cstring>
+#include <stack>
+#include <unordered_map>
+#include "AstVisitor.h"
+#include "FlatAst.h"
+#include "SourceBuffer.h"
+
+// Walks the Program with an explicit stack, numbering the nodes in the order
+// they are visited. Each pending node carries the field of its parent that
+// its number has to be written to.
+class FlatAst::Converter : public AstVisitor
+{
+public:
+    explicit Converter(FlatAst& ast) : ast(ast), current {} {}
+
+    void convert(Program& program)
+    {
+        program.accept(*this);
+        while (!pending.empty())
+        {
+            current = pending.top();
+            pending.pop();
+            current.node->accept(*this);
+        }
+    }
+
+    void visitIdentifier(Identifier& identifier) override
+    {
+        auto name = nameNumbers.emplace(identifier.symbol, static_cast<Index>(ast.names.size()));
+        if (name.second)
+        {
+            ast.names.push_back(identifier.value);
+            ast.nameSymbols.push_back(identifier.symbol);
+        }
+        link(ast.addNode(IDENTIFIER, 0, name.first->second));
+    }
+
+    void visitInteger(Integer& integer) override
+    {
+        link(ast.addNode(INTEGER, 0, static_cast<Index>(ast.integers.size())));
+        ast.integers.push_back(integer.value);
+    }
+
+    void visitBoolean(Boolean& boolean) override
+    {
+        link(ast.addNode(BOOLEAN, 0, boolean.value ? 1 : 0));
+    }
+
+    void visitFunction(Function& function) override
+    {
+        auto node = ast.addNode(FUNCTION);
+        link(node);
+        push(function.getBody(), FIRST, node);
+        pushList(function.parameters, node);
+    }
+
+    void visitCallExpression(CallExpression& expression) override
+    {
+        auto node = ast.addNode(CALL);
+        link(node);
+        pushList(expression.arguments, node);
+        push(expression.function, FIRST, node);
+    }
+
+    void visitPrefixExpression(PrefixExpression& expression) override
+    {
+        auto node = ast.addNode(PREFIX, expression.op);
+        link(node);
+        push(expression.right, FIRST, node);
+    }
+
+    void visitInfixExpression(InfixExpression& expression) override
+    {
+        auto node = ast.addNode(INFIX, expression.op);
+        link(node);
+        push(expression.right, SECOND, node);
+        push(expression.left, FIRST, node);
+    }
+
+    void visitIfExpression(IfExpression& expression) override
+    {
+        auto node = ast.addNode(IF);
+        link(node);
+        push(expression.alternative, THIRD, node);
+        push(expression.consequence, SECOND, node);
+        push(expression.condition, FIRST, node);
+    }
+
+    void visitLetStatement(LetStatement& statement) override
+    {
+        auto node = ast.addNode(LET);
+        link(node);
+        push(statement.expression, SECOND, node);
+        push(statement.identifier, FIRST, node);
+    }
+
+    void visitReturnStatement(ReturnStatement& statement) override
+    {
+        auto node = ast.addNode(RETURN);
+        link(node);
+        push(statement.expression, FIRST, node);
+    }
+
+    void visitExpressionStatement(ExpressionStatement& statement) override
+    {
+        auto node = ast.addNode(EXPRESSION_STATEMENT);
+        link(node);
+        push(statement.expression, FIRST, node);
+    }
+
+    void visitBlockStatement(BlockStatement& statement) override
+    {
+        auto node = ast.addNode(BLOCK);
+        link(node);
+        pushList(statement.statements, node);
+    }
+
+    void visitProgram(Program& program) override
+    {
+        ast.statements.resize(program.statements.size(), NONE);
+        for (auto i = program.statements.size(); i > 0; --i)
+        {
+            push(program.statements[i - 1], STATEMENT, static_cast<Index>(i - 1));
+        }
+    }
+
+    void visitControlToken(ControlToken&) override {}
+
+private:
+    // Where the number of a node is stored
+    enum Field
+    {
+        FIRST,
+        SECOND,
+        THIRD,
+        CHILD,
+        STATEMENT
+    };
+
+    struct Pending
+    {
+        Node* node;
+        Field field;
+        Index at;
+    };
+
+    FlatAst& ast;
+    std::stack<Pending> pending;
+    Pending current;
+    // The number of the name of each symbol met so far
+    std::unordered_map<uint32_t, Index> nameNumbers;
+
+    void push(Node* node, Field field, Index at)
+    {
+        if (node != nullptr)
+        {
+            pending.push({node, field, at});
+        }
+    }
+
+    // Reserve the list in the lists array, and push the elements so that
+    // the first one is visited first
+    template<typename T>
+    void pushList(const NodeList<T>& list, Index node)
+    {
+        auto start = static_cast<Index>(ast.lists.size());
+        ast.seconds[node] = start;
+        ast.thirds[node] = static_cast<Index>(list.size());
+        ast.lists.resize(start + list.size(), NONE);
+        for (auto i = list.size(); i > 0; --i)
+        {
+            push(list[i - 1], CHILD, static_cast<Index>(start + i - 1));
+        }
+    }
+
+    void link(Index node)
+    {
+        switch (current.field)
+        {
+            case FIRST:
+                ast.firsts[current.at] = node;
+                break;
+            case SECOND:
+                ast.seconds[current.at] = node;
+                break;
+            case THIRD:
+                ast.thirds[current.at] = node;
+                break;
+            case CHILD:
+                ast.lists[current.at] = node;
+                break;
+            case STATEMENT:
+                ast.statements[current.at] = node;
+                break;
+        }
+    }
+};
+
+FlatAst::FlatAst(Program& program) : sources(program.sources)
+{
+    Converter(*this).convert(program);
+
+    // The arrays are not added to after the conversion
+    kinds.shrink_to_fit();
+    operators.shrink_to_fit();
+    firsts.shrink_to_fit();
+    seconds.shrink_to_fit();
+    thirds.shrink_to_fit();
+    lists.shrink_to_fit();
+    integers.shrink_to_fit();
+}
+
+FlatAst::Index FlatAst::addNode(Kind kind, uint8_t op, Index first, Index second, Index third)
+{
+    kinds.push_back(kind);
+    operators.push_back(op);
+    firsts.push_back(first);
+    seconds.push_back(second);
+    thirds.push_back(third);
+    return static_cast<Index>(kinds.size() - 1);
+}
+
+static std::string operatorString(Token::TokenType type)
+{
+    auto literal = Token::getLiteral(type);
+    return literal.empty() ? Token::getTypeString(type) : std::string(literal);
+}
+
+std::string FlatAst::string() const
+{
+    std::string programString;
+    for (auto statement : statements)
+    {
+        write(statement, programString);
+        programString += "\n";
+    }
+    return programString;
+}
+
+std::string FlatAst::string(Index node) const
+{
+    std::string result;
+    write(node, result);
+    return result;
+}
+
+// Writes the text of a node with an explicit stack, like the Converter, so
+// that deep trees do not use up the call stack. The text before the first
+// child of a node is written when the node is taken off the stack, and the
+// rest is pushed as pieces between its children, last one first.
+void FlatAst::write(Index root, std::string& out) const
+{
+    enum class Step
+    {
+        NODE,
+        TEXT,
+        OPERATOR
+    };
+    struct Piece
+    {
+        Step step;
+        Index node;
+        std::string_view text;
+    };
+    std::stack<Piece> pending;
+    pending.push({Step::NODE, root, {}});
+    auto text = [&pending](std::string_view text) { pending.push({Step::TEXT, NONE, text}); };
+    auto child = [&pending](Index node) { pending.push({Step::NODE, node, {}}); };
+    auto list = [&](List list)
+    {
+        for (auto i = list.size(); i > 0; --i)
+        {
+            child(list[i - 1]);
+            if (i > 1)
+            {
+                text(", ");
+            }
+        }
+    };
+
+    while (!pending.empty())
+    {
+        auto piece = pending.top();
+        pending.pop();
+        auto node = piece.node;
+        if (piece.step == Step::TEXT)
+        {
+            out += piece.text;
+            continue;
+        }
+        if (piece.step == Step::OPERATOR)
+        {
+            out += " " + operatorString(op(node)) + " ";
+            continue;
+        }
+
+        switch (kind(node))
+        {
+            case IDENTIFIER:
+                out += name(node);
+                break;
+            case INTEGER:
+                out += std::to_string(integer(node));
+                break;
+            case BOOLEAN:
+                out += boolean(node) ? "true" : "false";
+                break;
+            case FUNCTION:
+                out += "fn(";
+                text(" }");
+                child(first(node));
+                text(") { ");
+                list(children(node));
+                break;
+            case CALL:
+                text(")");
+                list(children(node));
+                text("(");
+                child(first(node));
+                break;
+            case PREFIX:
+                out += "(" + operatorString(op(node));
+                text(")");
+                child(first(node));
+                break;
+            case INFIX:
+                out += "(";
+                text(")");
+                child(second(node));
+                pending.push({Step::OPERATOR, node, {}});
+                child(first(node));
+                break;
+            case IF:
+                out += "if ";
+                text("\n");
+                if (third(node) != NONE)
+                {
+                    text(" }");
+                    child(third(node));
+                    text(" else { ");
+                }
+                text(" }");
+                child(second(node));
+                text(" { ");
+                child(first(node));
+                break;
+            case LET:
+                out += "let ";
+                text(";");
+                if (second(node) != NONE)
+                {
+                    child(second(node));
+                }
+                text(" = ");
+                child(first(node));
+                break;
+            case RETURN:
+                out += "return ";
+                text(";");
+                if (first(node) != NONE)
+                {
+                    child(first(node));
+                }
+                break;
+            case EXPRESSION_STATEMENT:
+                if (first(node) != NONE)
+                {
+                    child(first(node));
+                }
+                break;
+            case BLOCK:
+            {
+                auto statements = children(node);
+                for (auto i = statements.size(); i > 0; --i)
+                {
+                    text("\n");
+                    child(statements[i - 1]);
+                }
+                break;
+            }
+        }
+    }
+}
+
+size_t FlatAst::memoryUsage() const
+{
+    return kinds.capacity() * sizeof(Kind) +
+           operators.capacity() * sizeof(uint8_t) +
+           (firsts.capacity() + seconds.capacity() + thirds.capacity()) * sizeof(Index) +
+           (lists.capacity() + statements.capacity()) * sizeof(Index) +
+           integers.capacity() * sizeof(int64_t) +
+           names.capacity() * sizeof(std::string_view) +
+           nameSymbols.capacity() * sizeof(uint32_t);
+}
+
+// The serialized form holds, in the byte order of the machine that wrote it:
+//
+//   "MAST", a byte order mark and the format version       3 x uint32
+//   the numbers of nodes, list elements, statements,
+//   integers, names and name bytes                          6 x uint32
+//   kinds, operators                                        a byte per node each
+//   firsts, seconds, thirds, lists, statements              uint32 each
+//   integers                                                int64 each
+//   name lengths                                            uint32 each
+//   names                                                   the bytes of all names
+namespace
+{
+    constexpr std::string_view magic = "MAST";
+    constexpr uint32_t byteOrderMark = 0x01020304;
+
+    template<typename T>
+    void writeArray(std::string& out, const std::vector<T>& array)
+    {
+        out.append(reinterpret_cast<const char*>(array.data()), array.size() * sizeof(T));
+    }
+}
+
+class FlatAst::Reader
+{
+public:
+    explicit Reader(std::string_view data) : data(data), position(0) {}
+
+    template<typename T>
+    bool read(std::vector<T>& array, size_t count)
+    {
+        if (count > (data.size() - position) / sizeof(T))
+        {
+            return false;
+        }
+        array.resize(count);
+        if (count == 0)
+        {
+            return true;
+        }
+        std::memcpy(array.data(), data.data() + position, count * sizeof(T));
+        position += count * sizeof(T);
+        return true;
+    }
+
+    std::string_view rest() const
+    {
+        return data.substr(position);
+    }
+
+private:
+    std::string_view data;
+    size_t position;
+};
+
+std::string FlatAst::serialize() const
+{
+    std::vector<uint32_t> nameLengths;
+    size_t nameBytes = 0;
+    for (auto name : names)
+    {
+        nameLengths.push_back(static_cast<uint32_t>(name.size()));
+        nameBytes += name.size();
+    }
+
+    std::vector<uint32_t> header = {
+        byteOrderMark, formatVersion,
+        static_cast<uint32_t>(size()), static_cast<uint32_t>(lists.size()),
+        static_cast<uint32_t>(statements.size()), static_cast<uint32_t>(integers.size()),
+        static_cast<uint32_t>(names.size()), static_cast<uint32_t>(nameBytes)};
+
+    std::string out(magic);
+    out.reserve(magic.size() + header.size() * sizeof(uint32_t) + size() * (2 + 3 * sizeof(Index)) +
+                (lists.size() + statements.size() + names.size()) * sizeof(uint32_t) +
+                integers.size() * sizeof(int64_t) + nameBytes);
+    writeArray(out, header);
+    writeArray(out, kinds);
+    writeArray(out, operators);
+    writeArray(out, firsts);
+    writeArray(out, seconds);
+    writeArray(out, thirds);
+    writeArray(out, lists);
+    writeArray(out, statements);
+    writeArray(out, integers);
+    writeArray(out, nameLengths);
+    for (auto name : names)
+    {
+        out += name;
+    }
+    return out;
+}
+
+std::unique_ptr<FlatAst> FlatAst::deserialize(std::string_view data, SymbolTable& symbols)
+{
+    if (data.substr(0, magic.size()) != magic)
+    {
+        return nullptr;
+    }
+    Reader reader(data.substr(magic.size()));
+    std::vector<uint32_t> header;
+    if (!reader.read(header, 8) || header[0] != byteOrderMark || header[1] != formatVersion)
+    {
+        return nullptr;
+    }
+
+    auto nodeCount = header[2];
+    auto nameCount = header[6];
+    std::unique_ptr<FlatAst> ast(new FlatAst());
+    std::vector<uint32_t> nameLengths;
+    if (!reader.read(ast->kinds, nodeCount) || !reader.read(ast->operators, nodeCount) ||
+        !reader.read(ast->firsts, nodeCount) || !reader.read(ast->seconds, nodeCount) ||
+        !reader.read(ast->thirds, nodeCount) || !reader.read(ast->lists, header[3]) ||
+        !reader.read(ast->statements, header[4]) || !reader.read(ast->integers, header[5]) ||
+        !reader.read(nameLengths, nameCount) || reader.rest().size() != header[7])
+    {
+        return nullptr;
+    }
+
+    // The names are interned into the table
+    auto nameBytes = reader.rest();
+    size_t offset = 0;
+    for (size_t i = 0; i < nameCount; ++i)
+    {
+        if (nameLengths[i] > nameBytes.size() - offset)
+        {
+            return nullptr;
+        }
+        auto symbol = symbols.intern(nameBytes.substr(offset, nameLengths[i]));
+        offset += nameLengths[i];
+        ast->names.push_back(symbols.name(symbol));
+        ast->nameSymbols.push_back(symbol);
+    }
+    return ast->isValid() ? std::move(ast) : nullptr;
+}
+
+namespace
+{
+    // The kinds of nodes that may be placed in a field
+    enum class Place
+    {
+        EXPRESSION,
+        STATEMENT,
+        BLOCK,
+        IDENTIFIER
+    };
+
+    bool fits(FlatAst::Kind kind, Place place)
+    {
+        switch (place)
+        {
+            case Place::EXPRESSION:
+                return kind <= FlatAst::IF;
+            case Place::STATEMENT:
+                return kind >= FlatAst::LET && kind <= FlatAst::BLOCK;
+            case Place::BLOCK:
+                return kind == FlatAst::BLOCK;
+            case Place::IDENTIFIER:
+                return kind == FlatAst::IDENTIFIER;
+        }
+        return false;
+    }
+}
+
+// Check what toProgram relies on. Children come after their parents, so the
+// nodes cannot form a cycle, and each child is of a kind that fits its field.
+bool FlatAst::isValid() const
+{
+    auto child = [this](Index parent, Index node, Place place, bool optional)
+    {
+        if (node == NONE)
+        {
+            return optional;
+        }
+        return node > parent && node < size() && fits(kinds[node], place);
+    };
+    auto list = [this, &child](Index parent, Place place)
+    {
+        auto start = seconds[parent];
+        auto count = thirds[parent];
+        if (start > lists.size() || count > lists.size() - start)
+        {
+            return false;
+        }
+        for (Index i = 0; i < count; ++i)
+        {
+            if (!child(parent, lists[start + i], place, false))
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    for (Index node = 0; node < size(); ++node)
+    {
+        auto first = firsts[node];
+        bool valid = false;
+        switch (kinds[node])
+        {
+            case IDENTIFIER:
+                valid = first < names.size();
+                break;
+            case INTEGER:
+                valid = first < integers.size();
+                break;
+            case BOOLEAN:
+                valid = first <= 1;
+                break;
+            case FUNCTION:
+                valid = child(node, first, Place::BLOCK, false) && list(node, Place::IDENTIFIER);
+                break;
+            case CALL:
+                valid = child(node, first, Place::EXPRESSION, false) && list(node, Place::EXPRESSION);
+                break;
+            case PREFIX:
+                valid = (op(node) == Token::MINUS || op(node) == Token::BANG) &&
+                        child(node, first, Place::EXPRESSION, false);
+                break;
+            case INFIX:
+                valid = op(node) >= Token::PLUS && op(node) <= Token::NEQ && op(node) != Token::BANG &&
+                        child(node, first, Place::EXPRESSION, false) &&
+                        child(node, seconds[node], Place::EXPRESSION, false);
+                break;
+            case IF:
+                valid = child(node, first, Place::EXPRESSION, false) &&
+                        child(node, seconds[node], Place::BLOCK, false) &&
+                        child(node, thirds[node], Place::BLOCK, true);
+                break;
+            case LET:
+                valid = child(node, first, Place::IDENTIFIER, false) &&
+                        child(node, seconds[node], Place::EXPRESSION, true);
+                break;
+            case RETURN:
+            case EXPRESSION_STATEMENT:
+                valid = child(node, first, Place::EXPRESSION, true);
+                break;
+            case BLOCK:
+                valid = list(node, Place::STATEMENT);
+                break;
+        }
+        if (!valid)
+        {
+            return false;
+        }
+    }
+
+    for (auto statement : statements)
+    {
+        if (statement >= size() || !fits(kinds[statement], Place::STATEMENT))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The nodes are created from the last to the first, so that the children of
+// each node exist by the time it is created
+std::shared_ptr<Program> FlatAst::toProgram() const
+{
+    auto program = std::make_shared<Program>();
+    program->sources = sources;
+
+    std::vector<Node*> nodes(size());
+    auto expression = [&nodes](Index node) { return node == NONE ? nullptr : static_cast<Expression*>(nodes[node]); };
+    auto statement = [&nodes](Index node) { return node == NONE ? nullptr : static_cast<Statement*>(nodes[node]); };
+    auto list = [&](auto* type, Index node)
+    {
+        typedef std::remove_pointer_t<decltype(type)> T;
+        auto count = thirds[node];
+        if (count == 0)
+        {
+            return NodeList<T>();
+        }
+        auto items = static_cast<T**>(program->arena.allocate(sizeof(T*) * count, alignof(T*)));
+        for (Index i = 0; i < count; ++i)
+        {
+            items[i] = static_cast<T*>(nodes[lists[seconds[node] + i]]);
+        }
+        return NodeList<T>(items, count);
+    };
+
+    for (auto node = static_cast<Index>(size()); node-- > 0;)
+    {
+        auto first = firsts[node];
+        switch (kinds[node])
+        {
+            case IDENTIFIER:
+                nodes[node] = program->create<Identifier>(names[first], nameSymbols[first]);
+                break;
+            case INTEGER:
+                nodes[node] = program->create<Integer>(integers[first]);
+                break;
+            case BOOLEAN:
+                nodes[node] = program->create<Boolean>(first != 0);
+                break;
+            case FUNCTION:
+            {
+                auto function = program->create<Function>();
+                function->parameters = list(static_cast<Identifier*>(nullptr), node);
+                function->body = statement(first);
+                nodes[node] = function;
+                break;
+            }
+            case CALL:
+            {
+                auto call = program->create<CallExpression>();
+                call->function = expression(first);
+                call->arguments = list(static_cast<Expression*>(nullptr), node);
+                nodes[node] = call;
+                break;
+            }
+            case PREFIX:
+            {
+                auto prefix = program->create<PrefixExpression>(op(node));
+                prefix->right = expression(first);
+                nodes[node] = prefix;
+                break;
+            }
+            case INFIX:
+            {
+                auto infix = program->create<InfixExpression>(op(node));
+                infix->left = expression(first);
+                infix->right = expression(seconds[node]);
+                nodes[node] = infix;
+                break;
+            }
+            case IF:
+            {
+                auto ifExpression = program->create<IfExpression>();
+                ifExpression->condition = expression(first);
+                ifExpression->consequence = statement(seconds[node]);
+                ifExpression->alternative = statement(thirds[node]);
+                nodes[node] = ifExpression;
+                break;
+            }
+            case LET:
+            {
+                auto let = program->create<LetStatement>();
+                let->identifier = static_cast<Identifier*>(nodes[first]);
+                let->expression = expression(seconds[node]);
+                nodes[node] = let;
+                break;
+            }
+            case RETURN:
+            {
+                auto returnStatement = program->create<ReturnStatement>();
+                returnStatement->expression = expression(first);
+                nodes[node] = returnStatement;
+                break;
+            }
+            case EXPRESSION_STATEMENT:
+            {
+                auto expressionStatement = program->create<ExpressionStatement>();
+                expressionStatement->expression = expression(first);
+                nodes[node] = expressionStatement;
+                break;
+            }
+            case BLOCK:
+            {
+                auto block = program->create<BlockStatement>();
+                block->statements = list(static_cast<Statement*>(nullptr), node);
+                nodes[node] = block;
+                break;
+            }
+        }
+    }
+
+    program->statements.reserve(statements.size());
+    for (auto node : statements)
+    {
+        program->statements.push_back(statement(node));
+    }
+    return program;
+}
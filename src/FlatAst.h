@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#ifndef INTERPRETER_FLATAST_H
+#define INTERPRETER_FLATAST_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Ast.h"
+#include "SymbolTable.h"
+#include "Token.h"
+
+class SourceBuffer;
+
+// A compact copy of a Program. The nodes are numbered in the order of a
+// depth-first walk, and each property of a node is kept in an array of its
+// own, indexed by the node number. Nodes refer to their children by number.
+//
+// The meaning of the child fields depends on the kind of the node:
+//
+//   kind                  first        second / third
+//   IDENTIFIER            name         -
+//   INTEGER               value index  -
+//   BOOLEAN               0 or 1       -
+//   FUNCTION              body         parameter list
+//   CALL                  function     argument list
+//   PREFIX                right        -
+//   INFIX                 left         right
+//   IF                    condition    consequence / alternative (or NONE)
+//   LET                   identifier   expression
+//   RETURN                expression   -
+//   EXPRESSION_STATEMENT  expression   -
+//   BLOCK                 -            statement list
+//
+// A list is stored as the position of its first element in the lists array
+// (second) and its length (third). Names are numbered in the order they first
+// appear, so the name arrays only hold the names of the tree.
+class FlatAst
+{
+public:
+    typedef uint32_t Index;
+    static constexpr Index NONE = UINT32_MAX;
+
+    enum Kind : uint8_t
+    {
+        IDENTIFIER,
+        INTEGER,
+        BOOLEAN,
+        FUNCTION,
+        CALL,
+        PREFIX,
+        INFIX,
+        IF,
+        LET,
+        RETURN,
+        EXPRESSION_STATEMENT,
+        BLOCK
+    };
+
+    // A range of child node numbers
+    class List
+    {
+    public:
+        List(const Index* items, size_t count) : items(items), count(count) {}
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        Index operator[](size_t i) const { return items[i]; }
+        const Index* begin() const { return items; }
+        const Index* end() const { return items + count; }
+
+    private:
+        const Index* items;
+        size_t count;
+    };
+
+    explicit FlatAst(Program& program);
+
+    // The version of the serialized form, to be changed with its layout
+    static constexpr uint32_t formatVersion = 1;
+
+    // The arrays in a binary form. Identifiers are stored by name, so the
+    // form can be read back by another process.
+    std::string serialize() const;
+    // Returns null if the data is not a serialized FlatAst of this version,
+    // or if its nodes do not form a valid tree. The names are interned into
+    // the table.
+    static std::unique_ptr<FlatAst> deserialize(std::string_view data,
+                                                SymbolTable& symbols = SymbolTable::global());
+
+    // A Program with the same tree
+    std::shared_ptr<Program> toProgram() const;
+
+    size_t size() const { return kinds.size(); }
+    const std::vector<Index>& getStatements() const { return statements; }
+
+    Kind kind(Index node) const { return kinds[node]; }
+    // The token type of the operator of PREFIX and INFIX nodes
+    Token::TokenType op(Index node) const { return static_cast<Token::TokenType>(operators[node]); }
+    Index first(Index node) const { return firsts[node]; }
+    Index second(Index node) const { return seconds[node]; }
+    Index third(Index node) const { return thirds[node]; }
+    List children(Index node) const { return {lists.data() + seconds[node], thirds[node]}; }
+
+    int64_t integer(Index node) const { return integers[firsts[node]]; }
+    bool boolean(Index node) const { return firsts[node] != 0; }
+    std::string_view name(Index node) const { return names[firsts[node]]; }
+    // The symbol of the name of an IDENTIFIER node
+    uint32_t symbol(Index node) const { return nameSymbols[firsts[node]]; }
+
+    // The same text as Program::string() and Node::string()
+    std::string string() const;
+    std::string string(Index node) const;
+
+    // The bytes taken by the arrays
+    size_t memoryUsage() const;
+
+private:
+    std::vector<Kind> kinds;
+    std::vector<uint8_t> operators;
+    std::vector<Index> firsts;
+    std::vector<Index> seconds;
+    std::vector<Index> thirds;
+
+    std::vector<Index> lists;
+    std::vector<Index> statements;
+    std::vector<int64_t> integers;
+    // The names of the identifiers and their symbols, by name number
+    std::vector<std::string_view> names;
+    std::vector<uint32_t> nameSymbols;
+    std::vector<std::shared_ptr<const SourceBuffer>> sources;
+
+    class Converter;
+    class Reader;
+    FlatAst() = default;
+    bool isValid() const;
+    void write(Index node, std::string& out) const;
+    Index addNode(Kind kind, uint8_t op = 0, Index first = NONE, Index second = NONE, Index third = NONE);
+};
+
+#endif //INTERPRETER_FLATAST_H
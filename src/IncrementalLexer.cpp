@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include "IncrementalLexer.h"
+#include "Lexer.h"
+
+namespace
+{
+    // Reads one token at a time from the start of a buffer
+    class RegionLexer : public Lexer
+    {
+    public:
+        RegionLexer(std::shared_ptr<const SourceBuffer> source, SymbolTable& symbols) : Lexer(std::move(source))
+        {
+            setSymbolTable(symbols);
+        }
+
+        Token::TokenType read(size_t& start)
+        {
+            type = readToken(start);
+            return type;
+        }
+
+        // The end of the token that was just read
+        size_t end() const
+        {
+            return curPos;
+        }
+
+        // Add the token that was just read, for a buffer that starts at base
+        void add(TokenBuffer& tokens, size_t start, size_t base)
+        {
+            tokens.add(type, base + start, curPos - start, tokenValue(type, start));
+        }
+
+    private:
+        Token::TokenType type = Token::ILLEGAL;
+    };
+}
+
+IncrementalLexer::IncrementalLexer(std::shared_ptr<const SourceBuffer> source) :
+        IncrementalLexer(std::move(source), std::make_unique<SymbolTable>(), nullptr) {}
+
+IncrementalLexer::IncrementalLexer(std::shared_ptr<const SourceBuffer> source, SymbolTable& symbols) :
+        IncrementalLexer(std::move(source), nullptr, &symbols) {}
+
+IncrementalLexer::IncrementalLexer(std::shared_ptr<const SourceBuffer> source,
+                                   std::unique_ptr<SymbolTable> ownSymbols, SymbolTable* symbols) :
+        textSize(source->size()),
+        ownSymbols(std::move(ownSymbols)),
+        symbols(symbols != nullptr ? *symbols : *this->ownSymbols)
+{
+    lineStarts.push_back(0);
+    auto text = source->text();
+    for (auto newline = text.find('\n'); newline != std::string_view::npos; newline = text.find('\n', newline + 1))
+    {
+        lineStarts.push_back(newline + 1);
+    }
+
+    Lexer lexer(source);
+    lexer.setSymbolTable(this->symbols);
+    tokens = lexer.tokenizeAll();
+    pieces.push_back({0, std::move(source), 0});
+}
+
+IncrementalLexer::Change IncrementalLexer::apply(const Edit& edit)
+{
+    if (edit.offset > textSize || edit.removed > textSize - edit.offset)
+    {
+        throw std::out_of_range("edit outside of the source");
+    }
+
+    // The first token that ends at or after the edit. A token that ends right
+    // at the edit is included, as the lexer looked at the next character to
+    // find its end. The EOF token ends at the end of the source, so there is
+    // always such a token.
+    size_t first = 0;
+    {
+        size_t low = 0;
+        size_t high = tokens.size() - 1;
+        while (low < high)
+        {
+            auto middle = (low + high) / 2;
+            if (tokens.offset(middle) + tokens.length(middle) < edit.offset)
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+        first = low;
+    }
+
+    auto delta = static_cast<int64_t>(edit.inserted.size()) - static_cast<int64_t>(edit.removed);
+    auto editEnd = edit.offset + edit.inserted.size();
+    auto oldEditEnd = edit.offset + edit.removed;
+    size_t start = std::min<size_t>(tokens.offset(first), edit.offset);
+
+    // The text from start is read again into a new buffer, up to a token that
+    // starts where an old one started. Where that is only shows while reading,
+    // so some of the old text after the edit is copied as well, twice as much
+    // each time it is not enough. The tokens at the end of the buffer are only
+    // known to be complete at the end of the text.
+    std::shared_ptr<const SourceBuffer> region;
+    TokenBuffer changed;
+    size_t old = first;
+    size_t end = 0;
+    for (size_t extra = 64;; extra *= 2)
+    {
+        auto copyEnd = std::min(textSize, oldEditEnd + extra);
+        bool last = (copyEnd == textSize);
+        std::string text;
+        text.reserve(edit.offset - start + edit.inserted.size() + copyEnd - oldEditEnd);
+        appendText(start, edit.offset, text);
+        text.append(edit.inserted);
+        appendText(oldEditEnd, copyEnd, text);
+        region = std::make_shared<const SourceBuffer>(std::move(text));
+
+        changed = TokenBuffer();
+        changed.addSource(region, start);
+        RegionLexer lexer(region, symbols);
+        old = first;
+        bool complete = false;
+        while (true)
+        {
+            size_t tokenStart;
+            auto type = lexer.read(tokenStart);
+            if (!last && tokenStart >= region->size())
+            {
+                break;
+            }
+            if (start + tokenStart >= editEnd)
+            {
+                // Skip the old tokens that start before this one; they were replaced
+                auto oldStart = static_cast<int64_t>(start + tokenStart) - delta;
+                while (old < tokens.size() && static_cast<int64_t>(tokens.offset(old)) < oldStart)
+                {
+                    ++old;
+                }
+                if (old < tokens.size() && static_cast<int64_t>(tokens.offset(old)) == oldStart)
+                {
+                    end = start + tokenStart;
+                    complete = true;
+                    break;
+                }
+            }
+            if (!last && lexer.end() >= region->size())
+            {
+                break;
+            }
+            lexer.add(changed, tokenStart, start);
+            if (type == Token::ENDOFFILE)
+            {
+                old = tokens.size();
+                end = start + region->size();
+                complete = true;
+                break;
+            }
+        }
+        if (complete)
+        {
+            break;
+        }
+    }
+
+    tokens.replace(first, old - first, changed, delta);
+    replacePieces(start, static_cast<size_t>(static_cast<int64_t>(end) - delta), region, delta);
+    updateLineStarts(edit);
+    textSize = static_cast<size_t>(static_cast<int64_t>(textSize) + delta);
+    if (pieces.size() > maxPieces)
+    {
+        joinPieces();
+    }
+    return {first, old - first, changed.size()};
+}
+
+const TokenBuffer& IncrementalLexer::getTokens() const
+{
+    return tokens;
+}
+
+SymbolTable& IncrementalLexer::getSymbolTable() const
+{
+    return symbols;
+}
+
+size_t IncrementalLexer::size() const
+{
+    return textSize;
+}
+
+std::shared_ptr<const SourceBuffer> IncrementalLexer::getSource() const
+{
+    std::string text;
+    text.reserve(textSize);
+    appendText(0, textSize, text);
+    return std::make_shared<const SourceBuffer>(std::move(text));
+}
+
+SourceBuffer::Location IncrementalLexer::location(size_t offset) const
+{
+    auto next = std::upper_bound(lineStarts.begin(), lineStarts.end(), offset);
+    auto line = static_cast<size_t>(next - lineStarts.begin());
+    return {line, offset - lineStarts[line - 1] + 1};
+}
+
+void IncrementalLexer::appendText(size_t from, size_t to, std::string& text) const
+{
+    if (from >= to)
+    {
+        return;
+    }
+    auto piece = std::upper_bound(pieces.begin(), pieces.end(), from,
+                                  [](size_t offset, const Piece& p) { return offset < p.start; }) - 1;
+    while (from < to)
+    {
+        auto pieceEnd = piece + 1 != pieces.end() ? (piece + 1)->start : textSize;
+        auto count = std::min(to, pieceEnd) - from;
+        text.append(piece->buffer->data() + piece->bufferStart + (from - piece->start), count);
+        from += count;
+        ++piece;
+    }
+}
+
+// The old text from start up to oldEnd was replaced by the start of the
+// buffer; the pieces after it move by delta
+void IncrementalLexer::replacePieces(size_t start, size_t oldEnd, const std::shared_ptr<const SourceBuffer>& buffer,
+                                     int64_t delta)
+{
+    auto byStart = [](size_t offset, const Piece& p) { return offset < p.start; };
+    auto before = std::upper_bound(pieces.begin(), pieces.end(), start, byStart);
+    auto after = std::upper_bound(before, pieces.end(), oldEnd, byStart);
+
+    std::vector<Piece> result(pieces.begin(), before);
+    if (!result.empty() && result.back().start == start)
+    {
+        result.pop_back();
+    }
+    auto newEnd = static_cast<size_t>(static_cast<int64_t>(oldEnd) + delta);
+    if (newEnd > start)
+    {
+        result.push_back({start, buffer, 0});
+    }
+    if (oldEnd < textSize)
+    {
+        // The rest of the piece that the old text ended in
+        const auto& cut = *(after - 1);
+        result.push_back({newEnd, cut.buffer, cut.bufferStart + (oldEnd - cut.start)});
+    }
+    for (auto piece = after; piece != pieces.end(); ++piece)
+    {
+        result.push_back({static_cast<size_t>(static_cast<int64_t>(piece->start) + delta), piece->buffer,
+                          piece->bufferStart});
+    }
+    pieces = std::move(result);
+}
+
+void IncrementalLexer::updateLineStarts(const Edit& edit)
+{
+    auto from = std::upper_bound(lineStarts.begin(), lineStarts.end(), edit.offset);
+    auto to = std::upper_bound(from, lineStarts.end(), edit.offset + edit.removed);
+    auto delta = static_cast<size_t>(static_cast<int64_t>(edit.inserted.size()) - static_cast<int64_t>(edit.removed));
+    for (auto lineStart = to; lineStart != lineStarts.end(); ++lineStart)
+    {
+        *lineStart += delta;
+    }
+
+    std::vector<size_t> added;
+    for (size_t i = 0; i < edit.inserted.size(); ++i)
+    {
+        if (edit.inserted[i] == '\n')
+        {
+            added.push_back(edit.offset + i + 1);
+        }
+    }
+    auto position = lineStarts.erase(from, to);
+    lineStarts.insert(position, added.begin(), added.end());
+}
+
+void IncrementalLexer::joinPieces()
+{
+    auto source = getSource();
+    pieces.assign(1, {0, source, 0});
+    tokens.replaceSource(std::move(source));
+}
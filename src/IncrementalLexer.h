@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#ifndef INTERPRETER_INCREMENTALLEXER_H
+#define INTERPRETER_INCREMENTALLEXER_H
+
+#include <memory>
+#include <string_view>
+#include <vector>
+#include "SourceBuffer.h"
+#include "SymbolTable.h"
+#include "TokenBuffer.h"
+
+// Keeps the tokens of a source up to date while the source is edited.
+//
+// The lexer does not carry any state from one token to the next, so after an
+// edit only the tokens from the one before the edit are read again. Reading
+// stops at the first token that starts where an old token started, past the
+// edited text; from there on, the old tokens are still valid and are only
+// moved by the change in length.
+//
+// The text is kept as a list of pieces of source buffers. An edit copies only
+// the text that is read again into a new buffer, which becomes the piece for
+// that part of the text, and the new tokens read their literals from it. The
+// rest of the text stays in the buffers it was in. Once there are many
+// pieces, they are joined into a single buffer again.
+//
+// Identifier names are interned into a symbol table of the lexer's own by
+// default. The names of tokens that an edit replaced, such as the prefixes of
+// a name being typed, stay in the table, so the table lives only as long as
+// the lexer. This also lets lexers of different sources run on different
+// threads. A table given by the caller must outlive the lexer, and collects
+// the names of all its edits.
+class IncrementalLexer
+{
+public:
+    // Replace removed bytes at offset with the inserted text
+    struct Edit
+    {
+        size_t offset;
+        size_t removed;
+        std::string_view inserted;
+    };
+
+    // The tokens [first, first + oldCount) were replaced by the tokens
+    // [first, first + newCount)
+    struct Change
+    {
+        size_t first;
+        size_t oldCount;
+        size_t newCount;
+    };
+
+    explicit IncrementalLexer(std::shared_ptr<const SourceBuffer> source);
+    IncrementalLexer(std::shared_ptr<const SourceBuffer> source, SymbolTable& symbols);
+
+    // Throws std::out_of_range if the edit is not within the source
+    Change apply(const Edit& edit);
+
+    // The sources of the tokens may only hold a piece of the text, so their
+    // locations are found with location() below
+    const TokenBuffer& getTokens() const;
+    // The length of the text
+    size_t size() const;
+    // A buffer with the whole text, which is put together on each call
+    std::shared_ptr<const SourceBuffer> getSource() const;
+    // As SourceBuffer::location, for the current text
+    SourceBuffer::Location location(size_t offset) const;
+    // The table that the values of the IDENTIFIER tokens are symbols of
+    SymbolTable& getSymbolTable() const;
+
+private:
+    static constexpr size_t maxPieces = 1024;
+
+    // The text from start up to the start of the next piece, which is kept in
+    // a buffer from bufferStart on
+    struct Piece
+    {
+        size_t start;
+        std::shared_ptr<const SourceBuffer> buffer;
+        size_t bufferStart;
+    };
+
+    std::vector<Piece> pieces;
+    size_t textSize;
+    // The offsets at which lines start, the first line included
+    std::vector<size_t> lineStarts;
+    std::unique_ptr<SymbolTable> ownSymbols;
+    SymbolTable& symbols;
+    TokenBuffer tokens;
+
+    // Uses the table of its own if symbols is null
+    IncrementalLexer(std::shared_ptr<const SourceBuffer> source, std::unique_ptr<SymbolTable> ownSymbols,
+                     SymbolTable* symbols);
+
+    void appendText(size_t from, size_t to, std::string& text) const;
+    void replacePieces(size_t start, size_t oldEnd, const std::shared_ptr<const SourceBuffer>& buffer, int64_t delta);
+    void updateLineStarts(const Edit& edit);
+    void joinPieces();
+};
+
+#endif //INTERPRETER_INCREMENTALLEXER_H
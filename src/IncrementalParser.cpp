@@ -0,0 +1,533 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include <algorithm>
+#include <iterator>
+#include <unordered_map>
+#include "IncrementalParser.h"
+
+namespace
+{
+
+// Move the positions of a block from a position on
+void moveBlock(Parser::BlockRecord& block, size_t from, int64_t delta)
+{
+    if (block.open >= from)
+    {
+        block.open += delta;
+    }
+    if (block.close >= from)
+    {
+        block.close += delta;
+    }
+    for (auto start = std::lower_bound(block.starts.begin(), block.starts.end(), from); start != block.starts.end();
+         ++start)
+    {
+        *start += delta;
+    }
+}
+
+}
+
+// The first range from low on for which the condition does not hold, for a
+// condition that holds for all ranges before some index
+template<typename Condition>
+size_t IncrementalParser::findRange(size_t low, Condition condition) const
+{
+    auto high = ranges.size();
+    while (low < high)
+    {
+        auto middle = low + (high - low) / 2;
+        if (condition(middle))
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+IncrementalParser::IncrementalParser(const TokenBuffer& tokens, size_t nestingLimit) : nestingLimit(nestingLimit)
+{
+    Reparse result;
+    reparse(tokens, 0, tokens.size() - 1, {}, 0, result);
+    numberRanges(result, 0, 0);
+    program = std::move(result.program);
+    ranges = std::move(result.ranges);
+    errors = std::move(result.errors);
+    shiftFrom = ranges.size();
+    shift = {0, 0, 0};
+    sourceBytes = 0;
+    for (const auto& source : program->sources)
+    {
+        sourceBytes += source->size();
+    }
+    compactedSize = programSize();
+}
+
+size_t IncrementalParser::update(const TokenBuffer& tokens, const IncrementalLexer::Change& change)
+{
+    // The first statement that may have looked at a changed token. A
+    // statement that ends right at the change looked at the token there to
+    // find its end.
+    auto affected = findRange(0, [&](size_t index) { return rangeEnd(index) < change.first; });
+
+    size_t reparsed;
+    if (!updateBlock(tokens, change, affected, reparsed))
+    {
+        reparsed = updateStatements(tokens, change, affected);
+    }
+    compactIfGrown();
+    return reparsed;
+}
+
+// Parse the statements of the innermost block around the change again, as
+// update() does for the top-level statements. Returns false if that cannot
+// be done, or if it fails, and leaves the program as it was.
+bool IncrementalParser::updateBlock(const TokenBuffer& tokens, const IncrementalLexer::Change& change,
+                                    size_t affected, size_t& reparsed)
+{
+    if (affected >= ranges.size())
+    {
+        return false;
+    }
+    moveShift(affected + 1);
+    auto& range = ranges[affected];
+    if (range.statement == nullptr || range.errorCount > 0 || change.first <= range.first)
+    {
+        return false;
+    }
+
+    // The innermost block that opens before the change and closes after it.
+    // The blocks are in the order of their opening braces, so it is the last
+    // of those that open before the change that still closes after it.
+    auto changeFirst = change.first - range.first;
+    auto changeEnd = changeFirst + change.oldCount;
+    auto& blocks = range.blocks;
+    size_t index = std::partition_point(blocks.begin(), blocks.end(),
+                                        [&](const Parser::BlockRecord& block)
+                                        {
+                                            return block.open < changeFirst;
+                                        }) - blocks.begin();
+    while (index > 0 && blocks[index - 1].close < changeEnd)
+    {
+        --index;
+    }
+    if (index == 0 || blocks[index - 1].depth >= nestingLimit)
+    {
+        return false;
+    }
+    auto& block = blocks[index - 1];
+    auto& starts = block.starts;
+
+    // The first statement of the block that may have looked at a changed
+    // token, as for the top-level statements, and the statements that start
+    // after the change, where parsing may stop. The closing brace is the last
+    // place to stop.
+    auto delta = static_cast<int64_t>(change.newCount) - static_cast<int64_t>(change.oldCount);
+    size_t inner = starts.empty() ? 0 : std::lower_bound(starts.begin() + 1, starts.end(), changeFirst) - starts.begin() - 1;
+    size_t resync = std::lower_bound(starts.begin() + inner, starts.end(), changeEnd) - starts.begin();
+    size_t first = range.first + (inner < starts.size() ? starts[inner] : block.open + 1);
+
+    Reparse result;
+    std::vector<size_t> stops;
+    for (size_t count = 1;; count *= 2)
+    {
+        auto remaining = starts.size() - resync + 1;
+        stops.clear();
+        for (size_t i = resync; i < resync + std::min(count, remaining); ++i)
+        {
+            stops.push_back(range.first + (i < starts.size() ? starts[i] : block.close) + delta);
+        }
+        if (reparse(tokens, first, stops.back(), stops, block.depth, result))
+        {
+            break;
+        }
+        if (count >= remaining)
+        {
+            return false;
+        }
+    }
+    if (result.errors.size() > 0)
+    {
+        return false;
+    }
+    size_t kept = resync + (std::find(stops.begin(), stops.end(), result.end) - stops.begin());
+
+    reparsed = result.ranges.size();
+    takeProgram(*result.program, block.block, inner, kept - inner);
+    if (errors.size() > 0)
+    {
+        replaceErrors(tokens, range.errorIndex, 0, ParserErrors(), delta);
+    }
+
+    // The blocks that open before the new statements keep their place, those
+    // in the old statements give way to those in the new ones, and the rest
+    // move along with the tokens
+    auto replacedFirst = first - range.first;
+    auto replacedEnd = kept < starts.size() ? starts[kept] : block.close;
+    auto replaced = std::partition_point(blocks.begin(), blocks.end(),
+                                         [&](const Parser::BlockRecord& record)
+                                         {
+                                             return record.open < replacedFirst;
+                                         });
+    auto replacedBlocksEnd = std::partition_point(replaced, blocks.end(),
+                                                  [&](const Parser::BlockRecord& record)
+                                                  {
+                                                      return record.open < replacedEnd;
+                                                  });
+    for (auto record = blocks.begin(); record != replaced; ++record)
+    {
+        moveBlock(*record, replacedEnd, delta);
+    }
+    for (auto record = replacedBlocksEnd; record != blocks.end(); ++record)
+    {
+        moveBlock(*record, 0, delta);
+    }
+    std::vector<size_t> newStarts;
+    for (const auto& statement : result.ranges)
+    {
+        newStarts.push_back(statement.first - range.first);
+    }
+    starts.erase(starts.begin() + inner, starts.begin() + kept);
+    starts.insert(starts.begin() + inner, newStarts.begin(), newStarts.end());
+    auto depth = block.depth;
+    for (auto& record : result.blocks)
+    {
+        moveBlock(record, 0, -static_cast<int64_t>(range.first));
+        record.depth += depth;
+    }
+    replaced = blocks.erase(replaced, replacedBlocksEnd);
+    blocks.insert(replaced, std::make_move_iterator(result.blocks.begin()),
+                  std::make_move_iterator(result.blocks.end()));
+
+    range.end += delta;
+    shift.positions += delta;
+    return true;
+}
+
+size_t IncrementalParser::updateStatements(const TokenBuffer& tokens, const IncrementalLexer::Change& change,
+                                           size_t affected)
+{
+    auto delta = static_cast<int64_t>(change.newCount) - static_cast<int64_t>(change.oldCount);
+    size_t first = affected > 0 ? rangeEnd(affected - 1) : 0;
+
+    // The old statements that start after the change, where parsing may stop
+    auto changeEnd = change.first + change.oldCount;
+    auto resync = findRange(affected, [&](size_t index) { return rangeFirst(index) < changeEnd; });
+
+    // Most edits change a single statement, so the parser is first given the
+    // tokens up to the start of the next old statement. Each time a statement
+    // runs past its tokens, the number of old statements given is doubled,
+    // until all of the tokens are given.
+    Reparse result;
+    std::vector<size_t> starts;
+    for (size_t count = 1;; count *= 2)
+    {
+        auto remaining = ranges.size() - resync;
+        starts.clear();
+        for (size_t i = resync; i < resync + std::min(count, remaining); ++i)
+        {
+            starts.push_back(rangeFirst(i) + delta);
+        }
+        auto windowEnd = count > remaining ? tokens.size() - 1 : starts.back();
+        if (reparse(tokens, first, windowEnd, starts, 0, result))
+        {
+            break;
+        }
+    }
+
+    auto stop = std::find(starts.begin(), starts.end(), result.end);
+    size_t kept = stop != starts.end() ? resync + (stop - starts.begin()) : ranges.size();
+
+    // Replace the statements and errors of the ranges from affected up to
+    // kept with the new ones
+    auto statementFirst = statementIndex(affected);
+    auto statementCount = statementIndex(kept) - statementFirst;
+    auto errorFirst = errorIndex(affected);
+    auto errorCount = errorIndex(kept) - errorFirst;
+    auto addedStatements = result.program->statements.size();
+    numberRanges(result, statementFirst, errorFirst);
+    takeProgram(*result.program, nullptr, statementFirst, statementCount);
+    replaceErrors(tokens, errorFirst, errorCount, result.errors, delta);
+
+    // The ranges after kept take on the shift of this edit as well
+    moveShift(kept);
+    auto added = result.ranges.size();
+    if (kept - affected == added)
+    {
+        std::move(result.ranges.begin(), result.ranges.end(), ranges.begin() + affected);
+    }
+    else
+    {
+        auto position = ranges.erase(ranges.begin() + affected, ranges.begin() + kept);
+        ranges.insert(position, std::make_move_iterator(result.ranges.begin()),
+                      std::make_move_iterator(result.ranges.end()));
+    }
+    shiftFrom = affected + added;
+    shift.positions += delta;
+    shift.statements += static_cast<int64_t>(addedStatements) - static_cast<int64_t>(statementCount);
+    shift.errors += static_cast<int64_t>(result.errors.size()) - static_cast<int64_t>(errorCount);
+    return added;
+}
+
+// Give the new ranges their indexes, from those of the first one on, and the
+// records of the blocks in them
+void IncrementalParser::numberRanges(Reparse& result, size_t statement, size_t error)
+{
+    auto block = result.blocks.begin();
+    for (auto& range : result.ranges)
+    {
+        range.statementIndex = statement;
+        range.errorIndex = error;
+        statement += range.statement != nullptr;
+        error += range.errorCount;
+        for (; block != result.blocks.end() && block->open < range.end; ++block)
+        {
+            if (range.errorCount == 0)
+            {
+                range.blocks.push_back(std::move(*block));
+                moveBlock(range.blocks.back(), 0, -static_cast<int64_t>(range.first));
+            }
+        }
+    }
+}
+
+// Splice the statements of the other program into the program, or into one
+// of its blocks, and count the bytes of the sources that came with them
+void IncrementalParser::takeProgram(Program& other, BlockStatement* block, size_t first, size_t count)
+{
+    auto sourceCount = program->sources.size();
+    if (block != nullptr)
+    {
+        program->splice(*block, first, count, other);
+    }
+    else
+    {
+        program->splice(first, count, other);
+    }
+    for (size_t i = sourceCount; i < program->sources.size(); ++i)
+    {
+        sourceBytes += program->sources[i]->size();
+    }
+}
+
+// Replace count errors from first on with the added ones and move those
+// after them. The literals of all errors are read again, as the old source
+// may be gone.
+void IncrementalParser::replaceErrors(const TokenBuffer& tokens, size_t first, size_t count,
+                                      const ParserErrors& added, int64_t delta)
+{
+    ParserErrors merged;
+    auto addError = [&](ParserError error)
+    {
+        error.literal = tokens.literal(error.position);
+        merged.add(error);
+    };
+    for (size_t i = 0; i < first; ++i)
+    {
+        addError(errors.record(i));
+    }
+    for (size_t i = 0; i < added.size(); ++i)
+    {
+        addError(added.record(i));
+    }
+    for (size_t i = first + count; i < errors.size(); ++i)
+    {
+        auto error = errors.record(i);
+        error.position += delta;
+        addError(error);
+    }
+    errors = std::move(merged);
+}
+
+size_t IncrementalParser::rangeFirst(size_t index) const
+{
+    return ranges[index].first + (index >= shiftFrom ? shift.positions : 0);
+}
+
+size_t IncrementalParser::rangeEnd(size_t index) const
+{
+    return ranges[index].end + (index >= shiftFrom ? shift.positions : 0);
+}
+
+size_t IncrementalParser::statementIndex(size_t index) const
+{
+    if (index == ranges.size())
+    {
+        return program->statements.size();
+    }
+    return ranges[index].statementIndex + (index >= shiftFrom ? shift.statements : 0);
+}
+
+size_t IncrementalParser::errorIndex(size_t index) const
+{
+    if (index == ranges.size())
+    {
+        return errors.size();
+    }
+    return ranges[index].errorIndex + (index >= shiftFrom ? shift.errors : 0);
+}
+
+// Move the ranges before index by the shift, or take it back from those from
+// index on, so that it applies to the ranges from index on
+void IncrementalParser::moveShift(size_t index) const
+{
+    auto move = [this](StatementRange& range, int64_t sign)
+    {
+        range.first += sign * shift.positions;
+        range.end += sign * shift.positions;
+        range.statementIndex += sign * shift.statements;
+        range.errorIndex += sign * shift.errors;
+    };
+    if (shift.positions != 0 || shift.statements != 0 || shift.errors != 0)
+    {
+        for (; shiftFrom < index; ++shiftFrom)
+        {
+            move(ranges[shiftFrom], 1);
+        }
+        for (; shiftFrom > index; --shiftFrom)
+        {
+            move(ranges[shiftFrom - 1], -1);
+        }
+    }
+    shiftFrom = index;
+    if (shiftFrom == ranges.size())
+    {
+        shift = {0, 0, 0};
+    }
+}
+
+// Parse the statements from the token at first on, until a statement starts
+// at one of the given positions or the tokens end. Only the tokens up to
+// windowEnd are given to the parser, followed by an EOF token unless they end
+// with the real one. Returns false if a statement goes past windowEnd, as it
+// may then have been cut short by the EOF token. A statement that ends at
+// windowEnd looked at the real token there to find its end. The statements
+// are parsed as if they were in a block at the given depth.
+bool IncrementalParser::reparse(const TokenBuffer& tokens, size_t first, size_t windowEnd,
+                                const std::vector<size_t>& starts, size_t depth, Reparse& result) const
+{
+    bool last = windowEnd + 1 >= tokens.size();
+    auto sliceTokens = tokens.slice(first, last ? tokens.size() : windowEnd + 1);
+    if (!last)
+    {
+        sliceTokens.add(Token::ENDOFFILE, tokens.offset(windowEnd) + tokens.length(windowEnd), 0);
+    }
+
+    Parser parser(std::move(sliceTokens));
+    parser.setNestingLimit(nestingLimit - depth);
+    result.blocks.clear();
+    parser.recordBlocks(&result.blocks);
+    result.program = std::make_shared<Program>();
+    result.ranges.clear();
+    auto start = starts.begin();
+    while (true)
+    {
+        auto position = first + parser.getPosition();
+        start = std::lower_bound(start, starts.end(), position);
+        if ((start != starts.end() && *start == position) || parser.atEnd())
+        {
+            result.end = position;
+            break;
+        }
+
+        auto errorCount = parser.errors.size();
+        auto statement = parser.parseTopLevelStatement(*result.program);
+        auto end = first + parser.getPosition();
+        if (!last && end > windowEnd)
+        {
+            return false;
+        }
+        if (statement != nullptr)
+        {
+            result.program->addStatement(statement);
+        }
+        result.ranges.push_back({position, end, statement, parser.errors.size() - errorCount, 0, 0, {}});
+    }
+
+    result.errors = ParserErrors();
+    for (size_t i = 0; i < parser.errors.size(); ++i)
+    {
+        auto error = parser.errors.record(i);
+        error.position += first;
+        result.errors.add(error);
+    }
+    for (auto& block : result.blocks)
+    {
+        moveBlock(block, 0, static_cast<int64_t>(first));
+    }
+    return true;
+}
+
+size_t IncrementalParser::programSize() const
+{
+    return program->arena.bytesUsed() + sourceBytes;
+}
+
+// Compacting copies the whole tree, so it is only done after the program has
+// doubled in size, which keeps its cost in proportion to the edits
+void IncrementalParser::compactIfGrown()
+{
+    auto size = programSize();
+    if (size - std::min(size, compactedSize) <= std::max(compactedSize, minimumGrowth))
+    {
+        return;
+    }
+
+    moveShift(ranges.size());
+    std::unordered_map<const BlockStatement*, BlockStatement*> blockCopies;
+    program->compact(&blockCopies);
+    for (auto& range : ranges)
+    {
+        if (range.statement != nullptr)
+        {
+            range.statement = program->statements[range.statementIndex];
+        }
+        for (auto& block : range.blocks)
+        {
+            block.block = blockCopies.at(block.block);
+        }
+    }
+    sourceBytes = 0;
+    for (const auto& source : program->sources)
+    {
+        sourceBytes += source->size();
+    }
+    compactedSize = programSize();
+}
+
+const std::shared_ptr<Program>& IncrementalParser::getProgram() const
+{
+    return program;
+}
+
+const std::vector<IncrementalParser::StatementRange>& IncrementalParser::getRanges() const
+{
+    moveShift(ranges.size());
+    return ranges;
+}
+
+const ParserErrors& IncrementalParser::getErrors() const
+{
+    return errors;
+}
+
+std::vector<std::string> IncrementalParser::diagnostics(const IncrementalLexer& lexer) const
+{
+    std::vector<std::string> result;
+    for (size_t i = 0; i < errors.size(); ++i)
+    {
+        auto location = lexer.location(lexer.getTokens().offset(errors.record(i).position));
+        result.push_back(std::to_string(location.line) + ":" + std::to_string(location.column) + ": " + errors[i]);
+    }
+    return result;
+}
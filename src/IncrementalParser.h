@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#ifndef INTERPRETER_INCREMENTALPARSER_H
+#define INTERPRETER_INCREMENTALPARSER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Ast.h"
+#include "IncrementalLexer.h"
+#include "Parser.h"
+#include "ParserError.h"
+#include "TokenBuffer.h"
+
+// Keeps the program of a source up to date while its tokens are edited, as
+// reported by the IncrementalLexer.
+//
+// The token range of each top-level statement is recorded. After an edit,
+// parsing starts again at the first statement that may have seen the edited
+// tokens and goes on until a statement starts where an old statement started
+// past the edit. The parser carries no state from one top-level statement to
+// the next, so from there on the old statements are kept as they are: their
+// nodes are not touched and their ranges are only moved. The program and the
+// errors are thus the same as those of parsing the whole source again, but
+// the statements that were not reparsed keep their identity until the
+// program is compacted.
+//
+// The same is done for the statements of the innermost block around an edit,
+// e.g. in a function body, if the top-level statement has no errors. The
+// parser does not carry state from one statement of a block to the next
+// either, except for the depth that counts towards the nesting limit, which
+// is recorded with the block. If the statements of the block do not parse
+// without errors, or run past its closing brace, the top-level statements
+// are parsed again instead.
+//
+// The ranges are found by binary search. The ranges after an edit are only
+// moved when an edit before them or getRanges() needs them, so that an edit
+// costs time in proportion to the statements it touches and the distance
+// from the edit before it.
+//
+// The nodes of replaced statements stay in the arena of the program, and the
+// sources of new statements are added to it. Once its arena and sources have
+// grown to twice their size after the last compaction, the program is
+// compacted, which moves all statements and releases the sources that no
+// statement refers to any more.
+class IncrementalParser
+{
+public:
+    // The tokens of a top-level statement, from first up to end, and the
+    // number of errors found in them. The statement is null if it failed to
+    // parse.
+    struct StatementRange
+    {
+        size_t first;
+        size_t end;
+        Statement* statement;
+        size_t errorCount;
+        // The index of the statement in the program, or of the next one if it
+        // failed to parse, and the index of its first error
+        size_t statementIndex;
+        size_t errorIndex;
+        // The blocks in the statement, with their token positions counted
+        // from first. Only kept if the statement has no errors.
+        std::vector<Parser::BlockRecord> blocks;
+    };
+
+    explicit IncrementalParser(const TokenBuffer& tokens, size_t nestingLimit = Parser::defaultNestingLimit);
+
+    // Parse again after the tokens were changed as described. Returns the
+    // number of statements that were parsed again.
+    size_t update(const TokenBuffer& tokens, const IncrementalLexer::Change& change);
+
+    const std::shared_ptr<Program>& getProgram() const;
+    const std::vector<StatementRange>& getRanges() const;
+    // The errors of the whole program, with their positions in the tokens
+    const ParserErrors& getErrors() const;
+    // As Parser::diagnostics, for the current tokens of the lexer
+    std::vector<std::string> diagnostics(const IncrementalLexer& lexer) const;
+
+private:
+    // The growth that never causes a compaction, so that small programs are
+    // not compacted after every few edits
+    static constexpr size_t minimumGrowth = 64 * 1024;
+
+    size_t nestingLimit;
+    std::shared_ptr<Program> program;
+    ParserErrors errors;
+    // The bytes of the sources of the program
+    size_t sourceBytes;
+    // The bytes of the arena and the sources after the last compaction
+    size_t compactedSize;
+
+    // The ranges from shiftFrom on have not been moved by the edits before
+    // them yet: their positions and indexes lack the shift
+    struct Shift
+    {
+        int64_t positions;
+        int64_t statements;
+        int64_t errors;
+    };
+    mutable std::vector<StatementRange> ranges;
+    mutable size_t shiftFrom;
+    mutable Shift shift;
+
+    // The statements parsed from a token on, up to the token at end, and
+    // the blocks in them
+    struct Reparse
+    {
+        std::shared_ptr<Program> program;
+        std::vector<StatementRange> ranges;
+        ParserErrors errors;
+        std::vector<Parser::BlockRecord> blocks;
+        size_t end;
+    };
+
+    bool reparse(const TokenBuffer& tokens, size_t first, size_t windowEnd, const std::vector<size_t>& starts,
+                 size_t depth, Reparse& result) const;
+    bool updateBlock(const TokenBuffer& tokens, const IncrementalLexer::Change& change, size_t affected,
+                     size_t& reparsed);
+    size_t updateStatements(const TokenBuffer& tokens, const IncrementalLexer::Change& change, size_t affected);
+    static void numberRanges(Reparse& result, size_t statement, size_t error);
+    void takeProgram(Program& other, BlockStatement* block, size_t first, size_t count);
+    void replaceErrors(const TokenBuffer& tokens, size_t first, size_t count, const ParserErrors& added,
+                       int64_t delta);
+
+    template<typename Condition>
+    size_t findRange(size_t low, Condition condition) const;
+    size_t rangeFirst(size_t index) const;
+    size_t rangeEnd(size_t index) const;
+    size_t statementIndex(size_t index) const;
+    size_t errorIndex(size_t index) const;
+    void moveShift(size_t index) const;
+
+    size_t programSize() const;
+    void compactIfGrown();
+};
+
+#endif //INTERPRETER_INCREMENTALPARSER_H
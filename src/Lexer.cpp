@@ -6,126 +6,298 @@
  *
  */
 
+#include <array>
+#include <cstdint>
+#include "CharScanner.h"
 #include "Lexer.h"
 
-Lexer::Lexer(const char *input) : input {input}
+namespace
 {
-    curPos = 0;
-    readPos = 0;
-    currentChar = 0;
-    EOFFound = false;
-    readChar();
-}
-
-Lexer::~Lexer() = default;
+    enum CharClass : uint8_t
+    {
+        OTHER,
+        END,
+        WHITE_SPACE,
+        LETTER,
+        DIGIT,
+        OPERATOR
+    };
+
+    struct Operator
+    {
+        std::string_view spelling;
+        Token::TokenType type;
+    };
+
+    // To add an operator, add it to this list. The first character of a two
+    // character operator does not have to be an operator of its own (it is
+    // then ILLEGAL when it appears alone).
+    constexpr Operator operators[] =
+    {
+        {"=", Token::ASSIGN},
+        {"==", Token::EQ},
+        {"+", Token::PLUS},
+        {"-", Token::MINUS},
+        {"!", Token::BANG},
+        {"!=", Token::NEQ},
+        {"*", Token::ASTERISK},
+        {"/", Token::SLASH},
+        {"<", Token::LT},
+        {">", Token::GT},
+        {"(", Token::LPAREN},
+        {")", Token::RPAREN},
+        {"{", Token::LBRACE},
+        {"}", Token::RBRACE},
+        {",", Token::COMMA},
+        {";", Token::SEMICOLON},
+    };
+
+    // The characters that occur in operators are numbered from 1, so that
+    // the two character operators fit in a small table. 0 is for all other
+    // characters.
+    constexpr size_t maxOperatorChars = 32;
+
+    struct CharInfo
+    {
+        CharClass charClass;
+        uint8_t operatorChar;
+        Token::TokenType singleType;
+    };
 
-std::unique_ptr<Token> Lexer::nextToken()
-{
-    std::unique_ptr<Token> token;
-    skipWhiteSpace();
+    struct CharTables
+    {
+        std::array<CharInfo, 256> chars;
+        // The type of the operator made of two operator characters, or
+        // ILLEGAL if there is none
+        std::array<std::array<Token::TokenType, maxOperatorChars>, maxOperatorChars> pairs;
+    };
 
-    switch (currentChar)
+    constexpr CharTables createCharTables()
     {
-        case 0:
-            if (EOFFound)
+        CharTables tables {};
+        for (auto& info : tables.chars)
+        {
+            info = {OTHER, 0, Token::ILLEGAL};
+        }
+        for (auto& row : tables.pairs)
+        {
+            for (auto& type : row)
             {
-                token = nullptr;
+                type = Token::ILLEGAL;
             }
-            else
+        }
+
+        tables.chars[0].charClass = END;
+        for (unsigned char c : {' ', '\t', '\n', '\r'})
+        {
+            tables.chars[c].charClass = WHITE_SPACE;
+        }
+        for (int c = 0; c < 256; ++c)
+        {
+            if (('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || (c == '_'))
             {
-                token = std::make_unique<Token>(Token::ENDOFFILE, std::string("EOF"));
-                EOFFound = true;
+                tables.chars[c].charClass = LETTER;
             }
-            break;
+            else if ('0' <= c && c <= '9')
+            {
+                tables.chars[c].charClass = DIGIT;
+            }
+        }
 
-        case '=':
-            if (peekChar() == '=')
+        uint8_t operatorChars = 0;
+        for (const auto& op : operators)
+        {
+            for (unsigned char c : op.spelling)
+            {
+                auto& info = tables.chars[c];
+                if (info.charClass != OPERATOR)
+                {
+                    info.charClass = OPERATOR;
+                    info.operatorChar = ++operatorChars;
+                }
+            }
+        }
+        for (const auto& op : operators)
+        {
+            auto first = static_cast<unsigned char>(op.spelling.front());
+            if (op.spelling.size() == 1)
             {
-                token = readTwoCharToken(Token::EQ);
+                tables.chars[first].singleType = op.type;
             }
             else
             {
-                token = readSingleCharToken(Token::ASSIGN);
+                auto second = static_cast<unsigned char>(op.spelling.back());
+                tables.pairs[tables.chars[first].operatorChar][tables.chars[second].operatorChar] = op.type;
             }
-            break;
-
-        case '+':
-            token = readSingleCharToken(Token::PLUS);
-            break;
+        }
+        return tables;
+    }
 
-        case '-':
-            token = readSingleCharToken(Token::MINUS);
-            break;
+    constexpr auto charTables = createCharTables();
 
-        case '!':
-            if (peekChar() == '=')
-            {
-                token = readTwoCharToken(Token::NEQ);
-            }
-            else
+    constexpr bool checkOperators()
+    {
+        size_t operatorChars = 0;
+        for (const auto& info : charTables.chars)
+        {
+            operatorChars += (info.charClass == OPERATOR);
+        }
+        for (const auto& op : operators)
+        {
+            if (op.spelling.empty() || op.spelling.size() > 2)
             {
-                token = readSingleCharToken(Token::BANG);
+                return false;
             }
-            break;
+        }
+        return operatorChars < maxOperatorChars;
+    }
 
-        case '*':
-            token = readSingleCharToken(Token::ASTERISK);
-            break;
+    static_assert(checkOperators(), "Operators must have one or two characters, and use fewer than "
+                                    "maxOperatorChars different characters");
+}
 
-        case '/':
-            token = readSingleCharToken(Token::SLASH);
-            break;
+Lexer::Lexer(const char *input) : Lexer(std::make_shared<SourceBuffer>(input)) {}
 
-        case '<':
-            token = readSingleCharToken(Token::LT);
-            break;
+Lexer::Lexer(std::shared_ptr<const SourceBuffer> source)
+{
+    EOFFound = false;
+    integerValue = 0;
+    symbols = &SymbolTable::global();
+    setSource(std::move(source));
+}
 
-        case '>':
-            token = readSingleCharToken(Token::GT);
-            break;
+// Start reading at the given offset in the source
+Lexer::Lexer(std::shared_ptr<const SourceBuffer> source, size_t offset) : Lexer(std::move(source))
+{
+    jumpTo(input + offset);
+}
 
-        case '(':
-            token = readSingleCharToken(Token::LPAREN);
-            break;
+Lexer::Lexer() : Lexer(std::make_shared<SourceBuffer>()) {}
+
+Lexer::~Lexer() = default;
+
+std::shared_ptr<const SourceBuffer> Lexer::getSource() const
+{
+    return source;
+}
+
+void Lexer::setSymbolTable(SymbolTable &table)
+{
+    symbols = &table;
+}
+
+SymbolTable& Lexer::getSymbolTable() const
+{
+    return *symbols;
+}
+
+// Start reading from the beginning of a new buffer
+void Lexer::setSource(std::shared_ptr<const SourceBuffer> newSource)
+{
+    source = std::move(newSource);
+    input = source->data();
+    curPos = 0;
+    readPos = 0;
+    currentChar = 0;
+    readChar();
+}
+
+std::unique_ptr<Token> Lexer::nextToken()
+{
+    if (EOFFound)
+    {
+        return nullptr;
+    }
+
+    size_t start;
+    auto type = readToken(start);
+    if (type == Token::ENDOFFILE)
+    {
+        EOFFound = true;
+        return std::make_unique<Token>(Token::ENDOFFILE, "EOF");
+    }
+    return std::make_unique<Token>(type, createString(start, curPos), tokenValue(type, start));
+}
 
-        case ')':
-            token = readSingleCharToken(Token::RPAREN);
+bool Lexer::readTokens(TokenBuffer &tokens, size_t count)
+{
+    if (tokens.lastSource() != source)
+    {
+        tokens.addSource(source, 0);
+    }
+
+    for (size_t i = 0; (i < count) && !EOFFound; ++i)
+    {
+        size_t start;
+        auto type = readToken(start);
+        tokens.add(type, start, curPos - start, tokenValue(type, start));
+        EOFFound = (type == Token::ENDOFFILE);
+    }
+    return !EOFFound;
+}
+
+bool Lexer::readTokensBefore(TokenBuffer &tokens, size_t end)
+{
+    if (tokens.lastSource() != source)
+    {
+        tokens.addSource(source, 0);
+    }
+
+    while (!EOFFound)
+    {
+        size_t start;
+        auto type = readToken(start);
+        if (start >= end)
+        {
             break;
+        }
+        tokens.add(type, start, curPos - start, tokenValue(type, start));
+        EOFFound = (type == Token::ENDOFFILE);
+    }
+    return EOFFound;
+}
 
-        case '{':
-            token = readSingleCharToken(Token::LBRACE);
+TokenBuffer Lexer::tokenizeAll()
+{
+    TokenBuffer tokens(source);
+    tokens.reserve(source->size() / 4 + 1);
+    readTokens(tokens, SIZE_MAX);
+    return tokens;
+}
+
+// Read the next token and return its type. The token starts at the returned
+// start position and ends at curPos.
+Token::TokenType Lexer::readToken(size_t &start)
+{
+    Token::TokenType type;
+    skipWhiteSpace();
+    start = curPos;
+
+    const auto& info = charTables.chars[static_cast<unsigned char>(currentChar)];
+    switch (info.charClass)
+    {
+        case END:
+            type = Token::ENDOFFILE;
             break;
 
-        case '}':
-            token = readSingleCharToken(Token::RBRACE);
+        case LETTER:
+            type = readIdentifier();
             break;
 
-        case ',':
-            token = readSingleCharToken(Token::COMMA);
+        case DIGIT:
+            type = readNumber();
             break;
 
-        case ';':
-            token = readSingleCharToken(Token::SEMICOLON);
+        case OPERATOR:
+            type = readOperator(info.operatorChar, info.singleType);
             break;
 
         default:
-            if (isLetter(currentChar))
-            {
-                token = std::make_unique<Token>(readIdentifier());
-            }
-            else if (isDigit(currentChar))
-            {
-                token = std::make_unique<Token>(readNumber());
-                token->type = Token::INT;
-            }
-            else
-            {
-                token = readSingleCharToken(Token::ILLEGAL);
-            }
+            type = readSingleCharToken(Token::ILLEGAL);
             break;
     }
 
-    return token;
+    return type;
 }
 
 void Lexer::readChar()
@@ -134,77 +306,79 @@ void Lexer::readChar()
     curPos = readPos++;
 }
 
-char Lexer::peekChar()
+// Continue reading at the given position in the input
+void Lexer::jumpTo(const char* position)
 {
-    return input[readPos];
-}
-
-bool Lexer::isLetter(char c)
-{
-    return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || (c == '_');
+    readPos = static_cast<size_t>(position - input);
+    readChar();
 }
 
-bool Lexer::isDigit(char c)
+char Lexer::peekChar()
 {
-    return ('0' <= c && c <= '9');
+    return input[readPos];
 }
 
 void Lexer::skipWhiteSpace()
 {
-    while (currentChar != 0)
+    if (charTables.chars[static_cast<unsigned char>(currentChar)].charClass == WHITE_SPACE)
     {
-        if ((currentChar == ' ') || (currentChar == '\t') ||
-                (currentChar == '\n') || (currentChar == '\r'))
-        {
-            readChar();
-        }
-        else
-        {
-            break;
-        }
+        jumpTo(CharScanner::skipWhiteSpace(input + curPos));
     }
 }
 
-std::unique_ptr<Token> Lexer::readSingleCharToken(Token::TokenType type)
+Token::TokenType Lexer::readSingleCharToken(Token::TokenType type)
 {
-    auto token = std::make_unique<Token>(type, createString(curPos, curPos));
     readChar();
-    return token;
+    return type;
 }
 
-std::unique_ptr<Token> Lexer::readTwoCharToken(Token::TokenType type)
+// One or two characters, whichever is the longer operator. The next character
+// is always looked up, so the choice does not need a branch per operator.
+Token::TokenType Lexer::readOperator(uint8_t operatorChar, Token::TokenType singleType)
 {
-    std::unique_ptr<Token> token;
-    auto start = curPos;
-    readChar();
-    token = std::make_unique<Token>(type, createString(start, curPos));
-    readChar();
-    return token;
+    auto next = charTables.chars[static_cast<unsigned char>(peekChar())].operatorChar;
+    auto pairType = charTables.pairs[operatorChar][next];
+    auto isPair = (pairType != Token::ILLEGAL);
+    jumpTo(input + curPos + 1 + isPair);
+    return isPair ? pairType : singleType;
 }
 
-std::string Lexer::createString(int start, int end)
+std::string_view Lexer::createString(size_t start, size_t end)
 {
-    return std::string(input+start, end-start+1);
+    return std::string_view(input+start, end-start);
 }
 
-std::string Lexer::readIdentifier()
+// The value of the token that was just read. Identifiers are only interned
+// here, once the token is known to be complete.
+int64_t Lexer::tokenValue(Token::TokenType type, size_t start)
 {
-    int start = curPos;
-    while (isLetter(currentChar))
+    switch (type)
     {
-        readChar();
+        case Token::INT:
+            return integerValue;
+        case Token::IDENTIFIER:
+            return symbols->intern(createString(start, curPos));
+        default:
+            return 0;
     }
-    return std::string(input+start, curPos-start);
 }
 
-std::string Lexer::readNumber()
+Token::TokenType Lexer::readIdentifier()
+{
+    size_t start = curPos;
+    jumpTo(CharScanner::skipLetters(input + curPos));
+    return Token::lookUpType(createString(start, curPos));
+}
+
+// The value is converted while the digits are in the cache
+Token::TokenType Lexer::readNumber()
 {
-    int start = curPos;
-    while (isDigit(currentChar))
+    auto start = input + curPos;
+    auto end = CharScanner::skipDigits(start);
+    if (!CharScanner::parseDecimal(start, end, integerValue))
     {
-        readChar();
+        integerValue = Token::OUT_OF_RANGE;
     }
-    return std::string(input+start, curPos-start);
+    jumpTo(end);
+    return Token::INT;
 }
-
-
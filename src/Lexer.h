@@ -10,32 +10,69 @@
 #define INTERPRETER_LEXER_H
 
 #include <memory>
+#include <string_view>
+#include "SourceBuffer.h"
+#include "SymbolTable.h"
 #include "Token.h"
+#include "TokenBuffer.h"
 
 class Lexer
 {
 public:
     explicit Lexer(const char*);
+    explicit Lexer(std::shared_ptr<const SourceBuffer> source);
+    Lexer(std::shared_ptr<const SourceBuffer> source, size_t offset);
     virtual ~Lexer();
-    std::unique_ptr<Token> nextToken();
 
-private:
+    // The literal of the token is a view into the source, which is valid for
+    // as long as the lexer is
+    virtual std::unique_ptr<Token> nextToken();
+
+    // Append at most count tokens to the buffer. Returns false when the EOF
+    // token has been added, i.e. there are no more tokens to read.
+    virtual bool readTokens(TokenBuffer& tokens, size_t count);
+
+    // Read all remaining tokens, up to and including the EOF token
+    TokenBuffer tokenizeAll();
+
+    // Read the tokens that start before the given offset. Returns true if the
+    // EOF token was reached (and added) before that.
+    bool readTokensBefore(TokenBuffer& tokens, size_t end);
+
+    // The buffer that is currently being read
+    std::shared_ptr<const SourceBuffer> getSource() const;
+
+    // Identifier names are interned into this table; the value of an
+    // IDENTIFIER token is its symbol. The global table is used by default.
+    void setSymbolTable(SymbolTable& table);
+    SymbolTable& getSymbolTable() const;
+
+protected:
+    Lexer();
+    void setSource(std::shared_ptr<const SourceBuffer> newSource);
+
+    std::shared_ptr<const SourceBuffer> source;
     const char *input;
-    int curPos;
-    int readPos;
+    size_t curPos;
+    size_t readPos;
     char currentChar;
     bool EOFFound;
+    int64_t integerValue;
+    SymbolTable* symbols;
 
+    Token::TokenType readToken(size_t &start);
+    int64_t tokenValue(Token::TokenType type, size_t start);
+    std::string_view createString(size_t start, size_t end);
+
+private:
     void readChar();
+    void jumpTo(const char* position);
     char peekChar();
     void skipWhiteSpace();
-    static bool isLetter(char c);
-    static bool isDigit(char c);
-    std::unique_ptr<Token> readSingleCharToken(Token::TokenType type);
-    std::unique_ptr<Token> readTwoCharToken(Token::TokenType type);
-    std::string createString(int start, int end);
-    std::string readIdentifier();
-    std::string readNumber();
+    Token::TokenType readSingleCharToken(Token::TokenType type);
+    Token::TokenType readOperator(uint8_t operatorChar, Token::TokenType singleType);
+    Token::TokenType readIdentifier();
+    Token::TokenType readNumber();
 };
 
 #endif //INTERPRETER_LEXER_H
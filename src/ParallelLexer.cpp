@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include <algorithm>
+#include <thread>
+#include "CharScanner.h"
+#include "Lexer.h"
+#include "ParallelLexer.h"
+
+TokenBuffer ParallelLexer::tokenize(const std::shared_ptr<const SourceBuffer>& source, unsigned threadCount,
+                                    size_t minChunkSize, SymbolTable& symbols)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    size_t chunkCount = std::min<size_t>(threadCount, source->size() / std::max<size_t>(minChunkSize, 1));
+    if (chunkCount <= 1)
+    {
+        Lexer lexer(source);
+        lexer.setSymbolTable(symbols);
+        return lexer.tokenizeAll();
+    }
+
+    auto points = splitPoints(*source, chunkCount);
+    std::vector<TokenBuffer> chunks(chunkCount, TokenBuffer(source));
+    std::vector<std::unique_ptr<SymbolTable>> chunkSymbols(chunkCount);
+    // Not std::vector<bool>, whose elements cannot be written concurrently
+    std::vector<char> endFound(chunkCount);
+
+    auto tokenizeChunk = [&](size_t chunk)
+    {
+        chunks[chunk].reserve((points[chunk + 1] - points[chunk]) / 4 + 1);
+        chunkSymbols[chunk] = std::make_unique<SymbolTable>();
+        Lexer lexer(source, points[chunk]);
+        lexer.setSymbolTable(*chunkSymbols[chunk]);
+        // The last chunk reads up to and including the EOF token
+        auto end = chunk + 1 == chunkCount ? SIZE_MAX : points[chunk + 1];
+        endFound[chunk] = lexer.readTokensBefore(chunks[chunk], end);
+    };
+
+    // The calling thread takes the first chunk
+    std::vector<std::thread> threads;
+    threads.reserve(chunkCount - 1);
+    for (size_t chunk = 1; chunk < chunkCount; ++chunk)
+    {
+        threads.emplace_back(tokenizeChunk, chunk);
+    }
+    tokenizeChunk(0);
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    TokenBuffer tokens(source);
+    size_t total = 0;
+    for (const auto& chunk : chunks)
+    {
+        total += chunk.size();
+    }
+    tokens.reserve(total);
+    for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+    {
+        remapSymbols(chunks[chunk], *chunkSymbols[chunk], symbols);
+        tokens.append(chunks[chunk]);
+        // A zero byte inside the source ends the input, as it does for the Lexer
+        if (endFound[chunk])
+        {
+            break;
+        }
+    }
+    return tokens;
+}
+
+// Each chunk ends at the first white space character at or after an equal
+// share of the source. A chunk may be empty when there is no white space in
+// a long stretch of the source.
+std::vector<size_t> ParallelLexer::splitPoints(const SourceBuffer& source, size_t chunkCount)
+{
+    std::vector<size_t> points(chunkCount + 1);
+    const char* data = source.data();
+    points[0] = 0;
+    for (size_t chunk = 1; chunk < chunkCount; ++chunk)
+    {
+        auto point = std::max(points[chunk - 1], source.size() / chunkCount * chunk);
+        while (point < source.size() && !CharScanner::isWhiteSpace(data[point]))
+        {
+            ++point;
+        }
+        points[chunk] = point;
+    }
+    points[chunkCount] = source.size();
+    return points;
+}
+
+// Replace the symbols of the identifiers, which are from the table of the
+// chunk, with the symbols of the same names in the shared table
+void ParallelLexer::remapSymbols(TokenBuffer& tokens, const SymbolTable& from, SymbolTable& to)
+{
+    std::vector<SymbolTable::Symbol> symbolMap(from.size());
+    for (SymbolTable::Symbol symbol = 0; symbol < from.size(); ++symbol)
+    {
+        symbolMap[symbol] = to.intern(from.name(symbol));
+    }
+    for (size_t i = 0; i < tokens.size(); ++i)
+    {
+        if (tokens.type(i) == Token::IDENTIFIER)
+        {
+            tokens.setValue(i, symbolMap[tokens.value(i)]);
+        }
+    }
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#ifndef INTERPRETER_PARALLELLEXER_H
+#define INTERPRETER_PARALLELLEXER_H
+
+#include <memory>
+#include <vector>
+#include "SourceBuffer.h"
+#include "SymbolTable.h"
+#include "TokenBuffer.h"
+
+// Tokenizes a large source on several threads.
+//
+// The source is cut into chunks at white space characters. No token contains
+// white space, so every token lies within a single chunk and each chunk can be
+// tokenized on its own. The chunk buffers are then joined in order. The result
+// is the same token sequence as Lexer::tokenizeAll() gives.
+//
+// Each thread interns identifiers into a table of its own. These symbols are
+// mapped to symbols of the given table when the buffers are joined.
+class ParallelLexer
+{
+public:
+    // Chunks are not made smaller than this, so small sources use fewer threads
+    static constexpr size_t minimumChunkSize = 64 * 1024;
+
+    // A threadCount of 0 uses one thread per hardware thread
+    static TokenBuffer tokenize(const std::shared_ptr<const SourceBuffer>& source, unsigned threadCount = 0,
+                                size_t minChunkSize = minimumChunkSize,
+                                SymbolTable& symbols = SymbolTable::global());
+
+    // The offsets at which the chunks start, followed by the size of the source
+    static std::vector<size_t> splitPoints(const SourceBuffer& source, size_t chunkCount);
+
+private:
+    static void remapSymbols(TokenBuffer& tokens, const SymbolTable& from, SymbolTable& to);
+};
+
+#endif //INTERPRETER_PARALLELLEXER_H
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include <algorithm>
+#include "ParallelParser.h"
+#include "ThreadPool.h"
+
+std::shared_ptr<Program> ParallelParser::parse(const TokenBuffer& tokens, ParserErrors& errors, unsigned threadCount,
+                                               size_t minSliceSize, size_t nestingLimit)
+{
+    auto& pool = ThreadPool::shared();
+    if (threadCount == 0)
+    {
+        threadCount = pool.threadCount();
+    }
+    size_t sliceCount = std::min<size_t>(threadCount, tokens.size() / std::max<size_t>(minSliceSize, 1));
+    sliceCount = std::max<size_t>(sliceCount, 1);
+
+    auto points = splitPoints(tokens, sliceCount);
+    std::vector<Slice> slices(sliceCount);
+    pool.run(sliceCount, [&](size_t slice)
+    {
+        slices[slice] = parseSlice(tokens, points[slice], points[slice + 1], nestingLimit);
+    });
+
+    auto program = std::make_shared<Program>();
+    for (size_t slice = 0; slice < sliceCount;)
+    {
+        // The cut after an incomplete slice was not a statement boundary, so
+        // the slices after it were parsed from the wrong start. Parse them
+        // again together until a statement ends at a cut. Each attempt takes
+        // twice as many slices, so that a statement that runs to the end of
+        // the program, e.g. after an unbalanced brace, costs no more than
+        // about two sequential parses of the rest.
+        auto next = slice + 1;
+        for (size_t width = 2; !slices[slice].complete; width *= 2)
+        {
+            next = std::min(slice + width, sliceCount);
+            slices[slice] = parseSlice(tokens, points[slice], points[next], nestingLimit);
+        }
+
+        program->append(*slices[slice].program);
+        const auto& sliceErrors = slices[slice].errors;
+        for (size_t i = 0; i < sliceErrors.size(); ++i)
+        {
+            auto error = sliceErrors.record(i);
+            error.position += points[slice];
+            errors.add(error);
+        }
+        slice = next;
+    }
+    return program;
+}
+
+// Each slice ends after the first semicolon outside of braces at or after an
+// equal share of the tokens. The last slice takes the EOF token. A slice is
+// empty when there is no such semicolon in its share.
+std::vector<size_t> ParallelParser::splitPoints(const TokenBuffer& tokens, size_t sliceCount)
+{
+    std::vector<size_t> points(sliceCount + 1, tokens.size());
+    points[0] = 0;
+    size_t slice = 1;
+    size_t depth = 0;
+    for (size_t i = 0; i + 1 < tokens.size() && slice < sliceCount; ++i)
+    {
+        switch (tokens.type(i))
+        {
+            case Token::LBRACE:
+                ++depth;
+                break;
+
+            case Token::RBRACE:
+                // A brace without a partner does not make the rest of the
+                // program nested
+                depth = depth > 0 ? depth - 1 : 0;
+                break;
+
+            case Token::SEMICOLON:
+                if (depth == 0 && i + 1 >= tokens.size() / sliceCount * slice)
+                {
+                    points[slice++] = i + 1;
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+    return points;
+}
+
+// The slice is given an EOF token of its own, unless it is the last one and
+// already ends with the EOF token. The parser reaches that token at the start
+// of a statement if the slice ends at a statement boundary. Any other way of
+// reaching it gives an error at its position, as no statement can continue
+// with EOF.
+ParallelParser::Slice ParallelParser::parseSlice(const TokenBuffer& tokens, size_t first, size_t end,
+                                                 size_t nestingLimit)
+{
+    if (first == end)
+    {
+        return {std::make_shared<Program>(), {}, true};
+    }
+
+    auto sliceTokens = tokens.slice(first, end);
+    bool last = end == tokens.size();
+    if (!last)
+    {
+        sliceTokens.add(Token::ENDOFFILE, tokens.offset(end - 1) + tokens.length(end - 1), 0);
+    }
+
+    Parser parser(std::move(sliceTokens));
+    parser.setNestingLimit(nestingLimit);
+    Slice slice {parser.parseProgram(), std::move(parser.errors), true};
+    for (size_t i = 0; i < slice.errors.size() && !last; ++i)
+    {
+        if (slice.errors.record(i).position >= end - first)
+        {
+            slice.complete = false;
+        }
+    }
+    return slice;
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#ifndef INTERPRETER_PARALLELPARSER_H
+#define INTERPRETER_PARALLELPARSER_H
+
+#include <memory>
+#include <vector>
+#include "Ast.h"
+#include "Parser.h"
+#include "ParserError.h"
+#include "TokenBuffer.h"
+
+// Parses the top-level statements of a large program on several threads.
+//
+// The tokens are cut into slices after semicolons outside of braces. Each
+// slice is parsed by a parser of its own into a program of its own, on the
+// threads of the shared ThreadPool, and the statements and nodes are then
+// moved to one program in order.
+//
+// A cut is only a statement boundary if the statement before it ends there.
+// When errors make a parser run into the end of its slice in the middle of a
+// statement, the slice is parsed again together with the following ones,
+// doubling their number until a statement ends at a cut. The result is thus
+// always the same as that of Parser::parseProgram(), errors included.
+class ParallelParser
+{
+public:
+    // Slices are not made smaller than this number of tokens
+    static constexpr size_t minimumSliceSize = 16 * 1024;
+
+    // The tokens must end with the EOF token. Errors are added with their
+    // positions in the tokens. The tokens are cut into at most threadCount
+    // slices; a threadCount of 0 uses one slice per thread of the pool.
+    static std::shared_ptr<Program> parse(const TokenBuffer& tokens, ParserErrors& errors, unsigned threadCount = 0,
+                                          size_t minSliceSize = minimumSliceSize,
+                                          size_t nestingLimit = Parser::defaultNestingLimit);
+
+    // The token positions at which the slices start, followed by the number
+    // of tokens
+    static std::vector<size_t> splitPoints(const TokenBuffer& tokens, size_t sliceCount);
+
+private:
+    struct Slice
+    {
+        std::shared_ptr<Program> program;
+        ParserErrors errors;
+        // The parser finished the last statement at the end of the slice
+        bool complete;
+    };
+
+    static Slice parseSlice(const TokenBuffer& tokens, size_t first, size_t end, size_t nestingLimit);
+};
+
+#endif //INTERPRETER_PARALLELPARSER_H
@@ -6,419 +6,972 @@
  *
  */
 
-#include "Exceptions.h"
 #include "Parser.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <new>
 #include <utility>
+#include "ParallelParser.h"
 
-Parser::Parser(Lexer &lexer) : lexer(lexer)
-{
-    prefixParseFunctionMap[Token::IDENTIFIER] = &Parser::parseIdentifier;
-    prefixParseFunctionMap[Token::INT] = &Parser::parseInteger;
-    prefixParseFunctionMap[Token::BANG] = &Parser::parsePrefixExpression;
-    prefixParseFunctionMap[Token::MINUS] = &Parser::parsePrefixExpression;
-    prefixParseFunctionMap[Token::LPAREN] = &Parser::parseGroupedExpression;
-    prefixParseFunctionMap[Token::TRUE] = &Parser::parseBoolean;
-    prefixParseFunctionMap[Token::FALSE] = &Parser::parseBoolean;
-    prefixParseFunctionMap[Token::IF] = &Parser::parseIfExpression;
-    prefixParseFunctionMap[Token::FUNCTION] = &Parser::parseFunction;
-    infixParseFunctionMap[Token::PLUS] = &Parser::parseInfixExpression;
-    infixParseFunctionMap[Token::MINUS] = &Parser::parseInfixExpression;
-    infixParseFunctionMap[Token::ASTERISK] = &Parser::parseInfixExpression;
-    infixParseFunctionMap[Token::SLASH] = &Parser::parseInfixExpression;
-    infixParseFunctionMap[Token::GT] = &Parser::parseInfixExpression;
-    infixParseFunctionMap[Token::LT] = &Parser::parseInfixExpression;
-    infixParseFunctionMap[Token::EQ] = &Parser::parseInfixExpression;
-    infixParseFunctionMap[Token::NEQ] = &Parser::parseInfixExpression;
-    infixParseFunctionMap[Token::LPAREN] = &Parser::parseCallExpression;
-    precedenceMap[Token::EQ] = Precedence::EQUALS;
-    precedenceMap[Token::NEQ] = Precedence::EQUALS;
-    precedenceMap[Token::LT] = Precedence::LESSGREATER;
-    precedenceMap[Token::GT] = Precedence::LESSGREATER;
-    precedenceMap[Token::PLUS] = Precedence::SUM;
-    precedenceMap[Token::MINUS] = Precedence::SUM;
-    precedenceMap[Token::SLASH] = Precedence::PRODUCT;
-    precedenceMap[Token::ASTERISK] = Precedence::PRODUCT;
-    precedenceMap[Token::LPAREN] = Precedence::CALL;
-    curToken = lexer.nextToken();
-    peekToken = lexer.nextToken();
+Parser::Parser(Lexer &lexer) : Parser(TokenBuffer())
+{
+    this->lexer = &lexer;
+    symbols = &lexer.getSymbolTable();
+    readTokensUpTo(0);
 }
 
+Parser::Parser(TokenBuffer tokens) :
+        lexer(nullptr),
+        symbols(&SymbolTable::global()),
+        tokens(std::move(tokens)),
+        position(0),
+        discarded(0),
+        failed(false),
+        program(nullptr),
+        checkOnly(false),
+        lazyFunctionBodies(false),
+        blockRecords(nullptr),
+        nestingLimit(defaultNestingLimit),
+        next(Action::DELIVER),
+        nextPrecedence(Precedence::LOWEST),
+        result(nullptr)
+{
+    // Enough for ordinary statements without growing the stack
+    frames.reserve(32);
+}
+
+constexpr std::array<Parser::ParseRule, Parser::tokenTypeCount> Parser::createParseRules()
+{
+    std::array<ParseRule, tokenTypeCount> rules {};
+    for (auto& rule : rules)
+    {
+        rule = {nullptr, nullptr, Precedence::LOWEST};
+    }
+
+    rules[Token::IDENTIFIER].prefix = &Parser::parseIdentifierExpression;
+    rules[Token::INT].prefix = &Parser::parseInteger;
+    rules[Token::BANG].prefix = &Parser::parsePrefixExpression;
+    rules[Token::MINUS].prefix = &Parser::parsePrefixExpression;
+    rules[Token::LPAREN].prefix = &Parser::parseGroupedExpression;
+    rules[Token::TRUE].prefix = &Parser::parseBoolean;
+    rules[Token::FALSE].prefix = &Parser::parseBoolean;
+    rules[Token::IF].prefix = &Parser::parseIfExpression;
+    rules[Token::FUNCTION].prefix = &Parser::parseFunction;
+
+    auto setInfix = [&rules](Token::TokenType type, InfixParseFunction function, Precedence precedence)
+    {
+        rules[type].infix = function;
+        rules[type].precedence = precedence;
+    };
+    setInfix(Token::EQ, &Parser::parseInfixExpression, Precedence::EQUALS);
+    setInfix(Token::NEQ, &Parser::parseInfixExpression, Precedence::EQUALS);
+    setInfix(Token::LT, &Parser::parseInfixExpression, Precedence::LESSGREATER);
+    setInfix(Token::GT, &Parser::parseInfixExpression, Precedence::LESSGREATER);
+    setInfix(Token::PLUS, &Parser::parseInfixExpression, Precedence::SUM);
+    setInfix(Token::MINUS, &Parser::parseInfixExpression, Precedence::SUM);
+    setInfix(Token::SLASH, &Parser::parseInfixExpression, Precedence::PRODUCT);
+    setInfix(Token::ASTERISK, &Parser::parseInfixExpression, Precedence::PRODUCT);
+    setInfix(Token::LPAREN, &Parser::parseCallExpression, Precedence::CALL);
+    return rules;
+}
+
+// Indexed by token type. Types that are not operators have the lowest
+// precedence, which ends an expression in continueExpression.
+constexpr std::array<Parser::ParseRule, Parser::tokenTypeCount> Parser::parseRules = createParseRules();
+
 bool Parser::currentTokenIs(const Token::TokenType &type) const
 {
-    return curToken->type == type;
+    return currentType() == type;
+}
+
+bool Parser::peekTokenIs(const Token::TokenType &type)
+{
+    return peekType(1) == type;
 }
 
-bool Parser::peekTokenIs(const Token::TokenType &type) const
+Token::TokenType Parser::currentType() const
 {
-    return peekToken->type == type;
+    return tokens.type(position);
 }
 
-void Parser::nextToken()
+// Look ahead the given number of tokens. Looking beyond the end gives EOF.
+Token::TokenType Parser::peekType(size_t distance)
 {
-    if (peekToken != nullptr)
+    if (readTokensUpTo(position + distance))
     {
-        curToken = std::move(peekToken);
-        peekToken = lexer.nextToken();
+        return tokens.type(position + distance);
     }
-    else
+    return Token::ENDOFFILE;
+}
+
+// Make sure that the token at the given index has been read from the lexer.
+// Returns false if there is no such token.
+bool Parser::readTokensUpTo(size_t index)
+{
+    while ((index >= tokens.size()) && (lexer != nullptr))
     {
-        throw NoMoreTokensException();
+        if (!lexer->readTokens(tokens, tokenBatchSize))
+        {
+            lexer = nullptr;
+        }
     }
+    return index < tokens.size();
 }
 
-void Parser::nextTokenIfType(Token::TokenType type)
+// A node of the program, or in check mode one that is only kept until the
+// next node of its type
+template<typename T, typename... Args>
+T* Parser::create(Args&&... args)
 {
-    if (currentTokenIs(type))
+    if (checkOnly)
     {
-        nextToken();
+        return new (std::get<NodeSlot<T>>(nodeSlots).bytes) T(std::forward<Args>(args)...);
+    }
+    return program->create<T>(std::forward<Args>(args)...);
+}
+
+// Drop the elements that statements abandoned after an error left on the stacks
+void Parser::discardLists(const ListMarks& marks)
+{
+    statementStack.resize(marks.statements);
+    identifierStack.resize(marks.identifiers);
+    expressionStack.resize(marks.expressions);
+}
+
+// Move the elements from first to the top of the stack to a list in the arena
+template<typename T>
+NodeList<T> Parser::takeList(std::vector<T*>& stack, size_t first)
+{
+    if (checkOnly)
+    {
+        stack.resize(first);
+        return {};
     }
-    else
+    NodeList<T> list(program->arena.copyArray(stack.data() + first, stack.size() - first), stack.size() - first);
+    stack.resize(first);
+    return list;
+}
+
+// Returns false, and fails the parse, if there is no next token
+bool Parser::nextToken()
+{
+    if (readTokensUpTo(position + 1))
     {
-        std::string message("Expected " + Token::getTypeString(type) + " token. Got " +
-                                    Token::getTypeString(curToken->type) + " token (" +
-                                    *(curToken->literal) + ")");
-        errors.emplace_back(message);
-        throw WrongTokenException();
+        ++position;
+        return true;
     }
+    failed = true;
+    return false;
+}
+
+bool Parser::nextTokenIfType(Token::TokenType type)
+{
+    if (currentTokenIs(type))
+    {
+        return nextToken();
+    }
+    fail(ParserError::WRONG_TOKEN, type);
+    return false;
 }
 
 Precedence Parser::getPrecedence(Token::TokenType tokenType)
 {
-    auto precedence = precedenceMap.find(tokenType);
+    return parseRules[tokenType].precedence;
+}
 
-    if (precedence != precedenceMap.end())
+std::shared_ptr<Program> Parser::parseProgram()
+{
+    auto result = std::make_shared<Program>();
+    while (!atEnd())
     {
-        return precedence->second;
+        if (checkOnly && position >= tokenBatchSize)
+        {
+            discardTokens();
+        }
+        auto statement = parseTopLevelStatement(*result);
+        if (statement != nullptr)
+        {
+            result->addStatement(statement);
+        }
     }
-    else
+    return result;
+}
+
+Statement* Parser::parseTopLevelStatement(Program& target)
+{
+    program = &target;
+    auto statement = parseStatement();
+    if (failed)
     {
-        return Precedence::LOWEST;
+        statement = nullptr;
+
+        // Consume the rest of the statement and continue parsing after that
+        failed = false;
+        discardLists({});
+        while (!currentTokenIs(Token::SEMICOLON) && nextToken()) {}
+        if (!failed)
+        {
+            consumeSemicolon();
+        }
+
+        // The tokens ran out while skipping the statement
+        if (failed)
+        {
+            failed = false;
+            addError(ParserError::NO_MORE_TOKENS);
+        }
     }
+    program = nullptr;
+    return checkOnly ? nullptr : statement;
 }
 
-std::shared_ptr<Program> Parser::parseProgram()
+std::shared_ptr<Program> Parser::nextStatement()
 {
-    std::shared_ptr<Program> program = std::make_shared<Program>();
+    if (position >= tokenBatchSize)
+    {
+        discardTokens();
+    }
 
-    // ... Parse the program ...
-    try
+    auto result = std::make_shared<Program>();
+    while (!atEnd())
     {
-        while (!currentTokenIs(Token::ENDOFFILE))
+        auto statement = parseTopLevelStatement(*result);
+        if (statement != nullptr)
         {
-            try
-            {
-                program->addStatement(parseStatement());
-            }
-            catch (ParserException &)
-            {
-                // Consume the rest of the statement and continue parsing after that
-                while (curToken->type != Token::SEMICOLON)
-                {
-                    nextToken();
-                }
-                consumeSemicolon();
-            }
+            result->addStatement(statement);
+            return result;
         }
     }
-    catch (NoMoreTokensException&)
+    return nullptr;
+}
+
+// Drop the tokens before the current one. The errors found in them are
+// located first, and their sources are kept for their literals.
+void Parser::discardTokens()
+{
+    for (size_t i = discardedLocations.size(); i < errors.size(); ++i)
+    {
+        auto errorPosition = errors.record(i).position - discarded;
+        discardedLocations.push_back(tokens.location(errorPosition));
+        const auto& source = tokens.source(errorPosition);
+        if (errorSources.empty() || errorSources.back() != source)
+        {
+            errorSources.push_back(source);
+        }
+    }
+    tokens.discard(position);
+    discarded += position;
+    position = 0;
+}
+
+bool Parser::atEnd() const
+{
+    return currentTokenIs(Token::ENDOFFILE);
+}
+
+size_t Parser::getPosition() const
+{
+    return position;
+}
+
+std::shared_ptr<Program> Parser::parseProgramInParallel(unsigned threadCount)
+{
+    // A check keeps no tokens, so it reads them as it goes on one thread.
+    // Several files are checked at once instead. The parsers of the slices
+    // would not know the symbol table for lazy bodies, which leave little
+    // work to share anyway.
+    if (checkOnly || lazyFunctionBodies)
+    {
+        return parseProgram();
+    }
+    readTokensUpTo(SIZE_MAX);
+    auto result = ParallelParser::parse(tokens, errors, threadCount, ParallelParser::minimumSliceSize, nestingLimit);
+    position = tokens.size() - 1;
+    return result;
+}
+
+void Parser::addError(ParserError::Code code, Token::TokenType expected)
+{
+    errors.add({code, discarded + position, expected, currentType(), tokens.literal(position)});
+}
+
+// Record the error at the current token and fail the parse
+std::nullptr_t Parser::fail(ParserError::Code code, Token::TokenType expected)
+{
+    addError(code, expected);
+    failed = true;
+    return nullptr;
+}
+
+std::vector<std::string> Parser::diagnostics() const
+{
+    std::vector<std::string> result;
+    for (size_t i = 0; i < errors.size(); ++i)
     {
-        errors.emplace_back("Expected more tokens, but none present");
+        result.push_back(diagnostic(i));
     }
+    return result;
+}
 
-    return program;
+std::string Parser::diagnostic(size_t i) const
+{
+    auto location = i < discardedLocations.size() ? discardedLocations[i]
+                                                   : tokens.location(errors.record(i).position - discarded);
+    return std::to_string(location.line) + ":" + std::to_string(location.column) + ": " + errors[i];
 }
 
 void Parser::consumeSemicolon()
 {
     // Consume semicolon if present
-    if (curToken->type == Token::SEMICOLON)
+    if (currentTokenIs(Token::SEMICOLON))
     {
         nextToken();
     }
 }
 
-std::shared_ptr<Statement> Parser::parseStatement()
+// Statements are parsed by a loop over the frames stack rather than by
+// recursive calls. A parse function that needs a nested part pushes a frame
+// for its construct and says which part to parse next; once the part is
+// complete it is delivered to the frame, which carries on with the construct.
+Statement* Parser::parseStatement()
 {
-    std::shared_ptr<Statement> statement;
+    parseNext(Action::START_STATEMENT);
+    run();
+    return failed ? nullptr : static_cast<Statement*>(result);
+}
+
+void Parser::run()
+{
+    while (true)
+    {
+        if (failed && !recover())
+        {
+            return;
+        }
+
+        switch (next)
+        {
+            case Action::START_STATEMENT:
+                startStatement();
+                break;
+
+            case Action::START_EXPRESSION:
+                startExpression();
+                break;
+
+            case Action::START_BLOCK:
+                startBlock();
+                break;
+
+            case Action::CONTINUE_BLOCK:
+                continueBlock();
+                break;
+
+            case Action::DELIVER:
+                if (frames.empty())
+                {
+                    return;
+                }
+                resume(frames.back());
+                break;
+        }
+    }
+}
+
+// Skip the statement that failed in the innermost block and continue with the
+// next one. Returns false if there is no block around the error, which leaves
+// it to parseProgram.
+bool Parser::recover()
+{
+    while (true)
+    {
+        while (!frames.empty() && frames.back().step != Frame::BLOCK)
+        {
+            frames.pop_back();
+        }
+        if (frames.empty())
+        {
+            return false;
+        }
+
+        // Consume the rest of the statement and continue parsing after that
+        failed = false;
+        discardLists(frames.back().marks);
+        while (!currentTokenIs(Token::SEMICOLON) && nextToken()) {}
+        if (!failed)
+        {
+            consumeSemicolon();
+            parseNext(Action::CONTINUE_BLOCK);
+            return true;
+        }
+
+        // The tokens ran out while skipping a statement, so the block fails too
+        addError(ParserError::NO_MORE_TOKENS);
+        frames.pop_back();
+    }
+}
+
+void Parser::push(const Frame& frame)
+{
+    if (frames.size() >= nestingLimit)
+    {
+        fail(ParserError::NESTING_TOO_DEEP);
+        return;
+    }
+    frames.push_back(frame);
+}
+
+void Parser::parseNext(Action action, Precedence precedence)
+{
+    next = action;
+    nextPrecedence = precedence;
+}
+
+void Parser::deliver(Node* node)
+{
+    result = node;
+    next = Action::DELIVER;
+}
+
+// Hand the result to the frame that waits for it
+void Parser::resume(Frame& frame)
+{
+    // The result is a statement for the frames that wait for a block or a
+    // statement of one, and an expression for all others
+    switch (frame.step)
+    {
+        case Frame::OPERAND:
+            continueExpression(static_cast<Expression*>(result));
+            break;
+
+        case Frame::PREFIX_RIGHT:
+            static_cast<PrefixExpression*>(frame.node)->right = static_cast<Expression*>(result);
+            deliver(frame.node);
+            frames.pop_back();
+            break;
+
+        case Frame::INFIX_RIGHT:
+            static_cast<InfixExpression*>(frame.node)->right = static_cast<Expression*>(result);
+            deliver(frame.node);
+            frames.pop_back();
+            break;
+
+        case Frame::GROUP:
+            frames.pop_back();
+            if (nextTokenIfType(Token::RPAREN))
+            {
+                deliver(static_cast<Expression*>(result));
+            }
+            break;
 
-    switch (curToken->type)
+        case Frame::CALL_ARGUMENT:
+            expressionStack.push_back(static_cast<Expression*>(result));
+            if (currentTokenIs(Token::RPAREN) || nextTokenIfType(Token::COMMA))
+            {
+                continueCallArguments();
+            }
+            break;
+
+        case Frame::IF_CONDITION:
+            static_cast<IfExpression*>(frame.node)->condition = static_cast<Expression*>(result);
+            if (nextTokenIfType(Token::RPAREN) && nextTokenIfType(Token::LBRACE))
+            {
+                frame.step = Frame::IF_CONSEQUENCE;
+                parseNext(Action::START_BLOCK);
+            }
+            break;
+
+        case Frame::IF_CONSEQUENCE:
+            static_cast<IfExpression*>(frame.node)->consequence = static_cast<Statement*>(result);
+            if (!currentTokenIs(Token::ELSE))
+            {
+                deliver(frame.node);
+                frames.pop_back();
+            }
+            else if (nextToken() && nextTokenIfType(Token::LBRACE))
+            {
+                frame.step = Frame::IF_ALTERNATIVE;
+                parseNext(Action::START_BLOCK);
+            }
+            break;
+
+        case Frame::IF_ALTERNATIVE:
+            static_cast<IfExpression*>(frame.node)->alternative = static_cast<Statement*>(result);
+            deliver(frame.node);
+            frames.pop_back();
+            break;
+
+        case Frame::FUNCTION_BODY:
+            static_cast<Function*>(frame.node)->body = static_cast<Statement*>(result);
+            deliver(frame.node);
+            frames.pop_back();
+            break;
+
+        case Frame::BLOCK:
+            statementStack.push_back(static_cast<Statement*>(result));
+            parseNext(Action::CONTINUE_BLOCK);
+            break;
+
+        case Frame::LET_VALUE:
+            static_cast<LetStatement*>(frame.node)->expression = static_cast<Expression*>(result);
+            finishStatement();
+            break;
+
+        case Frame::RETURN_VALUE:
+            static_cast<ReturnStatement*>(frame.node)->expression = static_cast<Expression*>(result);
+            finishStatement();
+            break;
+
+        case Frame::EXPRESSION_VALUE:
+            static_cast<ExpressionStatement*>(frame.node)->expression = static_cast<Expression*>(result);
+            finishStatement();
+            break;
+    }
+}
+
+void Parser::startStatement()
+{
+    switch (currentType())
     {
         case Token::LET:
-            statement = parseLetStatement();
+            parseLetStatement();
             break;
 
         case Token::RETURN:
-            statement = parseReturnStatement();
+            parseReturnStatement();
             break;
 
         default:
-            statement = parseExpressionStatement();
+            parseExpressionStatement();
             break;
     }
-    consumeSemicolon();
-    return statement;
 }
 
-std::shared_ptr<Statement> Parser::parseLetStatement()
+void Parser::parseLetStatement()
 {
-    auto statement = std::make_shared<LetStatement>(std::move(curToken));
-    nextToken();
+    auto statement = create<LetStatement>();
+    if (!nextToken())
+    {
+        return;
+    }
 
     statement->identifier = parseIdentifier();
-    nextTokenIfType(Token::ASSIGN);
-    statement->expression = parseExpression(Precedence::LOWEST);
-    return statement;
+    if (failed || !nextTokenIfType(Token::ASSIGN))
+    {
+        return;
+    }
+    push({Frame::LET_VALUE, statement});
+    parseNext(Action::START_EXPRESSION);
 }
 
-std::shared_ptr<Statement> Parser::parseReturnStatement()
+void Parser::parseReturnStatement()
 {
-    auto statement = std::make_shared<ReturnStatement>(std::move(curToken));
-    nextToken();
-    statement->expression = parseExpression(Precedence::LOWEST);
-    return statement;
+    auto statement = create<ReturnStatement>();
+    if (!nextToken())
+    {
+        return;
+    }
+    push({Frame::RETURN_VALUE, statement});
+    parseNext(Action::START_EXPRESSION);
 }
 
-std::shared_ptr<Statement> Parser::parseExpressionStatement()
+void Parser::parseExpressionStatement()
 {
-    auto statement = std::make_shared<ExpressionStatement>();
-    statement->expression = parseExpression(Precedence::LOWEST);
-    return statement;
+    auto statement = create<ExpressionStatement>();
+    push({Frame::EXPRESSION_VALUE, statement});
+    parseNext(Action::START_EXPRESSION);
 }
 
-std::shared_ptr<Statement> Parser::parseBlockStatement()
+// Deliver the statement on top of the stack once its expression is complete
+void Parser::finishStatement()
 {
-    auto block = std::make_shared<BlockStatement>();
+    auto statement = frames.back().node;
+    frames.pop_back();
+    consumeSemicolon();
+    if (!failed)
+    {
+        deliver(statement);
+    }
+}
+
+void Parser::startBlock()
+{
+    auto block = create<BlockStatement>();
+    push({Frame::BLOCK, block, Precedence::LOWEST, statementStack.size()});
+    if (blockRecords != nullptr)
+    {
+        openBlockRecords.push_back(blockRecords->size());
+        blockRecords->push_back({block, discarded + position - 1, 0, frames.size(), {}});
+    }
+    parseNext(Action::CONTINUE_BLOCK);
+}
+
+// The record of the block on top of the stack. Blocks that were given up
+// after an error may have left their records open above it.
+Parser::BlockRecord& Parser::currentBlockRecord(const BlockStatement* block)
+{
+    while ((*blockRecords)[openBlockRecords.back()].block != block)
+    {
+        openBlockRecords.pop_back();
+    }
+    return (*blockRecords)[openBlockRecords.back()];
+}
 
-    try
+// Start the next statement of the block on top of the stack, or deliver the
+// block at its closing brace
+void Parser::continueBlock()
+{
+    auto& frame = frames.back();
+    auto block = static_cast<BlockStatement*>(frame.node);
+    if (!currentTokenIs(Token::RBRACE))
     {
-        while (!currentTokenIs(Token::RBRACE))
+        if (blockRecords != nullptr)
         {
-            try
-            {
-                block->statements.emplace_back(parseStatement());
-            }
-            catch (ParserException &)
-            {
-                // Consume the rest of the statement and continue parsing after that
-                while (curToken->type != Token::SEMICOLON)
-                {
-                    nextToken();
-                }
-            }
+            currentBlockRecord(block).starts.push_back(discarded + position);
         }
+        frame.marks = {statementStack.size(), identifierStack.size(), expressionStack.size()};
+        parseNext(Action::START_STATEMENT);
+        return;
     }
-    catch (NoMoreTokensException&)
+
+    if (blockRecords != nullptr)
     {
-        errors.emplace_back("Expected more tokens, but none present");
+        currentBlockRecord(block).close = discarded + position;
+        openBlockRecords.pop_back();
+    }
+    block->statements = takeList(statementStack, frame.first);
+    frames.pop_back();
+    if (nextToken())
+    {
+        deliver(block);
     }
-
-    nextToken();
-    return block;
 }
 
-std::shared_ptr<Identifier> Parser::parseIdentifier()
+Identifier* Parser::parseIdentifier()
 {
     if(currentTokenIs(Token::IDENTIFIER))
     {
-        auto identifier = std::make_shared<Identifier>(std::move(curToken));
-        nextToken();
-        return identifier;
+        // The name is a view into the source, which the program keeps
+        if (!checkOnly)
+        {
+            program->keepSource(tokens.source(position));
+        }
+        auto identifier = create<Identifier>(tokens.literal(position),
+                                                      static_cast<uint32_t>(tokens.value(position)));
+        return nextToken() ? identifier : nullptr;
     }
-    else
+    return fail(ParserError::WRONG_TOKEN, Token::IDENTIFIER);
+}
+
+void Parser::parseIdentifierExpression()
+{
+    auto identifier = parseIdentifier();
+    if (!failed)
     {
-        std::string message("Expected " + Token::getTypeString(Token::IDENTIFIER) + " token. Got " +
-                            Token::getTypeString(curToken->type) + " token (" +
-                            *(curToken->literal) + ")");
-        errors.emplace_back(message);
-        throw WrongTokenException();
+        deliver(identifier);
     }
 }
 
-std::shared_ptr<Integer> Parser::parseInteger()
+void Parser::parseInteger()
 {
-    if (currentTokenIs(Token::INT))
+    if (!currentTokenIs(Token::INT))
     {
-        auto integer = std::make_shared<Integer>(std::move(curToken));
-        integer->value = std::stol(*integer->token->literal);
-        nextToken();
-        return integer;
+        fail(ParserError::WRONG_TOKEN, Token::INT);
+        return;
     }
-    else
+    if (tokens.value(position) == Token::OUT_OF_RANGE)
     {
-        std::string message("Expected " + Token::getTypeString(Token::INT) + " token. Got " +
-                            Token::getTypeString(curToken->type) + " token (" +
-                            *(curToken->literal) + ")");
-        errors.emplace_back(message);
-        throw WrongTokenException();
+        fail(ParserError::INTEGER_OUT_OF_RANGE);
+        return;
+    }
+    auto integer = create<Integer>(tokens.value(position));
+    if (nextToken())
+    {
+        deliver(integer);
     }
 }
 
-std::shared_ptr<Boolean> Parser::parseBoolean()
+void Parser::parseBoolean()
 {
-    std::shared_ptr<Boolean> boolean = std::make_shared<Boolean>(
-            std::move(curToken),
-            currentTokenIs(Token::TRUE));
-    nextToken();
-    return boolean;
+    Boolean* boolean = create<Boolean>(currentTokenIs(Token::TRUE));
+    if (nextToken())
+    {
+        deliver(boolean);
+    }
 }
 
-// fn ( [ <parameter 1>, <parameter 2>, ... ] ) { <consequence> } [ else { <alternative> } ]
-std::shared_ptr<Function> Parser::parseFunction()
+// fn ( [ <parameter 1>, <parameter 2>, ... ] ) { <body> }
+void Parser::parseFunction()
 {
-    auto function = std::make_shared<Function>(std::move(curToken));
-    nextToken();
-    nextTokenIfType(Token::LPAREN);
+    auto function = create<Function>();
+    if (!nextToken() || !nextTokenIfType(Token::LPAREN))
+    {
+        return;
+    }
     function->parameters = parseFunctionParameters();
-    nextTokenIfType(Token::RPAREN);
-    nextTokenIfType(Token::LBRACE);
-    function->body = parseBlockStatement();
+    if (failed || !nextTokenIfType(Token::RPAREN) || !nextTokenIfType(Token::LBRACE))
+    {
+        return;
+    }
+    if (lazyFunctionBodies && !checkOnly && skipFunctionBody(function))
+    {
+        return;
+    }
+    push({Frame::FUNCTION_BODY, function});
+    parseNext(Action::START_BLOCK);
+}
 
-    return function;
+// Find the closing brace of the body that starts at the current token and
+// leave the body to be parsed later. Returns false, without moving, if the
+// brackets in the body do not match or the body spans several sources.
+bool Parser::skipFunctionBody(Function* function)
+{
+    openBrackets.clear();
+    auto end = position;
+    for (;; ++end)
+    {
+        if (!readTokensUpTo(end))
+        {
+            return false;
+        }
+        auto type = tokens.type(end);
+        if (type == Token::LBRACE || type == Token::LPAREN)
+        {
+            openBrackets.push_back(type);
+        }
+        else if (type == Token::RBRACE || type == Token::RPAREN)
+        {
+            if (openBrackets.empty())
+            {
+                if (type == Token::RPAREN)
+                {
+                    return false;
+                }
+                break;
+            }
+            if (openBrackets.back() != (type == Token::RBRACE ? Token::LBRACE : Token::LPAREN))
+            {
+                return false;
+            }
+            openBrackets.pop_back();
+        }
+        else if (type == Token::ENDOFFILE)
+        {
+            return false;
+        }
+    }
+
+    // The body is read again from its source, so its offsets are kept from
+    // the start of that source rather than of the whole input
+    const auto& source = tokens.source(position - 1);
+    auto base = tokens.baseOffset(position - 1);
+    if (tokens.source(end) != source || tokens.baseOffset(end) != base)
+    {
+        return false;
+    }
+    program->keepSource(source);
+    auto lazyBody = program->arena.create<LazyBody>();
+    *lazyBody = {program, source.get(), symbols, tokens.offset(position - 1) + 1 - base, tokens.offset(end) - base,
+                 &Parser::parseLazyBody};
+    function->lazyBody = lazyBody;
+    program->lazyBodies.push_back(lazyBody);
+
+    position = end;
+    if (nextToken())
+    {
+        deliver(function);
+    }
+    return true;
+}
+
+// Read the tokens of the body again and parse them as a block, with the nodes
+// in the program of the function. A body that fails to parse, or whose source
+// the program no longer keeps, is left empty.
+Statement* Parser::parseLazyBody(const LazyBody& lazyBody)
+{
+    auto& target = *lazyBody.program;
+    auto source = std::find_if(target.sources.begin(), target.sources.end(),
+                               [&lazyBody](const auto& source) { return source.get() == lazyBody.source; });
+    if (source == target.sources.end())
+    {
+        return target.create<BlockStatement>();
+    }
+
+    Lexer lexer(*source, lazyBody.first);
+    lexer.setSymbolTable(*lazyBody.symbols);
+    TokenBuffer bodyTokens;
+    lexer.readTokensBefore(bodyTokens, lazyBody.end + 1);
+    bodyTokens.add(Token::ENDOFFILE, lazyBody.end + 1, 0);
+
+    // Functions in the body are lazy too
+    Parser parser(std::move(bodyTokens));
+    parser.symbols = lazyBody.symbols;
+    parser.lazyFunctionBodies = true;
+    parser.program = &target;
+    parser.parseNext(Action::START_BLOCK);
+    parser.run();
+
+    auto diagnostics = parser.diagnostics();
+    target.bodyDiagnostics.insert(target.bodyDiagnostics.end(), diagnostics.begin(), diagnostics.end());
+    if (parser.failed)
+    {
+        return target.create<BlockStatement>();
+    }
+    return static_cast<Statement*>(parser.result);
 }
 
-std::vector<std::shared_ptr<Identifier>> Parser::parseFunctionParameters()
+NodeList<Identifier> Parser::parseFunctionParameters()
 {
-    std::vector<std::shared_ptr<Identifier>> parameters;
+    auto first = identifierStack.size();
 
     while(!currentTokenIs(Token::RPAREN))
     {
-        parameters.push_back(parseIdentifier());
+        auto parameter = parseIdentifier();
+        if (failed)
+        {
+            return {};
+        }
+        identifierStack.push_back(parameter);
         if (currentTokenIs(Token::RPAREN))
         {
             break;
         }
 
-        nextTokenIfType(Token::COMMA);
+        if (!nextTokenIfType(Token::COMMA))
+        {
+            return {};
+        }
     }
-    return std::move(parameters);
+    return takeList(identifierStack, first);
 }
 
-std::shared_ptr<Expression> Parser::parsePrefixExpression()
+void Parser::parsePrefixExpression()
 {
-    auto expression = std::make_shared<PrefixExpression>(std::move(curToken));
-    expression->op = std::string(*expression->token->literal);
-    nextToken();
-    expression->right = parseExpression(Precedence::PREFIX);
-    return expression;
+    auto expression = create<PrefixExpression>(currentType());
+    if (!nextToken())
+    {
+        return;
+    }
+    push({Frame::PREFIX_RIGHT, expression});
+    parseNext(Action::START_EXPRESSION, Precedence::PREFIX);
 }
 
-std::shared_ptr<Expression> Parser::parseGroupedExpression()
+void Parser::parseGroupedExpression()
 {
-    nextToken();
-    auto expression = parseExpression(Precedence::LOWEST);
-    if (currentTokenIs(Token::RPAREN))
+    if (!nextToken())
     {
-        nextToken();
+        return;
     }
-    else
+    push({Frame::GROUP, nullptr});
+    parseNext(Action::START_EXPRESSION);
+}
+
+void Parser::parseInfixExpression(Expression* left)
+{
+    auto expression = create<InfixExpression>(currentType());
+    expression->left = left;
+    if (!nextToken())
     {
-        std::string message("Expected " + Token::getTypeString(Token::RPAREN) + " token. Got " +
-                            Token::getTypeString(curToken->type) + " token (" +
-                            *(curToken->literal) + ")");
-        errors.emplace_back(message);
-        throw WrongTokenException();
+        return;
     }
-    return expression;
+    push({Frame::INFIX_RIGHT, expression});
+    parseNext(Action::START_EXPRESSION, getPrecedence(expression->op));
 }
 
-std::shared_ptr<Expression> Parser::parseInfixExpression(std::shared_ptr<Expression> left)
+// Start an expression of the next precedence with its prefix part. The
+// operand frame then takes the operators that follow.
+void Parser::startExpression()
 {
-    auto expression = std::make_shared<InfixExpression>(std::move(curToken));
-    expression->left = std::move(left);
-    expression->op = std::string(*expression->token->literal);
-    nextToken();
-    expression->right = parseExpression(getPrecedence(expression->token->type));
-    return expression;
+    push({Frame::OPERAND, nullptr, nextPrecedence});
+    auto prefixParseFunction = getPrefixParseFunction(currentType());
+    if (!failed)
+    {
+        (this->*prefixParseFunction)();
+    }
 }
 
-std::shared_ptr<Expression> Parser::parseExpression(Precedence precedence)
+// Continue the expression on top of the stack with the operator after its
+// left operand, or deliver it if the operator binds less tightly
+void Parser::continueExpression(Expression* left)
 {
-    auto prefixParseFunction = getPrefixParseFunction(curToken->type);
-    std::shared_ptr<Expression> leftExpression = prefixParseFunction(this);
-
-    while (precedence < getPrecedence(curToken->type))
+    if (frames.back().precedence < getPrecedence(currentType()))
     {
-        auto infixParseFunction = getInfixParseFunction(curToken->type);
-        leftExpression = infixParseFunction(this, leftExpression);
+        auto infixParseFunction = getInfixParseFunction(currentType());
+        if (infixParseFunction != nullptr)
+        {
+            (this->*infixParseFunction)(left);
+        }
+        return;
     }
-
-    return leftExpression;
+    frames.pop_back();
+    deliver(left);
 }
 
 // if ( <condition> ) { <consequence> } [ else { <alternative> } ]
-std::shared_ptr<Expression> Parser::parseIfExpression()
+void Parser::parseIfExpression()
 {
-    auto expression = std::make_shared<IfExpression>(std::move(curToken));
-    nextToken();
-    nextTokenIfType(Token::LPAREN);
-    expression->condition = parseExpression(Precedence::LOWEST);
-    nextTokenIfType(Token::RPAREN);
-    nextTokenIfType(Token::LBRACE);
-    expression->consequence = parseBlockStatement();
-    if(currentTokenIs(Token::ELSE))
+    auto expression = create<IfExpression>();
+    if (!nextToken() || !nextTokenIfType(Token::LPAREN))
     {
-        nextToken();
-        nextTokenIfType(Token::LBRACE);
-        expression->alternative = parseBlockStatement();
+        return;
     }
-    return expression;
+    push({Frame::IF_CONDITION, expression});
+    parseNext(Action::START_EXPRESSION);
 }
 
-std::shared_ptr<Expression> Parser::parseCallExpression(std::shared_ptr<Expression> function)
+void Parser::parseCallExpression(Expression* function)
 {
-    auto callExpression = std::make_shared<CallExpression>(std::move(curToken));
-    callExpression->function = std::move(function);
-    nextToken();
-    callExpression->arguments = parseCallArguments();
-    return callExpression;
+    auto callExpression = create<CallExpression>();
+    callExpression->function = function;
+    if (!nextToken())
+    {
+        return;
+    }
+    push({Frame::CALL_ARGUMENT, callExpression, Precedence::LOWEST, expressionStack.size()});
+    if (!failed)
+    {
+        continueCallArguments();
+    }
 }
 
-std::vector<std::shared_ptr<Expression>> Parser::parseCallArguments()
+// Start the next argument of the call on top of the stack, or deliver the
+// call at its closing parenthesis
+void Parser::continueCallArguments()
 {
-    std::vector<std::shared_ptr<Expression>> arguments;
-
-    while(!currentTokenIs(Token::RPAREN))
+    auto& frame = frames.back();
+    if (!currentTokenIs(Token::RPAREN))
     {
-        arguments.push_back(parseExpression(Precedence::LOWEST));
-        if (currentTokenIs(Token::RPAREN))
-        {
-            break;
-        }
+        parseNext(Action::START_EXPRESSION);
+        return;
+    }
 
-        nextTokenIfType(Token::COMMA);
+    auto callExpression = static_cast<CallExpression*>(frame.node);
+    callExpression->arguments = takeList(expressionStack, frame.first);
+    frames.pop_back();
+    if (nextToken())
+    {
+        deliver(callExpression);
     }
-    nextTokenIfType(Token::RPAREN);
-    return std::move(arguments);
 }
 
+// Returns null, and fails the parse, if the type cannot start an expression
 PrefixParseFunction Parser::getPrefixParseFunction(Token::TokenType type)
 {
-    auto function = prefixParseFunctionMap.find(type);
-    if (function != prefixParseFunctionMap.end())
+    auto function = parseRules[type].prefix;
+    if (function == nullptr)
     {
-        return function->second;
-    }
-    else
-    {
-        std::string message("No prefix parse function for " + Token::getTypeString(curToken->type) + " found");
-        errors.emplace_back(message);
-        throw PrefixParseError();
+        fail(ParserError::NO_PREFIX_PARSE_FUNCTION);
     }
+    return function;
 }
 
 InfixParseFunction Parser::getInfixParseFunction(Token::TokenType type)
 {
-    auto function = infixParseFunctionMap.find(type);
-    if (function != infixParseFunctionMap.end())
+    auto function = parseRules[type].infix;
+    if (function == nullptr)
     {
-        return infixParseFunctionMap[type];
-    }
-    else
-    {
-        std::string message("No infix parse function for " + Token::getTypeString(curToken->type) + " found");
-        errors.emplace_back(message);
-        throw InfixParseError();
+        fail(ParserError::NO_INFIX_PARSE_FUNCTION);
     }
+    return function;
 }
-
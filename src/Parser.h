@@ -9,11 +9,15 @@
 #ifndef INTERPRETER_PARSER_H
 #define INTERPRETER_PARSER_H
 
+#include <array>
+#include <cstddef>
 #include <memory>
-#include <functional>
-#include <unordered_map>
+#include <tuple>
+#include <vector>
 #include "Ast.h"
 #include "Lexer.h"
+#include "ParserError.h"
+#include "TokenBuffer.h"
 
 enum class Precedence
 {
@@ -27,47 +31,259 @@ enum class Precedence
 };
 
 class Parser;
-typedef std::function<std::shared_ptr<Expression>(Parser*)> PrefixParseFunction;
-typedef std::function<std::shared_ptr<Expression>(Parser*, std::shared_ptr<Expression>)> InfixParseFunction;
+typedef void (Parser::*PrefixParseFunction)();
+typedef void (Parser::*InfixParseFunction)(Expression*);
 
 class Parser
 {
 public:
     explicit Parser(Lexer &lexer);
+    explicit Parser(TokenBuffer tokens);
     std::shared_ptr<Program> parseProgram();
-    std::vector<std::string> errors;
+    // Read all tokens and parse their top-level statements on several
+    // threads, with the same result as parseProgram(). A threadCount of 0
+    // uses one thread per hardware thread.
+    std::shared_ptr<Program> parseProgramInParallel(unsigned threadCount = 0);
+
+    // Parse the top-level statement at the current token, with its nodes in
+    // the given program, and move past it. Returns null if the statement
+    // failed to parse; it is then skipped up to its semicolon. Always returns
+    // null in check mode.
+    Statement* parseTopLevelStatement(Program& target);
+    // Parse the next top-level statement and return it in a program of its
+    // own, which owns its nodes, or null at the end of the tokens. Statements
+    // that fail to parse are skipped. The tokens of the statements returned
+    // before are dropped, so a long input is read in bounded memory.
+    std::shared_ptr<Program> nextStatement();
+    bool atEnd() const;
+    // The position of the current token in the tokens read so far
+    size_t getPosition() const;
+
+    // Input that nests deeper than the limit is reported as an error instead
+    // of being parsed. The limit counts the parser's frames, of which each
+    // level of nesting takes a few: "-(1 + x)" takes one for the prefix
+    // operator, one for the parentheses and one for each operand.
+    static constexpr size_t defaultNestingLimit = 1u << 20;
+    void setNestingLimit(size_t limit) { nestingLimit = limit; }
+
+    // In check mode the grammar and the error recovery are the same, but no
+    // nodes are kept: parseProgram returns an empty program and only finds
+    // the errors. The tokens are dropped as they are passed, so the memory
+    // used does not grow with the input.
+    void setCheckOnly(bool checkOnly) { this->checkOnly = checkOnly; }
+
+    // With lazy function bodies, the parser only matches the brackets of a
+    // function body and leaves it to be parsed when Function::getBody is
+    // first called. The errors in the body are then added to the
+    // bodyDiagnostics of the program. Bodies whose brackets do not match are
+    // parsed at once. Recovery from an error in a lazy body stops at its
+    // closing brace. parseProgramInParallel parses on one thread in this
+    // mode.
+    void setLazyFunctionBodies(bool lazy) { lazyFunctionBodies = lazy; }
+
+    // The token positions of a block and of its statements, for reparsing
+    // only the statements of a block that an edit touched
+    struct BlockRecord
+    {
+        BlockStatement* block;
+        // The positions of the braces
+        size_t open;
+        size_t close;
+        // The frames around the statements of the block, which count towards
+        // the nesting limit
+        size_t depth;
+        // The position of the first token of each statement
+        std::vector<size_t> starts;
+    };
+    // Add a record for each block to the list as it is parsed, in the order
+    // of the opening braces. The records of blocks with errors in them are
+    // not complete.
+    void recordBlocks(std::vector<BlockRecord>* records) { blockRecords = records; }
+
+    // The messages are only put together when they are read
+    ParserErrors errors;
+
+    // The errors prefixed with "line:column: " of the token at which they
+    // were found. Locations are only worked out when this is called.
+    std::vector<std::string> diagnostics() const;
+    std::string diagnostic(size_t i) const;
 
 private:
-    Lexer& lexer;
-    std::unique_ptr<Token> curToken;
-    std::unique_ptr<Token> peekToken;
-    std::unordered_map<Token::TokenType, PrefixParseFunction> prefixParseFunctionMap;
-    std::unordered_map<Token::TokenType, InfixParseFunction> infixParseFunctionMap;
-    std::unordered_map<Token::TokenType, Precedence> precedenceMap;
+    // Tokens are read from the lexer in batches of this size when needed
+    static constexpr size_t tokenBatchSize = 4096;
+
+    Lexer* lexer;
+    // The table of the lexer, which lazy bodies are read with
+    SymbolTable* symbols;
+    TokenBuffer tokens;
+    size_t position;
+    // The number of tokens dropped from the front of the buffer, which the
+    // error positions include
+    size_t discarded;
+    // The locations of the errors in dropped tokens, and the sources that
+    // their literals point into
+    std::vector<SourceBuffer::Location> discardedLocations;
+    std::vector<std::shared_ptr<const SourceBuffer>> errorSources;
+    // Set when a parse function finds an error. The parse functions return at
+    // once, up to the statement, which is skipped.
+    bool failed;
+
+    // The program being parsed, which owns the nodes
+    Program* program;
+
+    // In check mode each node is built in the slot of its type, over the
+    // node built there before. Constructs only write to their nodes after
+    // creating them, so the nodes that are overwritten are never read.
+    bool checkOnly;
+    template<typename T>
+    struct NodeSlot
+    {
+        alignas(T) unsigned char bytes[sizeof(T)];
+    };
+    std::tuple<NodeSlot<Identifier>, NodeSlot<Integer>, NodeSlot<Boolean>, NodeSlot<Function>,
+               NodeSlot<CallExpression>, NodeSlot<PrefixExpression>, NodeSlot<InfixExpression>,
+               NodeSlot<IfExpression>, NodeSlot<LetStatement>, NodeSlot<ReturnStatement>,
+               NodeSlot<ExpressionStatement>, NodeSlot<BlockStatement>> nodeSlots;
+
+    template<typename T, typename... Args>
+    T* create(Args&&... args);
+
+    bool lazyFunctionBodies;
+    std::vector<BlockRecord>* blockRecords;
+    // The records of the blocks that are being parsed, innermost last
+    std::vector<size_t> openBlockRecords;
+    BlockRecord& currentBlockRecord(const BlockStatement* block);
+    // The brackets that are open in the function body being matched
+    std::vector<Token::TokenType> openBrackets;
+    bool skipFunctionBody(Function* function);
+    static Statement* parseLazyBody(const LazyBody& lazyBody);
+
+    // The elements of lists that are being parsed. Each list takes its
+    // elements from the top of the stack once it is complete, so nested lists
+    // can share a stack.
+    std::vector<Statement*> statementStack;
+    std::vector<Identifier*> identifierStack;
+    std::vector<Expression*> expressionStack;
+
+    struct ListMarks
+    {
+        size_t statements = 0;
+        size_t identifiers = 0;
+        size_t expressions = 0;
+    };
+
+    void discardLists(const ListMarks& marks);
+
+    // A construct that is waiting for one of its parts to be parsed. Nested
+    // constructs are kept on the frames stack instead of the call stack, so
+    // that deeply nested input cannot overflow the native stack.
+    struct Frame
+    {
+        enum Step
+        {
+            // An expression, with its left operand as the result. Collects
+            // the operators that bind tighter than the precedence.
+            OPERAND,
+            PREFIX_RIGHT,
+            INFIX_RIGHT,
+            GROUP,
+            CALL_ARGUMENT,
+            IF_CONDITION,
+            IF_CONSEQUENCE,
+            IF_ALTERNATIVE,
+            FUNCTION_BODY,
+            // A block, with the statements parsed so far on the statement stack
+            BLOCK,
+            LET_VALUE,
+            RETURN_VALUE,
+            EXPRESSION_VALUE
+        };
+
+        Step step;
+        Node* node;
+        Precedence precedence = Precedence::LOWEST;
+        // Where the list of the construct starts on its stack
+        size_t first = 0;
+        // The stack sizes before the statement that a block is parsing
+        ListMarks marks = {};
+    };
+
+    // What the parser does next. A part that has been parsed is delivered to
+    // the frame on top of the stack.
+    enum class Action
+    {
+        START_STATEMENT,
+        START_EXPRESSION,
+        START_BLOCK,
+        CONTINUE_BLOCK,
+        DELIVER
+    };
+
+    std::vector<Frame> frames;
+    size_t nestingLimit;
+    Action next;
+    // The precedence of the expression to start
+    Precedence nextPrecedence;
+    // The part to deliver
+    Node* result;
+
+    void run();
+    bool recover();
+    void push(const Frame& frame);
+    void parseNext(Action action, Precedence precedence = Precedence::LOWEST);
+    void deliver(Node* node);
+    void resume(Frame& frame);
+
+    template<typename T>
+    NodeList<T> takeList(std::vector<T*>& stack, size_t first);
+
+    // How a token type is parsed, with null functions for the types that
+    // cannot start or continue an expression
+    struct ParseRule
+    {
+        PrefixParseFunction prefix;
+        InfixParseFunction infix;
+        Precedence precedence;
+    };
+
+    static constexpr size_t tokenTypeCount = Token::RETURN + 1;
+    static const std::array<ParseRule, tokenTypeCount> parseRules;
+    static constexpr std::array<ParseRule, tokenTypeCount> createParseRules();
 
     bool currentTokenIs(const Token::TokenType &) const;
-    bool peekTokenIs(const Token::TokenType &) const;
-    void nextToken();
-    void nextTokenIfType(Token::TokenType);
-    Precedence getPrecedence(Token::TokenType);
-    std::shared_ptr<Statement> parseStatement();
-    std::shared_ptr<Statement> parseLetStatement();
-    std::shared_ptr<Statement> parseReturnStatement();
-    std::shared_ptr<Statement> parseExpressionStatement();
-    std::shared_ptr<Statement> parseBlockStatement();
-    std::shared_ptr<Identifier> parseIdentifier();
-    std::shared_ptr<Integer> parseInteger();
-    std::shared_ptr<Boolean> parseBoolean();
-    std::shared_ptr<Function> parseFunction();
-    std::vector<std::shared_ptr<Identifier>> parseFunctionParameters();
-    std::shared_ptr<Expression> parsePrefixExpression();
-    std::shared_ptr<Expression> parseGroupedExpression();
-    std::shared_ptr<Expression> parseInfixExpression(std::shared_ptr<Expression>);
-    std::shared_ptr<Expression> parseExpression(Precedence);
-    std::shared_ptr<Expression> parseIfExpression();
-    std::shared_ptr<Expression> parseCallExpression(std::shared_ptr<Expression>);
-    std::vector<std::shared_ptr<Expression>> parseCallArguments();
+    bool peekTokenIs(const Token::TokenType &);
+    Token::TokenType currentType() const;
+    Token::TokenType peekType(size_t distance);
+    bool readTokensUpTo(size_t index);
+    bool nextToken();
+    bool nextTokenIfType(Token::TokenType);
+    static Precedence getPrecedence(Token::TokenType);
+    Statement* parseStatement();
+    void startStatement();
+    void parseLetStatement();
+    void parseReturnStatement();
+    void parseExpressionStatement();
+    void finishStatement();
+    void startBlock();
+    void continueBlock();
+    Identifier* parseIdentifier();
+    void parseIdentifierExpression();
+    void parseInteger();
+    void parseBoolean();
+    void parseFunction();
+    NodeList<Identifier> parseFunctionParameters();
+    void parsePrefixExpression();
+    void parseGroupedExpression();
+    void parseInfixExpression(Expression*);
+    void startExpression();
+    void continueExpression(Expression*);
+    void parseIfExpression();
+    void parseCallExpression(Expression*);
+    void continueCallArguments();
     void consumeSemicolon();
+    void discardTokens();
+    void addError(ParserError::Code code, Token::TokenType expected = Token::ILLEGAL);
+    std::nullptr_t fail(ParserError::Code code, Token::TokenType expected = Token::ILLEGAL);
 
     PrefixParseFunction getPrefixParseFunction(Token::TokenType);
     InfixParseFunction getInfixParseFunction(Token::TokenType);
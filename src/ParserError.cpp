@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include "ParserError.h"
+
+std::string ParserError::message() const
+{
+    switch (code)
+    {
+        case WRONG_TOKEN:
+            return "Expected " + Token::getTypeString(expected) + " token. Got " + Token::getTypeString(actual) +
+                   " token (" + std::string(literal) + ")";
+        case NO_PREFIX_PARSE_FUNCTION:
+            return "No prefix parse function for " + Token::getTypeString(actual) + " found";
+        case NO_INFIX_PARSE_FUNCTION:
+            return "No infix parse function for " + Token::getTypeString(actual) + " found";
+        case NO_MORE_TOKENS:
+            return "Expected more tokens, but none present";
+        case INTEGER_OUT_OF_RANGE:
+            return "Integer literal out of range (" + std::string(literal) + ")";
+        case NESTING_TOO_DEEP:
+            return "Nesting too deep at " + Token::getTypeString(actual) + " token (" + std::string(literal) + ")";
+    }
+    return "";
+}
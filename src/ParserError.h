@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#ifndef INTERPRETER_PARSERERROR_H
+#define INTERPRETER_PARSERERROR_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Token.h"
+
+// A syntax error as found by the parser. Only the facts are recorded; the
+// message is put together when it is asked for.
+struct ParserError
+{
+    enum Code
+    {
+        WRONG_TOKEN,
+        NO_PREFIX_PARSE_FUNCTION,
+        NO_INFIX_PARSE_FUNCTION,
+        NO_MORE_TOKENS,
+        INTEGER_OUT_OF_RANGE,
+        NESTING_TOO_DEEP
+    };
+
+    Code code;
+    // The token position in the parser's input
+    size_t position;
+    // The type that was expected, for WRONG_TOKEN errors
+    Token::TokenType expected;
+    Token::TokenType actual;
+    // A view into the source, which the parser keeps alive
+    std::string_view literal;
+
+    std::string message() const;
+};
+
+// The errors of a parse, read like a vector of messages
+class ParserErrors
+{
+public:
+    void add(const ParserError& error) { records.push_back(error); }
+
+    size_t size() const { return records.size(); }
+    bool empty() const { return records.empty(); }
+    std::string operator[](size_t i) const { return records[i].message(); }
+    const ParserError& record(size_t i) const { return records[i]; }
+
+private:
+    std::vector<ParserError> records;
+};
+
+#endif //INTERPRETER_PARSERERROR_H
@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "SourceBuffer.h"
+
+SourceBuffer::SourceBuffer() : SourceBuffer(std::string()) {}
+
+SourceBuffer::SourceBuffer(std::string text) :
+        _text(std::move(text)),
+        _data(_text.c_str()),
+        _size(_text.size()),
+        _mapping(nullptr),
+        _mappingSize(0),
+        _start{1, 1} {}
+
+SourceBuffer::~SourceBuffer()
+{
+    if (_mapping != nullptr)
+    {
+        munmap(_mapping, _mappingSize);
+    }
+}
+
+std::shared_ptr<SourceBuffer> SourceBuffer::fromFile(const std::string& filename)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::system_error(errno, std::generic_category(), filename);
+    }
+
+    auto buffer = std::make_shared<SourceBuffer>();
+    struct stat status {};
+    try
+    {
+        if (fstat(fd, &status) < 0)
+        {
+            throw std::system_error(errno, std::generic_category(), filename);
+        }
+
+        if (!S_ISREG(status.st_mode) || !buffer->mapFile(fd, static_cast<size_t>(status.st_size)))
+        {
+            buffer->readFile(fd);
+        }
+    }
+    catch (std::system_error&)
+    {
+        close(fd);
+        throw;
+    }
+
+    close(fd);
+    return buffer;
+}
+
+// Map the file followed by at least one zero byte. An anonymous mapping one
+// byte larger than the file is reserved and the file is mapped over the start
+// of it. The remainder of the last page of the file is zero filled by the
+// kernel; if the file ends on a page boundary, the following page is part of
+// the anonymous mapping and thus zero as well.
+bool SourceBuffer::mapFile(int fd, size_t size)
+{
+    if (size == 0)
+    {
+        return true;
+    }
+
+    auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    auto mappingSize = (size + 1 + pageSize - 1) / pageSize * pageSize;
+    void* reserved = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (reserved == MAP_FAILED)
+    {
+        return false;
+    }
+
+    void* file = mmap(reserved, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0);
+    if (file == MAP_FAILED)
+    {
+        munmap(reserved, mappingSize);
+        return false;
+    }
+    madvise(file, size, MADV_SEQUENTIAL);
+
+    _mapping = reserved;
+    _mappingSize = mappingSize;
+    _data = static_cast<const char*>(file);
+    _size = size;
+    return true;
+}
+
+// Read the whole file in large blocks. Used for pipes and other files that
+// cannot be mapped.
+void SourceBuffer::readFile(int fd)
+{
+    const size_t blockSize = 1 << 20;
+    std::string text;
+    while (true)
+    {
+        auto used = text.size();
+        text.resize(used + blockSize);
+        auto count = read(fd, &text[used], blockSize);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+            {
+                text.resize(used);
+                continue;
+            }
+            throw std::system_error(errno, std::generic_category(), "read");
+        }
+        text.resize(used + static_cast<size_t>(count));
+        if (count == 0)
+        {
+            break;
+        }
+    }
+
+    _text = std::move(text);
+    _data = _text.c_str();
+    _size = _text.size();
+}
+
+const char* SourceBuffer::data() const
+{
+    return _data;
+}
+
+size_t SourceBuffer::size() const
+{
+    return _size;
+}
+
+std::string_view SourceBuffer::text() const
+{
+    return std::string_view(_data, _size);
+}
+
+size_t SourceBuffer::allocatedSize() const
+{
+    return _mapping != nullptr ? 0 : _text.capacity();
+}
+
+SourceBuffer::Location SourceBuffer::location(size_t offset) const
+{
+    std::call_once(_lineStartsFound, &SourceBuffer::findLineStarts, this);
+
+    // The last line that starts at or before the offset
+    auto next = std::upper_bound(_lineStarts.begin(), _lineStarts.end(), offset);
+    auto line = static_cast<size_t>(next - _lineStarts.begin()) - 1;
+    auto column = offset - _lineStarts[line] + 1;
+    if (line == 0)
+    {
+        column += _start.column - 1;
+    }
+    return {_start.line + line, column};
+}
+
+void SourceBuffer::setStartLocation(Location start)
+{
+    _start = start;
+}
+
+// memchr() compares many bytes per step, which makes this fast enough to run
+// over the whole source when the first location is asked for
+void SourceBuffer::findLineStarts() const
+{
+    _lineStarts.push_back(0);
+    const char* end = _data + _size;
+    for (auto p = _data; (p = static_cast<const char*>(std::memchr(p, '\n', end - p))) != nullptr;)
+    {
+        ++p;
+        _lineStarts.push_back(static_cast<size_t>(p - _data));
+    }
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#ifndef INTERPRETER_SOURCEBUFFER_H
+#define INTERPRETER_SOURCEBUFFER_H
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The SourceBuffer owns the characters of a program. Tokens and AST nodes
+// refer to the characters by std::string_view, so the buffer must be kept
+// alive (through a std::shared_ptr) for as long as any of them are in use.
+// The text is always followed by a terminating zero byte.
+class SourceBuffer
+{
+public:
+    SourceBuffer();
+    explicit SourceBuffer(std::string text);
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+    ~SourceBuffer();
+
+    // Regular files are memory mapped read-only. Other files, such as pipes,
+    // are read into memory. Throws std::system_error if the file cannot be read.
+    static std::shared_ptr<SourceBuffer> fromFile(const std::string& filename);
+
+    const char* data() const;
+    size_t size() const;
+    std::string_view text() const;
+
+    // The number of bytes allocated for the text, which may be more than its
+    // size. Zero for a mapped file.
+    size_t allocatedSize() const;
+
+    // Line and column of a character, both counted from 1. The columns count
+    // bytes. The offsets of the line starts are only collected on the first
+    // call, so reading a source that has no errors never pays for them.
+    struct Location
+    {
+        size_t line;
+        size_t column;
+    };
+    Location location(size_t offset) const;
+
+    // The location of the first character, for a buffer that holds a part of
+    // a larger input
+    void setStartLocation(Location start);
+
+private:
+    std::string _text;
+    const char* _data;
+    size_t _size;
+    void* _mapping;
+    size_t _mappingSize;
+    Location _start;
+    mutable std::vector<size_t> _lineStarts;
+    mutable std::once_flag _lineStartsFound;
+
+    bool mapFile(int fd, size_t size);
+    void readFile(int fd);
+    void findLineStarts() const;
+};
+
+#endif //INTERPRETER_SOURCEBUFFER_H
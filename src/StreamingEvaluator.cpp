@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include <stack>
+#include "Ast.h"
+#include "StreamingEvaluator.h"
+
+namespace
+{
+    // Whether the Evaluator leaves a value for a statement. It does not
+    // evaluate identifiers, functions and calls yet, and pushes no value for
+    // them, nor for let statements. Operators around them, or a block without
+    // a value, would then take from an empty stack. The tree is walked with an
+    // explicit stack, as the Evaluator does.
+    class ValueCheck : public AstVisitor
+    {
+    public:
+        bool hasValue(Statement& statement)
+        {
+            if (dynamic_cast<LetStatement*>(&statement) != nullptr)
+            {
+                return false;
+            }
+            valid = true;
+            statement.accept(*this);
+            while (valid && !pending.empty())
+            {
+                auto node = pending.top();
+                pending.pop();
+                node->accept(*this);
+            }
+            pending = {};
+            return valid;
+        }
+
+        void visitIdentifier(Identifier&) override { valid = false; }
+        void visitInteger(Integer&) override {}
+        void visitBoolean(Boolean&) override {}
+        void visitFunction(Function&) override { valid = false; }
+        void visitCallExpression(CallExpression&) override { valid = false; }
+
+        void visitPrefixExpression(PrefixExpression& expression) override
+        {
+            push(expression.right);
+        }
+
+        void visitInfixExpression(InfixExpression& expression) override
+        {
+            push(expression.left);
+            push(expression.right);
+        }
+
+        void visitIfExpression(IfExpression& expression) override
+        {
+            push(expression.condition);
+            push(expression.consequence);
+            if (expression.alternative != nullptr)
+            {
+                push(expression.alternative);
+            }
+        }
+
+        // Let statements are skipped by the Evaluator, so they are fine in a
+        // block, as long as another statement gives it a value
+        void visitLetStatement(LetStatement&) override {}
+
+        void visitReturnStatement(ReturnStatement& statement) override
+        {
+            push(statement.expression);
+        }
+
+        void visitExpressionStatement(ExpressionStatement& statement) override
+        {
+            push(statement.expression);
+        }
+
+        void visitBlockStatement(BlockStatement& statement) override
+        {
+            bool hasValue = false;
+            for (auto child : statement.statements)
+            {
+                if (dynamic_cast<LetStatement*>(child) == nullptr)
+                {
+                    hasValue = true;
+                    push(child);
+                }
+            }
+            valid = valid && hasValue;
+        }
+
+        void visitProgram(Program&) override {}
+        void visitControlToken(ControlToken&) override {}
+
+    private:
+        bool valid = true;
+        std::stack<Node*> pending;
+
+        void push(Node* node)
+        {
+            if (node == nullptr)
+            {
+                valid = false;
+                return;
+            }
+            pending.push(node);
+        }
+    };
+}
+
+StreamingEvaluator::StreamingEvaluator(Parser& parser) : parser(parser), returned(false) {}
+
+bool StreamingEvaluator::step()
+{
+    value = nullptr;
+    if (returned)
+    {
+        return false;
+    }
+
+    auto program = parser.nextStatement();
+    if (program == nullptr)
+    {
+        return false;
+    }
+
+    // A statement gets an evaluator of its own, as the Evaluator keeps the
+    // values a block computes before its last one on its stack
+    if (program->statements.size() != 1)
+    {
+        return true;
+    }
+    auto statement = program->statements[0];
+    if (ValueCheck().hasValue(*statement))
+    {
+        Evaluator evaluator;
+        value = evaluator.eval(program);
+        returned = evaluator.hasReturned();
+    }
+    else
+    {
+        returned = dynamic_cast<ReturnStatement*>(statement) != nullptr;
+    }
+    return true;
+}
+
+const std::shared_ptr<Object>& StreamingEvaluator::result() const
+{
+    return value;
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#ifndef INTERPRETER_STREAMINGEVALUATOR_H
+#define INTERPRETER_STREAMINGEVALUATOR_H
+
+#include <memory>
+#include "Evaluator.h"
+#include "Object.h"
+#include "Parser.h"
+
+// Evaluates a program while it is parsed. Each top-level statement is
+// evaluated as soon as the parser has it, and its nodes are released after
+// that unless something else holds on to them. Memory use thus depends on the
+// largest statement rather than on the length of the program, and the first
+// result is ready after the first statement rather than after the whole
+// program.
+//
+// Statements that the Evaluator cannot give a value yet, such as let
+// statements and those that use identifiers, functions or calls, are parsed
+// but not evaluated, and have no value.
+class StreamingEvaluator
+{
+public:
+    explicit StreamingEvaluator(Parser& parser);
+
+    // Parse and evaluate the next statement. Returns false at the end of the
+    // program, and after a return statement, which ends it.
+    bool step();
+
+    // The value of the statement evaluated last, or null if it has none
+    const std::shared_ptr<Object>& result() const;
+
+private:
+    Parser& parser;
+    std::shared_ptr<Object> value;
+    bool returned;
+};
+
+#endif //INTERPRETER_STREAMINGEVALUATOR_H
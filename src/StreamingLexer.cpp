@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <string>
+#include <system_error>
+#include <unistd.h>
+#include "StreamingLexer.h"
+
+StreamingLexer::StreamingLexer(StreamingLexer::Reader reader, size_t chunkSize) :
+        reader(std::move(reader)),
+        chunkSize(chunkSize),
+        chunkOffset(0),
+        chunkLocation({1, 1}),
+        endOfInput(false) {}
+
+StreamingLexer::~StreamingLexer() = default;
+
+std::unique_ptr<Token> StreamingLexer::nextToken()
+{
+    if (EOFFound)
+    {
+        return nullptr;
+    }
+
+    size_t start;
+    auto type = readStreamToken(start);
+    if (type == Token::ENDOFFILE)
+    {
+        EOFFound = true;
+        return std::make_unique<Token>(Token::ENDOFFILE, "EOF");
+    }
+    if (tokenChunks.empty() || tokenChunks.back() != source)
+    {
+        tokenChunks.push_back(source);
+    }
+    return std::make_unique<Token>(type, createString(start, curPos), tokenValue(type, start));
+}
+
+bool StreamingLexer::readTokens(TokenBuffer &tokens, size_t count)
+{
+    for (size_t i = 0; (i < count) && !EOFFound; ++i)
+    {
+        size_t start;
+        auto type = readStreamToken(start);
+        if (tokens.lastSource() != source)
+        {
+            tokens.addSource(source, chunkOffset);
+        }
+        tokens.add(type, chunkOffset + start, curPos - start, tokenValue(type, start));
+        EOFFound = (type == Token::ENDOFFILE);
+    }
+    return !EOFFound;
+}
+
+// Read a token that is known to be complete. A token that ends at the end of
+// the chunk may continue in the next chunk, so in that case it is read again
+// once more input is available.
+Token::TokenType StreamingLexer::readStreamToken(size_t &start)
+{
+    while (true)
+    {
+        auto type = readToken(start);
+        if (endOfInput || (curPos < source->size()))
+        {
+            return type;
+        }
+        readChunk(type == Token::ENDOFFILE ? curPos : start);
+    }
+}
+
+// Start a new chunk with the characters of the current chunk from keepFrom
+// and onwards, followed by the next input from the reader. At least as many
+// bytes are read as are kept, so that the kept characters, which are read
+// again, are paid for by the new ones.
+void StreamingLexer::readChunk(size_t keepFrom)
+{
+    auto kept = source->text().substr(keepFrom);
+    auto size = std::max(chunkSize, kept.size());
+    std::string text(kept);
+    text.resize(kept.size() + size);
+    size_t count = 0;
+    do
+    {
+        auto read = reader(&text[kept.size() + count], size - count);
+        endOfInput = (read == 0);
+        count += read;
+    }
+    while (!endOfInput && count < kept.size());
+    text.resize(kept.size() + count);
+
+    // The chunk lives as long as its tokens, so a short read, such as a line
+    // written by an interactive producer, should not keep a whole chunk
+    if (text.capacity() > 2 * text.size())
+    {
+        text.shrink_to_fit();
+    }
+
+    // The lines of the characters that are left behind are counted here, as
+    // asking the chunk for a location would collect all of its line starts
+    auto left = source->text().substr(0, keepFrom);
+    auto lastNewline = left.rfind('\n');
+    if (lastNewline == std::string_view::npos)
+    {
+        chunkLocation.column += keepFrom;
+    }
+    else
+    {
+        chunkLocation.line += static_cast<size_t>(std::count(left.begin(), left.end(), '\n'));
+        chunkLocation.column = keepFrom - lastNewline;
+    }
+
+    chunkOffset += keepFrom;
+    auto chunk = std::make_shared<SourceBuffer>(std::move(text));
+    chunk->setStartLocation(chunkLocation);
+    setSource(std::move(chunk));
+}
+
+StreamingLexer::Reader StreamingLexer::fileDescriptorReader(int fd)
+{
+    return [fd](char *buffer, size_t size) -> size_t
+    {
+        while (true)
+        {
+            auto count = read(fd, buffer, size);
+            if (count >= 0)
+            {
+                return static_cast<size_t>(count);
+            }
+            if (errno != EINTR)
+            {
+                throw std::system_error(errno, std::generic_category(), "read");
+            }
+        }
+    };
+}
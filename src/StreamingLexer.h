@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#ifndef INTERPRETER_STREAMINGLEXER_H
+#define INTERPRETER_STREAMINGLEXER_H
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include "Lexer.h"
+
+// A lexer that reads its input in chunks from a reader function, so that
+// tokenizing can start before all of the input is available.
+//
+// Each chunk is kept in a SourceBuffer of its own. A token that reaches the
+// end of a chunk may continue in the next one; its characters are then
+// carried over to the start of the next chunk. The lexer itself only holds
+// the current chunk. Older chunks are freed when no token refers to them:
+// a TokenBuffer keeps the chunks of its tokens, while the chunks of tokens
+// returned by nextToken() are kept until the lexer is destroyed.
+// Each chunk records the line and column at which it starts, so that token
+// locations do not depend on the earlier chunks. A token that does not fit
+// into a chunk makes the next chunk at least twice as long as the token, so
+// that a long token is only read again a few times.
+class StreamingLexer : public Lexer
+{
+public:
+    // Reads at most size bytes into the buffer and returns the number of bytes
+    // read. May return fewer bytes than requested. Returns 0 at end of input.
+    // A read error is reported by an exception, which the lexer passes on.
+    typedef std::function<size_t(char *buffer, size_t size)> Reader;
+
+    explicit StreamingLexer(Reader reader, size_t chunkSize = 64 * 1024);
+    ~StreamingLexer() override;
+
+    std::unique_ptr<Token> nextToken() override;
+    bool readTokens(TokenBuffer& tokens, size_t count) override;
+
+    // A reader for a file descriptor, e.g. 0 for standard input. Throws
+    // std::system_error if the descriptor cannot be read.
+    static Reader fileDescriptorReader(int fd);
+
+private:
+    Reader reader;
+    size_t chunkSize;
+    size_t chunkOffset;
+    SourceBuffer::Location chunkLocation;
+    bool endOfInput;
+    std::vector<std::shared_ptr<const SourceBuffer>> tokenChunks;
+
+    Token::TokenType readStreamToken(size_t &start);
+    void readChunk(size_t keepFrom);
+};
+
+#endif //INTERPRETER_STREAMINGLEXER_H
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include <cstring>
+#include "SymbolTable.h"
+
+SymbolTable::SymbolTable() : slots(1024, emptySlot), freeSpace(nullptr), freeSize(0) {}
+
+SymbolTable::~SymbolTable() = default;
+
+SymbolTable::Symbol SymbolTable::intern(std::string_view name)
+{
+    auto nameHash = hash(name);
+    auto mask = slots.size() - 1;
+    for (auto slot = nameHash & mask; ; slot = (slot + 1) & mask)
+    {
+        auto symbol = slots[slot];
+        if (symbol == emptySlot)
+        {
+            symbol = static_cast<Symbol>(names.size());
+            slots[slot] = symbol;
+            names.push_back(store(name));
+            hashes.push_back(nameHash);
+            // Keep the load factor below one half
+            if (names.size() * 2 > slots.size())
+            {
+                grow();
+            }
+            return symbol;
+        }
+        if (hashes[symbol] == nameHash && names[symbol] == name)
+        {
+            return symbol;
+        }
+    }
+}
+
+std::string_view SymbolTable::name(Symbol symbol) const
+{
+    return names[symbol];
+}
+
+size_t SymbolTable::size() const
+{
+    return names.size();
+}
+
+SymbolTable& SymbolTable::global()
+{
+    static SymbolTable table;
+    return table;
+}
+
+// Mixes in eight bytes per step, as long identifiers are common in generated
+// code
+uint32_t SymbolTable::hash(std::string_view name)
+{
+    const uint64_t multiplier = 0x9e3779b97f4a7c15u;
+    uint64_t h = name.size() * multiplier;
+    size_t i = 0;
+    for (; i + 8 <= name.size(); i += 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, name.data() + i, 8);
+        h = (h ^ word) * multiplier;
+        h ^= h >> 32;
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, name.data() + i, name.size() - i);
+    h = (h ^ tail) * multiplier;
+    return static_cast<uint32_t>(h ^ (h >> 32));
+}
+
+// Copy the name into the current block. A name longer than a block gets a
+// block of its own.
+std::string_view SymbolTable::store(std::string_view name)
+{
+    char* copy;
+    if (name.size() > blockSize)
+    {
+        blocks.push_back(std::make_unique<char[]>(name.size()));
+        copy = blocks.back().get();
+    }
+    else
+    {
+        if (freeSpace == nullptr || name.size() > freeSize)
+        {
+            blocks.push_back(std::make_unique<char[]>(blockSize));
+            freeSpace = blocks.back().get();
+            freeSize = blockSize;
+        }
+        copy = freeSpace;
+        freeSpace += name.size();
+        freeSize -= name.size();
+    }
+    std::memcpy(copy, name.data(), name.size());
+    return std::string_view(copy, name.size());
+}
+
+void SymbolTable::grow()
+{
+    slots.assign(slots.size() * 2, emptySlot);
+    auto mask = slots.size() - 1;
+    for (Symbol symbol = 0; symbol < names.size(); ++symbol)
+    {
+        auto slot = hashes[symbol] & mask;
+        while (slots[slot] != emptySlot)
+        {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = symbol;
+    }
+}
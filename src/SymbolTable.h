@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#ifndef INTERPRETER_SYMBOLTABLE_H
+#define INTERPRETER_SYMBOLTABLE_H
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Maps identifier names to dense 32-bit symbols, numbered from 0 in the order
+// the names are first seen. Names that are equal get the same symbol, so names
+// can be compared and looked up as integers.
+//
+// Each name is stored once, in large blocks owned by the table, and stays
+// valid as long as the table. The table is not thread-safe.
+class SymbolTable
+{
+public:
+    typedef uint32_t Symbol;
+
+    SymbolTable();
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+    ~SymbolTable();
+
+    // Returns the symbol of the name, adding the name if it is new
+    Symbol intern(std::string_view name);
+    std::string_view name(Symbol symbol) const;
+    size_t size() const;
+
+    // The table used by lexers that are not given a table of their own
+    static SymbolTable& global();
+
+private:
+    static constexpr size_t blockSize = 64 * 1024;
+    static constexpr uint32_t emptySlot = UINT32_MAX;
+
+    // Open addressing with linear probing. A slot holds a symbol or emptySlot.
+    std::vector<uint32_t> slots;
+    std::vector<std::string_view> names;
+    std::vector<uint32_t> hashes;
+
+    // The names are copied to the free space at the end of the last block
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char* freeSpace;
+    size_t freeSize;
+
+    static uint32_t hash(std::string_view name);
+    std::string_view store(std::string_view name);
+    void grow();
+};
+
+#endif //INTERPRETER_SYMBOLTABLE_H
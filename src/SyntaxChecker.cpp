@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <system_error>
+#include <thread>
+#include "Lexer.h"
+#include "Parser.h"
+#include "SymbolTable.h"
+#include "SyntaxChecker.h"
+
+std::vector<SyntaxChecker::Result> SyntaxChecker::check(const std::vector<std::string>& filenames,
+                                                        unsigned threadCount)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    auto workerCount = std::max<size_t>(std::min<size_t>(threadCount, filenames.size()), 1);
+
+    std::vector<Result> results(filenames.size());
+    std::atomic<size_t> nextFile(0);
+    auto work = [&]()
+    {
+        for (auto file = nextFile++; file < filenames.size(); file = nextFile++)
+        {
+            results[file] = checkFile(filenames[file]);
+        }
+    };
+
+    // The calling thread is one of the workers
+    std::vector<std::thread> threads;
+    threads.reserve(workerCount - 1);
+    for (size_t worker = 1; worker < workerCount; ++worker)
+    {
+        threads.emplace_back(work);
+    }
+    work();
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    return results;
+}
+
+SyntaxChecker::Result SyntaxChecker::checkFile(const std::string& filename)
+{
+    std::shared_ptr<SourceBuffer> source;
+    try
+    {
+        source = SourceBuffer::fromFile(filename);
+    }
+    catch (std::system_error& error)
+    {
+        return {filename, false, {std::string("Cannot read ") + error.what()}};
+    }
+    return {filename, true, checkSource(source)};
+}
+
+// The global symbol table is not thread-safe, so the lexer is given a table
+// of its own
+std::vector<std::string> SyntaxChecker::checkSource(const std::shared_ptr<const SourceBuffer>& source)
+{
+    SymbolTable symbols;
+    Lexer lexer(source);
+    lexer.setSymbolTable(symbols);
+    Parser parser(lexer);
+    parser.setCheckOnly(true);
+    parser.parseProgram();
+    return parser.diagnostics();
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#ifndef INTERPRETER_SYNTAXCHECKER_H
+#define INTERPRETER_SYNTAXCHECKER_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "SourceBuffer.h"
+
+// Checks whether files parse, without building their programs. Each file is
+// parsed in the check mode of the Parser, with a symbol table of its own.
+//
+// The files are checked by a pool of threads, each of which takes the next
+// file that no thread has taken yet, so a few large files do not hold up the
+// rest.
+class SyntaxChecker
+{
+public:
+    struct Result
+    {
+        std::string filename;
+        // False if the file could not be read
+        bool readable;
+        // The errors prefixed with "line:column: ", as Parser::diagnostics, or
+        // the reason why the file could not be read
+        std::vector<std::string> diagnostics;
+
+        bool passed() const { return readable && diagnostics.empty(); }
+    };
+
+    // The results are in the order of the files. A threadCount of 0 uses one
+    // thread per hardware thread.
+    static std::vector<Result> check(const std::vector<std::string>& filenames, unsigned threadCount = 0);
+
+    static Result checkFile(const std::string& filename);
+    static std::vector<std::string> checkSource(const std::shared_ptr<const SourceBuffer>& source);
+};
+
+#endif //INTERPRETER_SYNTAXCHECKER_H
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include <algorithm>
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned threadCount) :
+        task(nullptr),
+        taskCount(0),
+        nextTask(0),
+        generation(0),
+        busyWorkers(0),
+        stopping(false)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    workers.reserve(threadCount - 1);
+    for (unsigned worker = 1; worker < threadCount; ++worker)
+    {
+        workers.emplace_back(&ThreadPool::work, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobStarted.notify_all();
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::run(size_t count, const std::function<void(size_t)>& newTask)
+{
+    std::lock_guard<std::mutex> runLock(runMutex);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        task = &newTask;
+        taskCount = count;
+        nextTask = 0;
+        busyWorkers = workers.size();
+        ++generation;
+    }
+    jobStarted.notify_all();
+    runTasks();
+
+    // The task must outlive every worker that may still call it
+    std::unique_lock<std::mutex> lock(mutex);
+    jobFinished.wait(lock, [this]() { return busyWorkers == 0; });
+    task = nullptr;
+}
+
+unsigned ThreadPool::threadCount() const
+{
+    return static_cast<unsigned>(workers.size()) + 1;
+}
+
+ThreadPool& ThreadPool::shared()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::work()
+{
+    size_t seen = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobStarted.wait(lock, [this, seen]() { return stopping || generation != seen; });
+            if (stopping)
+            {
+                return;
+            }
+            seen = generation;
+        }
+        runTasks();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --busyWorkers;
+        }
+        jobFinished.notify_one();
+    }
+}
+
+void ThreadPool::runTasks()
+{
+    for (auto next = nextTask++; next < taskCount; next = nextTask++)
+    {
+        (*task)(next);
+    }
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#ifndef INTERPRETER_THREADPOOL_H
+#define INTERPRETER_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A set of worker threads that are started once and kept waiting for work,
+// so that a call that runs tasks in parallel does not pay for starting and
+// joining threads.
+//
+// The calling thread runs tasks as well. Each thread takes the next task
+// that no thread has taken yet, so a few long tasks do not hold up the rest.
+// Calls to run() from several threads take turns. A task must not call run()
+// on the pool that runs it.
+class ThreadPool
+{
+public:
+    // Starts threadCount - 1 workers. A threadCount of 0 uses one thread per
+    // hardware thread.
+    explicit ThreadPool(unsigned threadCount = 0);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool();
+
+    // Runs task(0) to task(count - 1) and returns when all of them have
+    // finished
+    void run(size_t count, const std::function<void(size_t)>& task);
+
+    // The number of threads that run tasks, the calling thread included
+    unsigned threadCount() const;
+
+    // A pool with one thread per hardware thread, started on first use
+    static ThreadPool& shared();
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex runMutex;
+
+    // The current job. A new job is started by increasing the generation.
+    std::mutex mutex;
+    std::condition_variable jobStarted;
+    std::condition_variable jobFinished;
+    const std::function<void(size_t)>* task;
+    size_t taskCount;
+    std::atomic<size_t> nextTask;
+    size_t generation;
+    size_t busyWorkers;
+    bool stopping;
+
+    void work();
+    void runTasks();
+};
+
+#endif //INTERPRETER_THREADPOOL_H
@@ -6,56 +6,95 @@
  *
  */
 
+#include <array>
 #include "Token.h"
 
-Token::Token(const std::string& literal)
+namespace
 {
-    type = lookUpType(literal);
-    this->literal = std::make_shared<std::string>(literal);
-}
+    struct Keyword
+    {
+        std::string_view spelling;
+        Token::TokenType type;
+    };
 
-Token::Token(Token::TokenType type, const std::string& literal) : type {type}
-{
-    this->literal = std::make_shared<std::string>(literal);
-}
+    // To add a keyword, add it to this list. If the new keyword collides with
+    // an existing one in keywordHash, the static_assert below will fail and the
+    // hash function (or the table size) has to be adjusted.
+    constexpr Keyword keywords[] =
+    {
+        {"let", Token::LET},
+        {"fn", Token::FUNCTION},
+        {"true", Token::TRUE},
+        {"false", Token::FALSE},
+        {"if", Token::IF},
+        {"else", Token::ELSE},
+        {"return", Token::RETURN},
+    };
 
-Token::~Token() = default;
+    constexpr size_t keywordTableSize = 16;
+    static_assert((keywordTableSize & (keywordTableSize - 1)) == 0, "Table size must be a power of two");
 
-Token::TokenType Token::lookUpType(const std::string& tokenString)
-{
-    if (tokenString == std::string("let"))
+    // Hash over the length and the first and last characters. The string must not be empty.
+    constexpr size_t keywordHash(std::string_view s)
     {
-        return LET;
+        return (s.size() * 4 + static_cast<unsigned char>(s.front()) * 2 +
+                static_cast<unsigned char>(s.back())) & (keywordTableSize - 1);
     }
 
-    if (tokenString == std::string("fn"))
+    // Empty slots have an empty spelling and can therefore never match an identifier
+    constexpr std::array<Keyword, keywordTableSize> createKeywordTable()
     {
-        return FUNCTION;
+        std::array<Keyword, keywordTableSize> table {};
+        for (auto& slot : table)
+        {
+            slot = {"", Token::IDENTIFIER};
+        }
+        for (const auto& keyword : keywords)
+        {
+            table[keywordHash(keyword.spelling)] = keyword;
+        }
+        return table;
     }
 
-    if (tokenString == std::string("true"))
-    {
-        return TRUE;
-    }
+    constexpr auto keywordTable = createKeywordTable();
 
-    if (tokenString == std::string("false"))
+    constexpr bool isPerfectHash()
     {
-        return FALSE;
+        for (const auto& keyword : keywords)
+        {
+            if (keywordTable[keywordHash(keyword.spelling)].spelling != keyword.spelling)
+            {
+                return false;
+            }
+        }
+        return true;
     }
+    static_assert(isPerfectHash(), "Keyword hash collision - adjust keywordHash");
+}
 
-    if (tokenString == std::string("if"))
-    {
-        return IF;
-    }
+Token::Token(std::string_view literal) : type {lookUpType(literal)}, literal {literal}, value {0} {}
 
-    if (tokenString == std::string("else"))
+Token::Token(Token::TokenType type, std::string_view literal) : type {type}, literal {literal}, value {0} {}
+
+Token::Token(Token::TokenType type, std::string_view literal, int64_t value) :
+        type {type},
+        literal {literal},
+        value {value} {}
+
+Token::~Token() = default;
+
+Token::TokenType Token::lookUpType(std::string_view tokenString)
+{
+    if (tokenString.empty())
     {
-        return ELSE;
+        return IDENTIFIER;
     }
 
-    if (tokenString == std::string("return"))
+    // A single probe in the perfect hash table decides whether the string is a keyword
+    const auto& keyword = keywordTable[keywordHash(tokenString)];
+    if (keyword.spelling == tokenString)
     {
-        return RETURN;
+        return keyword.type;
     }
 
     // Not a keyword
@@ -124,3 +163,57 @@ std::string Token::getTypeString(Token::TokenType type)
     return std::string();
 }
 
+std::string_view Token::getLiteral(Token::TokenType type)
+{
+    switch (type)
+    {
+        case ASSIGN:
+            return "=";
+        case PLUS:
+            return "+";
+        case MINUS:
+            return "-";
+        case BANG:
+            return "!";
+        case ASTERISK:
+            return "*";
+        case SLASH:
+            return "/";
+        case LT:
+            return "<";
+        case GT:
+            return ">";
+        case EQ:
+            return "==";
+        case NEQ:
+            return "!=";
+        case COMMA:
+            return ",";
+        case SEMICOLON:
+            return ";";
+        case LPAREN:
+            return "(";
+        case RPAREN:
+            return ")";
+        case LBRACE:
+            return "{";
+        case RBRACE:
+            return "}";
+        case FUNCTION:
+            return "fn";
+        case LET:
+            return "let";
+        case TRUE:
+            return "true";
+        case FALSE:
+            return "false";
+        case IF:
+            return "if";
+        case ELSE:
+            return "else";
+        case RETURN:
+            return "return";
+        default:
+            return "";
+    }
+}
@@ -9,8 +9,9 @@
 #ifndef INTERPRETER_TOKEN_H
 #define INTERPRETER_TOKEN_H
 
-#include <memory>
+#include <cstdint>
 #include <string>
+#include <string_view>
 
 class Token
 {
@@ -46,16 +47,32 @@ public:
         RETURN
     };
 
-    explicit Token(const std::string& literal);
-    Token(TokenType type, const std::string& literal);
+    explicit Token(std::string_view literal);
+    Token(TokenType type, std::string_view literal);
+    Token(TokenType type, std::string_view literal, int64_t value);
     ~Token();
 
     enum TokenType type;
-    std::shared_ptr<std::string> literal;
+
+    // The literal is a view into the source buffer the token was read from
+    // (or into static storage for the EOF token). The lexer that returned the
+    // token keeps the buffer alive.
+    std::string_view literal;
+
+    // The value of an INT token, converted by the lexer. Literals that do not
+    // fit in an int64_t have the value OUT_OF_RANGE. For an IDENTIFIER token
+    // read by a lexer, the symbol of the name in the lexer's symbol table.
+    int64_t value;
+    static constexpr int64_t OUT_OF_RANGE = -1;
+
     static std::string getTypeString(Token::TokenType type);
 
-private:
-    static TokenType lookUpType(const std::string& tokenString);
+    // The literal of an operator, delimiter or keyword, which all tokens of
+    // the type share. Empty for the other types.
+    static std::string_view getLiteral(Token::TokenType type);
+
+    // Returns the keyword type of the string, or IDENTIFIER if it is not a keyword
+    static TokenType lookUpType(std::string_view tokenString);
 };
 
 #endif //INTERPRETER_TOKEN_H
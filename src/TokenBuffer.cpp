@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include <algorithm>
+#include <stdexcept>
+#include "TokenBuffer.h"
+
+namespace
+{
+    // Overwrite what can be overwritten, so that the tail of the array is only
+    // moved when the number of elements changes
+    template<typename T>
+    void splice(std::vector<T>& array, size_t first, size_t count, const std::vector<T>& with)
+    {
+        auto common = std::min(count, with.size());
+        std::copy(with.begin(), with.begin() + common, array.begin() + first);
+        if (count > common)
+        {
+            array.erase(array.begin() + first + common, array.begin() + first + count);
+        }
+        else
+        {
+            array.insert(array.begin() + first + common, with.begin() + common, with.end());
+        }
+    }
+}
+
+TokenBuffer::TokenBuffer() = default;
+
+TokenBuffer::TokenBuffer(std::shared_ptr<const SourceBuffer> source)
+{
+    addSource(std::move(source), 0);
+}
+
+void TokenBuffer::reserve(size_t count)
+{
+    types.reserve(count);
+    offsets.reserve(count);
+    lengths.reserve(count);
+    values.reserve(count);
+}
+
+void TokenBuffer::addSource(std::shared_ptr<const SourceBuffer> source, size_t baseOffset)
+{
+    if (!segments.empty() && segments.back().firstToken == size())
+    {
+        // No tokens have been read from the last source; replace it
+        segments.back() = {size(), baseOffset, std::move(source)};
+    }
+    else
+    {
+        segments.push_back({size(), baseOffset, std::move(source)});
+    }
+}
+
+const std::shared_ptr<const SourceBuffer>& TokenBuffer::lastSource() const
+{
+    static const std::shared_ptr<const SourceBuffer> none;
+    return segments.empty() ? none : segments.back().source;
+}
+
+void TokenBuffer::add(Token::TokenType type, size_t offset, size_t length, int64_t value)
+{
+    if (length > UINT32_MAX)
+    {
+        throw std::length_error("token of 4 GiB or longer");
+    }
+    types.push_back(static_cast<uint8_t>(type));
+    offsets.push_back(offset);
+    lengths.push_back(static_cast<uint32_t>(length));
+    values.push_back(value);
+}
+
+void TokenBuffer::append(const TokenBuffer &other)
+{
+    const size_t first = size();
+    for (const auto& otherSegment : other.segments)
+    {
+        if (otherSegment.source == lastSource())
+        {
+            continue;
+        }
+        Segment shifted = {first + otherSegment.firstToken, otherSegment.baseOffset, otherSegment.source};
+        if (!segments.empty() && segments.back().firstToken == shifted.firstToken)
+        {
+            // No tokens have been read from the last source; replace it
+            segments.back() = std::move(shifted);
+        }
+        else
+        {
+            segments.push_back(std::move(shifted));
+        }
+    }
+    types.insert(types.end(), other.types.begin(), other.types.end());
+    offsets.insert(offsets.end(), other.offsets.begin(), other.offsets.end());
+    lengths.insert(lengths.end(), other.lengths.begin(), other.lengths.end());
+    values.insert(values.end(), other.values.begin(), other.values.end());
+}
+
+TokenBuffer TokenBuffer::slice(size_t first, size_t end) const
+{
+    TokenBuffer result;
+    if (first < end)
+    {
+        const auto& firstSegment = segment(first);
+        result.segments.push_back({0, firstSegment.baseOffset, firstSegment.source});
+        for (const auto& otherSegment : segments)
+        {
+            if (otherSegment.firstToken > first && otherSegment.firstToken < end)
+            {
+                result.segments.push_back({otherSegment.firstToken - first, otherSegment.baseOffset,
+                                           otherSegment.source});
+            }
+        }
+    }
+    result.types.assign(types.begin() + first, types.begin() + end);
+    result.offsets.assign(offsets.begin() + first, offsets.begin() + end);
+    result.lengths.assign(lengths.begin() + first, lengths.begin() + end);
+    result.values.assign(values.begin() + first, values.begin() + end);
+    return result;
+}
+
+void TokenBuffer::replace(size_t first, size_t count, const TokenBuffer &other, int64_t delta)
+{
+    const size_t end = first + count;
+    const bool tokensAfter = end < size();
+    const Segment after = tokensAfter ? segment(end) : Segment();
+
+    auto kept = std::lower_bound(segments.begin(), segments.end(), first,
+                                 [](const Segment& s, size_t i) { return s.firstToken < i; });
+    std::vector<Segment> tail(std::upper_bound(segments.begin(), segments.end(), end,
+                                               [](size_t i, const Segment& s) { return i < s.firstToken; }),
+                              segments.end());
+    segments.erase(kept, segments.end());
+    for (const auto& otherSegment : other.segments)
+    {
+        pushSegment({first + otherSegment.firstToken, otherSegment.baseOffset, otherSegment.source});
+    }
+    if (tokensAfter)
+    {
+        pushSegment({first + other.size(), after.baseOffset + delta, after.source});
+    }
+    for (const auto& tailSegment : tail)
+    {
+        pushSegment({tailSegment.firstToken - count + other.size(), tailSegment.baseOffset + delta,
+                     tailSegment.source});
+    }
+
+    splice(types, first, count, other.types);
+    splice(offsets, first, count, other.offsets);
+    splice(lengths, first, count, other.lengths);
+    splice(values, first, count, other.values);
+    auto shift = static_cast<uint64_t>(delta);
+    for (size_t i = first + other.size(); i < offsets.size(); ++i)
+    {
+        offsets[i] += shift;
+    }
+}
+
+void TokenBuffer::replaceSource(std::shared_ptr<const SourceBuffer> source)
+{
+    segments.assign(1, {0, 0, std::move(source)});
+}
+
+void TokenBuffer::discard(size_t count)
+{
+    if (!segments.empty())
+    {
+        // Keep the segment of the first remaining token and those after it
+        auto next = std::upper_bound(segments.begin(), segments.end(), count,
+                                     [](size_t i, const Segment& s) { return i < s.firstToken; });
+        segments.erase(segments.begin(), next - 1);
+        for (auto& tokenSegment : segments)
+        {
+            tokenSegment.firstToken = tokenSegment.firstToken > count ? tokenSegment.firstToken - count : 0;
+        }
+    }
+    types.erase(types.begin(), types.begin() + count);
+    offsets.erase(offsets.begin(), offsets.begin() + count);
+    lengths.erase(lengths.begin(), lengths.begin() + count);
+    values.erase(values.begin(), values.begin() + count);
+}
+
+std::string_view TokenBuffer::literal(size_t index) const
+{
+    if (type(index) == Token::ENDOFFILE)
+    {
+        return "EOF";
+    }
+    const auto& tokenSegment = segment(index);
+    return std::string_view(tokenSegment.source->data() + (offsets[index] - tokenSegment.baseOffset),
+                            lengths[index]);
+}
+
+Token TokenBuffer::token(size_t index) const
+{
+    if (type(index) == Token::ENDOFFILE)
+    {
+        return Token(Token::ENDOFFILE, "EOF");
+    }
+    return Token(type(index), literal(index), value(index));
+}
+
+const std::shared_ptr<const SourceBuffer>& TokenBuffer::source(size_t index) const
+{
+    return segment(index).source;
+}
+
+size_t TokenBuffer::baseOffset(size_t index) const
+{
+    return segment(index).baseOffset;
+}
+
+SourceBuffer::Location TokenBuffer::location(size_t index) const
+{
+    const auto& tokenSegment = segment(index);
+    return tokenSegment.source->location(offsets[index] - tokenSegment.baseOffset);
+}
+
+// A segment that continues the last one is left out, and one that starts at
+// the same token replaces it
+void TokenBuffer::pushSegment(Segment added)
+{
+    if (!segments.empty() && segments.back().source == added.source && segments.back().baseOffset == added.baseOffset)
+    {
+        return;
+    }
+    if (!segments.empty() && segments.back().firstToken == added.firstToken)
+    {
+        segments.back() = std::move(added);
+    }
+    else
+    {
+        segments.push_back(std::move(added));
+    }
+}
+
+const TokenBuffer::Segment& TokenBuffer::segment(size_t index) const
+{
+    if (segments.size() == 1)
+    {
+        return segments.front();
+    }
+
+    // The last segment that starts at or before the token
+    auto next = std::upper_bound(segments.begin(), segments.end(), index,
+                                 [](size_t i, const Segment& s) { return i < s.firstToken; });
+    return *(next - 1);
+}
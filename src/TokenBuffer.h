@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#ifndef INTERPRETER_TOKENBUFFER_H
+#define INTERPRETER_TOKENBUFFER_H
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include "SourceBuffer.h"
+#include "Token.h"
+
+// A sequence of tokens stored as parallel arrays of types, byte offsets into
+// the source, lengths and (for INT and IDENTIFIER tokens) values. Token objects are only
+// created on request. Offsets are 64 bits wide, so streamed input may go past
+// 4 GiB; a single token must be shorter than that.
+//
+// The source may be split into several buffers (segments), as when the input
+// is read in chunks. Offsets are counted from the start of the whole input;
+// each segment records the offset of its first byte.
+class TokenBuffer
+{
+public:
+    TokenBuffer();
+    explicit TokenBuffer(std::shared_ptr<const SourceBuffer> source);
+
+    void reserve(size_t count);
+
+    // Tokens added after this call are read from the given source
+    void addSource(std::shared_ptr<const SourceBuffer> source, size_t baseOffset);
+    const std::shared_ptr<const SourceBuffer>& lastSource() const;
+
+    // Throws std::length_error if the token is 4 GiB or longer
+    void add(Token::TokenType type, size_t offset, size_t length, int64_t value = 0);
+
+    // Add all tokens of the other buffer after the tokens of this buffer
+    void append(const TokenBuffer& other);
+
+    // A copy of the tokens from first up to end, with their sources
+    TokenBuffer slice(size_t first, size_t end) const;
+
+    // Replace count tokens from first with the tokens of the other buffer,
+    // which keep their sources, and move the tokens after them by delta bytes
+    void replace(size_t first, size_t count, const TokenBuffer& other, int64_t delta);
+    // Let all tokens refer to a single source that holds the whole input
+    void replaceSource(std::shared_ptr<const SourceBuffer> source);
+
+    // Drop the first count tokens, and the sources that only they were read
+    // from. The remaining tokens move to the front.
+    void discard(size_t count);
+
+    size_t size() const;
+
+    Token::TokenType type(size_t index) const;
+    size_t offset(size_t index) const;
+    uint32_t length(size_t index) const;
+    int64_t value(size_t index) const;
+    void setValue(size_t index, int64_t value);
+    std::string_view literal(size_t index) const;
+    Token token(size_t index) const;
+    const std::shared_ptr<const SourceBuffer>& source(size_t index) const;
+    // The offset of the first byte of the source of a token
+    size_t baseOffset(size_t index) const;
+    SourceBuffer::Location location(size_t index) const;
+
+private:
+    struct Segment
+    {
+        size_t firstToken;
+        size_t baseOffset;
+        std::shared_ptr<const SourceBuffer> source;
+    };
+
+    std::vector<uint8_t> types;
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> lengths;
+    std::vector<int64_t> values;
+    std::vector<Segment> segments;
+
+    const Segment& segment(size_t index) const;
+    void pushSegment(Segment added);
+};
+
+inline size_t TokenBuffer::size() const
+{
+    return types.size();
+}
+
+inline Token::TokenType TokenBuffer::type(size_t index) const
+{
+    return static_cast<Token::TokenType>(types[index]);
+}
+
+inline size_t TokenBuffer::offset(size_t index) const
+{
+    return offsets[index];
+}
+
+inline uint32_t TokenBuffer::length(size_t index) const
+{
+    return lengths[index];
+}
+
+inline int64_t TokenBuffer::value(size_t index) const
+{
+    return values[index];
+}
+
+inline void TokenBuffer::setValue(size_t index, int64_t value)
+{
+    values[index] = value;
+}
+
+#endif //INTERPRETER_TOKENBUFFER_H
@@ -6,25 +6,56 @@
  *
  */
 #include <iostream>
-#include <fstream>
+#include <system_error>
+#include <vector>
+#include "AstCache.h"
 #include "Lexer.h"
+#include "StreamingLexer.h"
 #include "Parser.h"
 #include "AstPrinter.h"
+#include "AstStats.h"
 #include "Evaluator.h"
+#include "StreamingEvaluator.h"
+#include "SyntaxChecker.h"
 
 class ArgumentParser
 {
 public:
-    ArgumentParser(int argc, char *argv[]) : _runREPL (false), _inputFileName ("")
+    ArgumentParser(int argc, char *argv[]) : _runREPL (true), _evaluate (false), _astStats (false), _check (false),
+                                             _lazy (false),
+                                             _inputFileName (""),
+                                             _cacheDirectory ("")
     {
-        if (argc > 1)
+        // Parse arguments
+        for (int i = 1; i < argc; ++i)
         {
-            // Parse arguments
-            _inputFileName = argv[1];
-        }
-        else
-        {
-            _runREPL = true;
+            std::string argument(argv[i]);
+            if (argument == "--cache" && i + 1 < argc)
+            {
+                _cacheDirectory = argv[++i];
+            }
+            else if (argument == "--eval")
+            {
+                _evaluate = true;
+            }
+            else if (argument == "--ast-stats")
+            {
+                _astStats = true;
+            }
+            else if (argument == "--check")
+            {
+                _check = true;
+            }
+            else if (argument == "--lazy")
+            {
+                _lazy = true;
+            }
+            else
+            {
+                _inputFileName = argument;
+                _inputFileNames.push_back(argument);
+                _runREPL = false;
+            }
         }
     }
 
@@ -33,14 +64,55 @@ public:
         return _runREPL;
     }
 
+    // Evaluate the program instead of printing it
+    bool evaluate() const
+    {
+        return _evaluate;
+    }
+
+    // Print the memory taken by the nodes instead of the program
+    bool astStats() const
+    {
+        return _astStats;
+    }
+
+    // Only check that the files parse
+    bool check() const
+    {
+        return _check;
+    }
+
+    // Parse function bodies when they are needed
+    bool lazy() const
+    {
+        return _lazy;
+    }
+
     std::string inputFileName()
     {
         return _inputFileName;
     }
 
+    const std::vector<std::string>& inputFileNames() const
+    {
+        return _inputFileNames;
+    }
+
+    // Empty if no cache is used
+    std::string cacheDirectory()
+    {
+        return _cacheDirectory;
+    }
+
 private:
     bool _runREPL;
+    bool _evaluate;
+    bool _astStats;
+    bool _check;
+    bool _lazy;
     std::string _inputFileName;
+    std::vector<std::string> _inputFileNames;
+    std::string _cacheDirectory;
 };
 
 void runREPL()
@@ -59,12 +131,9 @@ void runREPL()
             auto evaluator = Evaluator();
 
 
-            if (!parser.errors.empty())
+            for (const auto &error : parser.diagnostics())
             {
-                for (const auto &error : parser.errors)
-                {
-                    std::cout << error << std::endl;
-                }
+                std::cout << error << std::endl;
             }
 
             auto evaluated = evaluator.eval(program);
@@ -78,36 +147,174 @@ void runREPL()
     std::cout << std::endl;
 }
 
-void printProgramFromFile(const std::basic_string<char>& filename)
+std::unique_ptr<Lexer> openLexer(const std::string& filename, std::shared_ptr<SourceBuffer>& source)
 {
-    std::fstream fs;
-    std::vector<char> input;
-    fs.open(filename, std::fstream::in);
-    char c;
-    while (fs.get(c))
+    if (filename == "-")
+    {
+        return std::make_unique<StreamingLexer>(StreamingLexer::fileDescriptorReader(0));
+    }
+    try
+    {
+        source = SourceBuffer::fromFile(filename);
+    }
+    catch (std::system_error& error)
     {
-        input.push_back(c);
+        std::cerr << "Cannot read " << error.what() << std::endl;
+        return nullptr;
     }
-    fs.close();
+    return std::make_unique<Lexer>(source);
+}
 
-    auto l = Lexer(&input[0]);
-    auto parser = Parser(l);
-    auto program = parser.parseProgram();
+// The file name "-" reads the program from standard input as it arrives. With
+// a cache directory, programs of files without errors are kept there and
+// read back instead of being parsed again. Lazy function bodies are parsed
+// as they are printed, and their errors are printed after the program.
+bool printProgramFromFile(const std::basic_string<char>& filename, const std::string& cacheDirectory, bool lazy)
+{
+    std::shared_ptr<SourceBuffer> source;
+    auto l = openLexer(filename, source);
+    if (l == nullptr)
+    {
+        return false;
+    }
+
+    auto cache = AstCache(cacheDirectory);
+    std::shared_ptr<Program> program;
+    if (source != nullptr && !cacheDirectory.empty())
+    {
+        program = cache.load(*source);
+    }
+    bool store = false;
+    if (program == nullptr)
+    {
+        // A file is read in full, so its statements can be parsed on several threads
+        auto parser = Parser(*l);
+        parser.setLazyFunctionBodies(lazy);
+        program = source == nullptr ? parser.parseProgram() : parser.parseProgramInParallel();
+        for (const auto &error : parser.diagnostics())
+        {
+            std::cerr << filename << ":" << error << std::endl;
+        }
+        store = source != nullptr && !cacheDirectory.empty() && parser.errors.empty();
+    }
     auto printer = AstPrinter();
     std::cout << printer.printCode(program) << std::endl;
+    for (const auto &error : program->bodyDiagnostics)
+    {
+        std::cerr << filename << ":" << error << std::endl;
+    }
+    if (store && program->bodyDiagnostics.empty())
+    {
+        cache.store(*source, *program);
+    }
+    return true;
+}
+
+// Evaluate the statements one by one as they are parsed, and print their
+// values and errors as they come
+bool evaluateProgramFromFile(const std::string& filename, bool lazy)
+{
+    std::shared_ptr<SourceBuffer> source;
+    auto l = openLexer(filename, source);
+    if (l == nullptr)
+    {
+        return false;
+    }
+
+    auto parser = Parser(*l);
+    parser.setLazyFunctionBodies(lazy);
+    auto evaluator = StreamingEvaluator(parser);
+    size_t errorsPrinted = 0;
+    bool more = true;
+    while (more)
+    {
+        more = evaluator.step();
+        for (; errorsPrinted < parser.errors.size(); ++errorsPrinted)
+        {
+            std::cerr << filename << ":" << parser.diagnostic(errorsPrinted) << std::endl;
+        }
+        if (evaluator.result() != nullptr)
+        {
+            std::cout << evaluator.result()->inspect() << std::endl;
+        }
+    }
+    return true;
+}
+
+// Parse the program and print the number and size of its nodes by kind
+bool printAstStatsFromFile(const std::string& filename, bool lazy)
+{
+    std::shared_ptr<SourceBuffer> source;
+    auto l = openLexer(filename, source);
+    if (l == nullptr)
+    {
+        return false;
+    }
+
+    auto parser = Parser(*l);
+    parser.setLazyFunctionBodies(lazy);
+    auto program = parser.parseProgram();
+    for (const auto &error : parser.diagnostics())
+    {
+        std::cerr << filename << ":" << error << std::endl;
+    }
+    std::cout << AstStats(*program).report();
+    return true;
+}
+
+// Check that the files parse, several at a time, and print the errors in the
+// order of the files. Returns false if any file has errors or cannot be read.
+bool checkFiles(const std::vector<std::string>& filenames)
+{
+    bool passed = true;
+    for (const auto& result : SyntaxChecker::check(filenames))
+    {
+        for (const auto& error : result.diagnostics)
+        {
+            if (result.readable)
+            {
+                std::cerr << result.filename << ":" << error << std::endl;
+            }
+            else
+            {
+                std::cerr << error << std::endl;
+            }
+        }
+        passed = passed && result.passed();
+    }
+    return passed;
 }
 
 int main(int argc, char *argv[])
 {
     ArgumentParser config(argc, argv);
+    if (config.check())
+    {
+        return checkFiles(config.inputFileNames()) ? 0 : 1;
+    }
     if (config.runREPL())
     {
         runREPL();
+        return 0;
+    }
+
+    // A program streamed on standard input may fail to be read part way
+    try
+    {
+        if (config.astStats())
+        {
+            return printAstStatsFromFile(config.inputFileName(), config.lazy()) ? 0 : 1;
+        }
+        else if (config.evaluate())
+        {
+            return evaluateProgramFromFile(config.inputFileName(), config.lazy()) ? 0 : 1;
+        }
+        return printProgramFromFile(config.inputFileName(), config.cacheDirectory(), config.lazy()) ? 0 : 1;
     }
-    else
+    catch (std::system_error& error)
     {
-        printProgramFromFile(config.inputFileName());
+        std::cerr << "Cannot read " << config.inputFileName() << ": " << error.code().message() << std::endl;
+        return 1;
     }
-    return 0;
 }
 
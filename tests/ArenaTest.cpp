@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include <cstdint>
+#include <string>
+#include "Arena.h"
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+TEST_GROUP(ArenaTest)
+{
+    void setup() override {}
+    void teardown() override {}
+};
+
+struct Counted
+{
+    explicit Counted(int& destroyed) : destroyed(destroyed) {}
+    ~Counted() { ++destroyed; }
+    int& destroyed;
+};
+
+TEST(ArenaTest, objectsAreAligned)
+{
+    Arena arena;
+    arena.create<char>('x');
+    auto value = arena.create<int64_t>(42);
+    arena.allocate(1, 1);
+    auto aligned = arena.allocate(64, 64);
+    CHECK_EQUAL(42, *value);
+    CHECK_EQUAL(0u, reinterpret_cast<uintptr_t>(value) % alignof(int64_t));
+    CHECK_EQUAL(0u, reinterpret_cast<uintptr_t>(aligned) % 64);
+}
+
+TEST(ArenaTest, destructorsRun)
+{
+    int destroyed = 0;
+    {
+        Arena arena;
+        arena.create<Counted>(destroyed);
+        arena.create<Counted>(destroyed);
+        arena.createWithoutDestructor<Counted>(destroyed);
+        arena.create<std::string>(100, 'x');
+    }
+    CHECK_EQUAL(2, destroyed);
+}
+
+TEST(ArenaTest, fewBlocks)
+{
+    Arena arena;
+    for (int i = 0; i < 1000000; ++i)
+    {
+        arena.create<int64_t>(i);
+    }
+    CHECK(arena.bytesAllocated() >= 8000000);
+    CHECK(arena.blockCount() <= 10);
+}
+
+TEST(ArenaTest, largeAllocation)
+{
+    Arena arena;
+    arena.create<char>('x');
+    auto large = static_cast<char*>(arena.allocate(64 << 20, 1));
+    large[(64 << 20) - 1] = 'y';
+    auto small = arena.create<char>('z');
+    CHECK_EQUAL('z', *small);
+}
+
+TEST(ArenaTest, copyArray)
+{
+    Arena arena;
+    int values[] = {1, 2, 3};
+    auto copy = arena.copyArray(values, 3);
+    values[0] = 0;
+    CHECK_EQUAL(1, copy[0]);
+    CHECK_EQUAL(3, copy[2]);
+    POINTERS_EQUAL(nullptr, arena.copyArray(values, 0));
+}
+
+TEST(ArenaTest, adopt)
+{
+    int destroyed = 0;
+    {
+        Arena arena;
+        arena.create<Counted>(destroyed);
+        auto value = arena.create<int64_t>(42);
+        {
+            Arena other;
+            other.create<Counted>(destroyed);
+            auto otherValue = other.create<int64_t>(7);
+            auto allocated = arena.bytesAllocated() + other.bytesAllocated();
+
+            arena.adopt(other);
+            CHECK_EQUAL(2u, arena.blockCount());
+            CHECK_EQUAL(allocated, arena.bytesAllocated());
+            CHECK_EQUAL(0u, other.blockCount());
+            CHECK_EQUAL(7, *otherValue);
+            other.create<int64_t>(1);
+        }
+        CHECK_EQUAL(0, destroyed);
+        CHECK_EQUAL(42, *value);
+    }
+    CHECK_EQUAL(2, destroyed);
+}
+
+int main(int ac, char** av)
+{
+    return CommandLineTestRunner::RunAllTests(ac, av);
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include "AstCache.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+TEST_GROUP(AstCacheTest)
+{
+    std::string directory;
+
+    void setup() override
+    {
+        char name[] = "/tmp/ast_cache_test_XXXXXX";
+        directory = std::string(mkdtemp(name)) + "/cache";
+    }
+
+    void teardown() override
+    {
+        std::filesystem::remove_all(std::filesystem::path(directory).parent_path());
+    }
+
+    static std::shared_ptr<Program> parse(const SourceBuffer& source)
+    {
+        Lexer lexer(source.data());
+        Parser parser(lexer);
+        return parser.parseProgram();
+    }
+};
+
+TEST(AstCacheTest, storeAndLoad)
+{
+    SourceBuffer source("let add = fn(x, y) { x + y; }; add(1, 2);");
+    AstCache cache(directory);
+    CHECK(cache.load(source) == nullptr);
+
+    auto program = parse(source);
+    CHECK(cache.store(source, *program));
+    CHECK(std::filesystem::exists(cache.path(source)));
+
+    auto loaded = cache.load(source);
+    CHECK(loaded != nullptr);
+    CHECK_EQUAL(program->string(), loaded->string());
+}
+
+TEST(AstCacheTest, otherSourceIsNotFound)
+{
+    SourceBuffer source("let a = 1;");
+    SourceBuffer edited("let a = 2;");
+    AstCache cache(directory);
+    CHECK(cache.store(source, *parse(source)));
+    CHECK(cache.path(source) != cache.path(edited));
+    CHECK(cache.load(edited) == nullptr);
+}
+
+TEST(AstCacheTest, fileOfOtherSourceIsNotUsed)
+{
+    // A file of another source under the name of this one, as if their
+    // names had collided
+    SourceBuffer source("let a = 1;");
+    SourceBuffer other("let b = 2;");
+    AstCache cache(directory);
+    CHECK(cache.store(other, *parse(other)));
+    std::filesystem::create_directories(directory);
+    std::filesystem::copy_file(cache.path(other), cache.path(source));
+    CHECK(cache.load(source) == nullptr);
+    CHECK(cache.load(other) != nullptr);
+}
+
+TEST(AstCacheTest, damagedFileIsNotUsed)
+{
+    SourceBuffer source("let a = fn(x) { x * 2 };");
+    AstCache cache(directory);
+    CHECK(cache.store(source, *parse(source)));
+    std::ofstream(cache.path(source), std::ios::binary | std::ios::trunc) << "MAST and nothing else";
+    CHECK(cache.load(source) == nullptr);
+
+    // The header is right, but the program is cut short
+    CHECK(cache.store(source, *parse(source)));
+    std::filesystem::resize_file(cache.path(source), std::filesystem::file_size(cache.path(source)) / 2);
+    CHECK(cache.load(source) == nullptr);
+}
+
+TEST(AstCacheTest, unwritableDirectory)
+{
+    SourceBuffer source("1;");
+    AstCache cache("/proc/ast_cache");
+    CHECK_FALSE(cache.store(source, *parse(source)));
+    CHECK(cache.load(source) == nullptr);
+}
+
+int main(int ac, char** av)
+{
+    return CommandLineTestRunner::RunAllTests(ac, av);
+}
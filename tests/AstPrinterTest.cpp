@@ -17,10 +17,11 @@ TEST_GROUP(PrinterTest)
     void setup() override {}
     void teardown() override {}
 
-    static std::shared_ptr<Node> parseProgram(const char* input)
+    static std::shared_ptr<Node> parseProgram(const char* input, bool lazy = false)
     {
         auto l = Lexer(input);
         auto parser = Parser(l);
+        parser.setLazyFunctionBodies(lazy);
         auto program = parser.parseProgram();
         CHECK_EQUAL_TEXT(0, parser.errors.size(), parser.errors[0].c_str());
         return program;
@@ -153,6 +154,12 @@ TEST(PrinterTest, printFunctionCallWithParameters)
                 printProgram("foo(5, x, 4-y);"));
 }
 
+TEST(PrinterTest, printLazyFunctionBodies)
+{
+    const char* input = "let f = fn(x) { if (x) { fn(y) { y * x } } else { f(!x) } };";
+    CHECK_EQUAL(AstPrinter().printCode(parseProgram(input)), AstPrinter().printCode(parseProgram(input, true)));
+}
+
 int main(int ac, char** av)
 {
     return CommandLineTestRunner::RunAllTests(ac, av);
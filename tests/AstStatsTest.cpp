@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include "AstStats.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+TEST_GROUP(AstStatsTest)
+{
+    void setup() override {}
+    void teardown() override {}
+
+    static std::shared_ptr<Program> parseProgram(const char* input, bool lazy = false)
+    {
+        auto l = Lexer(input);
+        auto parser = Parser(l);
+        parser.setLazyFunctionBodies(lazy);
+        auto program = parser.parseProgram();
+        CHECK_EQUAL_TEXT(0, parser.errors.size(), parser.errors[0].c_str());
+        return program;
+    }
+};
+
+TEST(AstStatsTest, countsNodesByKind)
+{
+    auto program = parseProgram("let f = fn(x, y) { if (x < y) { -x } else { y } };\nf(1, true);\nreturn 2;");
+    AstStats stats(*program);
+    CHECK_EQUAL(8, stats.nodeCount(AstStats::IDENTIFIER));
+    CHECK_EQUAL(2, stats.nodeCount(AstStats::INTEGER));
+    CHECK_EQUAL(1, stats.nodeCount(AstStats::BOOLEAN));
+    CHECK_EQUAL(1, stats.nodeCount(AstStats::FUNCTION));
+    CHECK_EQUAL(1, stats.nodeCount(AstStats::CALL));
+    CHECK_EQUAL(1, stats.nodeCount(AstStats::PREFIX));
+    CHECK_EQUAL(1, stats.nodeCount(AstStats::INFIX));
+    CHECK_EQUAL(1, stats.nodeCount(AstStats::IF));
+    CHECK_EQUAL(1, stats.nodeCount(AstStats::LET));
+    CHECK_EQUAL(1, stats.nodeCount(AstStats::RETURN));
+    CHECK_EQUAL(4, stats.nodeCount(AstStats::EXPRESSION_STATEMENT));
+    CHECK_EQUAL(3, stats.nodeCount(AstStats::BLOCK));
+    CHECK_EQUAL(25, stats.nodeCount());
+}
+
+TEST(AstStatsTest, bytesAddUp)
+{
+    auto program = parseProgram("let add = fn(a, b) { a + b };\nadd(1, 2 * 3);");
+    AstStats stats(*program);
+    CHECK_EQUAL(2 * sizeof(InfixExpression), stats.nodeBytes(AstStats::INFIX));
+    // Two parameters, two arguments and the statement of the body
+    CHECK_EQUAL(5 * sizeof(Node*), stats.listBytes());
+
+    // Nodes and lists are all in the arena, which adds only alignment
+    CHECK(stats.nodeBytes() + stats.listBytes() <= stats.arenaBytesUsed());
+    CHECK(stats.arenaBytesUsed() <= stats.nodeBytes() + stats.listBytes() + 8 * stats.nodeCount());
+    CHECK(stats.arenaBytesUsed() <= stats.arenaBytesAllocated());
+}
+
+TEST(AstStatsTest, compactNodes)
+{
+    // The one-byte operator takes a word after the vtable pointer, and
+    // statements have nothing but their children
+    CHECK(sizeof(InfixExpression) <= 4 * sizeof(void*));
+    CHECK(sizeof(PrefixExpression) <= 3 * sizeof(void*));
+    CHECK(sizeof(Identifier) <= 4 * sizeof(void*));
+    CHECK(sizeof(LetStatement) <= 3 * sizeof(void*));
+    CHECK(sizeof(ExpressionStatement) <= 2 * sizeof(void*));
+    CHECK(sizeof(CallExpression) <= 4 * sizeof(void*));
+}
+
+TEST(AstStatsTest, lazyBodiesAreNotParsed)
+{
+    auto program = parseProgram("let f = fn(x, y) { if (x < y) { -x } else { y } };\nf(1, true);", true);
+    AstStats stats(*program);
+    CHECK_EQUAL(1, stats.nodeCount(AstStats::FUNCTION));
+    CHECK_EQUAL(1, stats.nodeCount(AstStats::LAZY_BODY));
+    CHECK_EQUAL(0, stats.nodeCount(AstStats::IF));
+    CHECK_EQUAL(0, stats.nodeCount(AstStats::BLOCK));
+
+    auto function = dynamic_cast<Function*>(dynamic_cast<LetStatement*>(program->statements[0])->expression);
+    function->getBody();
+    AstStats parsed(*program);
+    CHECK_EQUAL(0, parsed.nodeCount(AstStats::LAZY_BODY));
+    CHECK_EQUAL(1, parsed.nodeCount(AstStats::IF));
+    CHECK_EQUAL(3, parsed.nodeCount(AstStats::BLOCK));
+}
+
+TEST(AstStatsTest, report)
+{
+    auto program = parseProgram("1 + 2;");
+    auto report = AstStats(*program).report();
+    CHECK(report.find("infix") != std::string::npos);
+    CHECK(report.find("arena used") != std::string::npos);
+}
+
+int main(int ac, char** av)
+{
+    return CommandLineTestRunner::RunAllTests(ac, av);
+}
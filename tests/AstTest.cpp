@@ -7,6 +7,7 @@
  */
 
 #include "Ast.h"
+#include "SourceBuffer.h"
 #include "Token.h"
 #include "CppUTest/TestHarness.h"
 #include "CppUTest/CommandLineTestRunner.h"
@@ -16,28 +17,21 @@ TEST_GROUP(AstTest)
     void setup() override {}
     void teardown() override {}
 
-    std::shared_ptr<Expression> createInfixLtExpression(const std::string& left, const std::string& right)
+    // The program owns the nodes of each test
+    Program program;
+
+    Expression* createInfixLtExpression(const char* left, const char* right)
     {
-        std::unique_ptr<Token> ltToken = std::make_unique<Token>("<");
-        std::unique_ptr<Token> leftInteger = std::make_unique<Token>(Token::INT, left);
-        std::unique_ptr<Token> rightInteger = std::make_unique<Token>(Token::INT, right);
-        std::shared_ptr<InfixExpression> expression = std::make_shared<InfixExpression>(std::move(ltToken));
-        std::shared_ptr<Integer> leftExp = std::make_shared<Integer>(std::move(leftInteger));
-        leftExp->value = std::stoi(left);
-        std::shared_ptr<Integer> rightExp = std::make_shared<Integer>(std::move(rightInteger));
-        rightExp->value = std::stoi(right);
-        expression->left = leftExp;
-        expression->right = rightExp;
-        expression->op = "<";
+        auto expression = program.create<InfixExpression>(Token::LT);
+        expression->left = program.create<Integer>(std::stoi(left));
+        expression->right = program.create<Integer>(std::stoi(right));
         return expression;
     }
 
-    std::shared_ptr<Statement> createIdentifierStatement(const std::string& identifier)
+    Statement* createIdentifierStatement(const char* identifier)
     {
-        std::unique_ptr<Token> idToken = std::make_unique<Token>(Token::IDENTIFIER, identifier);
-        std::shared_ptr<Identifier> expression = std::make_shared<Identifier>(std::move(idToken));
-        expression->value = std::make_shared<std::string>(identifier);
-        std::shared_ptr<ExpressionStatement> statement = std::make_shared<ExpressionStatement>();
+        auto expression = program.create<Identifier>(identifier, 0);
+        auto statement = program.create<ExpressionStatement>();
         statement->expression = expression;
         return statement;
     }
@@ -45,53 +39,151 @@ TEST_GROUP(AstTest)
 
 TEST(AstTest, testLetStatementString)
 {
-    std::unique_ptr<Token> identToken = std::make_unique<Token>("x");
-    std::shared_ptr<Identifier> identifer = std::make_shared<Identifier>(std::move(identToken));
-    std::unique_ptr<Token> letToken = std::make_unique<Token>("let");
-    LetStatement statement(std::move(letToken));
-    statement.identifier = identifer;
+    auto identifier = program.create<Identifier>("x", 0);
+    LetStatement statement;
+    statement.identifier = identifier;
     CHECK_EQUAL("let x = ;", statement.string());
 }
 
 TEST(AstTest, testReturnStatementString)
 {
-    std::unique_ptr<Token> returnToken = std::make_unique<Token>("return");
-    ReturnStatement statement(std::move(returnToken));
+    ReturnStatement statement;
     CHECK_EQUAL("return ;", statement.string());
 }
 
 TEST(AstTest, testIntegerString)
 {
-    std::unique_ptr<Token> token = std::make_unique<Token>("15");
-    Integer integer(std::move(token));
-    integer.value = 15;
+    Integer integer(15);
     CHECK_EQUAL("15", integer.string());
 }
 
 TEST(AstTest, testBooleanTrueString)
 {
-    std::unique_ptr<Token> token = std::make_unique<Token>("true");
-    Boolean boolean(std::move(token), true);
+    Boolean boolean(true);
     CHECK_EQUAL("true", boolean.string());
 }
 
 TEST(AstTest, testBooleanFalseString)
 {
-    std::unique_ptr<Token> token = std::make_unique<Token>("false");
-    Boolean boolean(std::move(token), false);
+    Boolean boolean(false);
     CHECK_EQUAL("false", boolean.string());
 }
 
 TEST(AstTest, testIfStatementString)
 {
-    std::unique_ptr<Token> ifToken = std::make_unique<Token>("if");
-    IfExpression expression(std::move(ifToken));
+    IfExpression expression;
     expression.condition = createInfixLtExpression("5", "10");
     expression.consequence = createIdentifierStatement("x");
     expression.alternative = createIdentifierStatement("y");
     CHECK_EQUAL("if (5 < 10) { x } else { y }\n", expression.string());
 }
 
+TEST(AstTest, testProgramKeepsSources)
+{
+    auto source = std::make_shared<const SourceBuffer>("x");
+    program.keepSource(source);
+    auto identifier = program.create<Identifier>(source->text().substr(0, 1), 0);
+    program.keepSource(source);
+    source.reset();
+
+    // Only the first node of a source adds it
+    LONGS_EQUAL(1, program.sources.size());
+    CHECK_EQUAL("x", identifier->string());
+}
+
+TEST(AstTest, testOperatorsKeepTheirLiterals)
+{
+    auto prefix = program.create<PrefixExpression>(Token::BANG);
+    prefix->right = program.create<Boolean>(true);
+    CHECK_EQUAL("(!true)", prefix->string());
+
+    auto infix = program.create<InfixExpression>(Token::NEQ);
+    infix->left = program.create<Integer>(1);
+    infix->right = program.create<Integer>(2);
+    CHECK_EQUAL("(1 != 2)", infix->string());
+    LONGS_EQUAL(Token::NEQ, infix->op);
+}
+
+TEST(AstTest, testCompactKeepsTreeAndUsedSources)
+{
+    auto first = std::make_shared<const SourceBuffer>("a");
+    auto second = std::make_shared<const SourceBuffer>("f x");
+    program.keepSource(first);
+    program.addStatement(createIdentifierStatement(first->text().data()));
+
+    // let f = fn(x) { if (x < 1) { !f(x) } else { -2 } };
+    program.keepSource(second);
+    auto f = [&]() { return program.create<Identifier>(second->text().substr(0, 1), 1); };
+    auto x = [&]() { return program.create<Identifier>(second->text().substr(2, 1), 2); };
+    auto call = program.create<CallExpression>();
+    call->function = f();
+    Expression* arguments[] = {x()};
+    call->arguments = NodeList<Expression>(program.arena.copyArray(arguments, 1), 1);
+    auto negation = program.create<PrefixExpression>(Token::BANG);
+    negation->right = call;
+    auto consequence = program.create<ExpressionStatement>();
+    consequence->expression = negation;
+    auto minus = program.create<PrefixExpression>(Token::MINUS);
+    minus->right = program.create<Integer>(2);
+    auto alternative = program.create<ExpressionStatement>();
+    alternative->expression = minus;
+    auto condition = program.create<InfixExpression>(Token::LT);
+    condition->left = x();
+    condition->right = program.create<Integer>(1);
+    auto ifExpression = program.create<IfExpression>();
+    ifExpression->condition = condition;
+    ifExpression->consequence = consequence;
+    ifExpression->alternative = alternative;
+    auto body = program.create<ExpressionStatement>();
+    body->expression = ifExpression;
+    auto function = program.create<Function>();
+    Identifier* parameters[] = {x()};
+    function->parameters = NodeList<Identifier>(program.arena.copyArray(parameters, 1), 1);
+    function->body = body;
+    auto let = program.create<LetStatement>();
+    let->identifier = f();
+    let->expression = function;
+    program.addStatement(let);
+
+    // A function whose body is still lazy
+    auto lazy = program.create<Function>();
+    lazy->lazyBody = program.arena.create<LazyBody>();
+    *lazy->lazyBody = {&program, second.get(), nullptr, 0, 0, [](const LazyBody& body)
+    {
+        auto statement = body.program->create<ExpressionStatement>();
+        statement->expression = body.program->create<Boolean>(true);
+        return static_cast<Statement*>(statement);
+    }};
+    program.lazyBodies.push_back(lazy->lazyBody);
+    auto lazyStatement = program.create<ExpressionStatement>();
+    lazyStatement->expression = lazy;
+    program.addStatement(lazyStatement);
+
+    // Replace the statement that uses the first source
+    Program other;
+    other.addStatement(other.create<ReturnStatement>());
+    program.splice(0, 1, other);
+    LONGS_EQUAL(2, program.sources.size());
+    auto expected = program.statements[1]->string();
+    auto used = program.arena.bytesUsed();
+    first.reset();
+    second.reset();
+
+    program.compact();
+    CHECK(program.statements[1] != let);
+    CHECK(program.arena.bytesUsed() < used);
+    LONGS_EQUAL(1, program.sources.size());
+    CHECK_EQUAL("f x", std::string(program.sources[0]->text()));
+    CHECK_EQUAL(expected, program.statements[1]->string());
+    CHECK_EQUAL("return ;", program.statements[0]->string());
+
+    LONGS_EQUAL(1, program.lazyBodies.size());
+    CHECK(program.lazyBodies[0]->program == &program);
+    auto compactedLazy = static_cast<Function*>(static_cast<ExpressionStatement*>(program.statements[2])->expression);
+    CHECK(compactedLazy->lazyBody == program.lazyBodies[0]);
+    CHECK_EQUAL("fn() { true }", compactedLazy->string());
+}
+
 int main(int ac, char** av)
 {
     return CommandLineTestRunner::RunAllTests(ac, av);
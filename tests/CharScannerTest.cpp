@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+#include <CharScanner.h>
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+TEST_GROUP(CharScannerTest)
+{
+    CharScanner::Implementation original;
+
+    void setup() override
+    {
+        original = CharScanner::getImplementation();
+    }
+
+    void teardown() override
+    {
+        CharScanner::setImplementation(original);
+    }
+
+    typedef const char* (*ScanFunction)(const char*);
+
+    // Place a run of the given character at every offset within a 64 byte
+    // aligned block and with all lengths up to 80, followed by the stop
+    // character, and check that the scan ends on the stop character.
+    static void checkRuns(ScanFunction scan, char runChar, char stopChar)
+    {
+        for (auto implementation : {CharScanner::SCALAR, CharScanner::SSE2, CharScanner::AVX2})
+        {
+            if (!CharScanner::isSupported(implementation))
+            {
+                continue;
+            }
+            CharScanner::setImplementation(implementation);
+
+            for (size_t offset = 0; offset < 64; ++offset)
+            {
+                for (size_t length = 0; length <= 80; ++length)
+                {
+                    alignas(64) char buffer[256] = {};
+                    std::fill(buffer + offset, buffer + offset + length, runChar);
+                    buffer[offset + length] = stopChar;
+                    CHECK_EQUAL(buffer + offset + length, scan(buffer + offset));
+                }
+            }
+        }
+    }
+};
+
+TEST(CharScannerTest, skipWhiteSpace)
+{
+    checkRuns(&CharScanner::skipWhiteSpace, ' ', 'x');
+    checkRuns(&CharScanner::skipWhiteSpace, '\t', ';');
+    checkRuns(&CharScanner::skipWhiteSpace, '\n', '\0');
+    checkRuns(&CharScanner::skipWhiteSpace, '\r', '\v');
+}
+
+TEST(CharScannerTest, skipLetters)
+{
+    checkRuns(&CharScanner::skipLetters, 'a', ' ');
+    checkRuns(&CharScanner::skipLetters, 'Z', '1');
+    checkRuns(&CharScanner::skipLetters, '_', '[');
+    checkRuns(&CharScanner::skipLetters, 'z', '{');
+    checkRuns(&CharScanner::skipLetters, 'A', '@');
+    checkRuns(&CharScanner::skipLetters, 'q', '\xe1');
+}
+
+TEST(CharScannerTest, skipDigits)
+{
+    checkRuns(&CharScanner::skipDigits, '0', '/');
+    checkRuns(&CharScanner::skipDigits, '9', ':');
+    checkRuns(&CharScanner::skipDigits, '5', '\0');
+}
+
+TEST(CharScannerTest, mixedCharacters)
+{
+    const char* input = "  \t\r\n  abc_XYZ12345  ";
+    CHECK_EQUAL(input + 7, CharScanner::skipWhiteSpace(input));
+    CHECK_EQUAL(input + 14, CharScanner::skipLetters(input + 7));
+    CHECK_EQUAL(input + 19, CharScanner::skipDigits(input + 14));
+    CHECK_EQUAL(input + 21, CharScanner::skipWhiteSpace(input + 19));
+}
+
+// The input fills a page between two pages that cannot be read, so a scan that
+// reads across a page boundary faults
+TEST(CharScannerTest, runsAtPageBoundaries)
+{
+    auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    auto pages = static_cast<char*>(mmap(nullptr, 3 * pageSize, PROT_READ | PROT_WRITE,
+                                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    CHECK(pages != MAP_FAILED);
+    CHECK_EQUAL(0, mprotect(pages, pageSize, PROT_NONE));
+    CHECK_EQUAL(0, mprotect(pages + 2 * pageSize, pageSize, PROT_NONE));
+    auto page = pages + pageSize;
+
+    for (auto implementation : {CharScanner::SCALAR, CharScanner::SSE2, CharScanner::AVX2})
+    {
+        if (!CharScanner::isSupported(implementation))
+        {
+            continue;
+        }
+        CharScanner::setImplementation(implementation);
+        for (size_t length = 0; length < 80; ++length)
+        {
+            // A run at the start of the page
+            std::memset(page, 'a', length);
+            page[length] = '\0';
+            CHECK_EQUAL(page + length, CharScanner::skipLetters(page));
+
+            // A run whose terminating zero is the last byte of the page
+            auto end = page + pageSize - 1;
+            std::memset(end - length, ' ', length);
+            *end = '\0';
+            CHECK_EQUAL(end, CharScanner::skipWhiteSpace(end - length));
+        }
+    }
+    munmap(pages, 3 * pageSize);
+}
+
+// Inputs on the heap of any size, which AddressSanitizer checks byte for byte
+TEST(CharScannerTest, runsInHeapBuffers)
+{
+    for (auto implementation : {CharScanner::SCALAR, CharScanner::SSE2, CharScanner::AVX2})
+    {
+        if (!CharScanner::isSupported(implementation))
+        {
+            continue;
+        }
+        CharScanner::setImplementation(implementation);
+        for (size_t length = 0; length < 80; ++length)
+        {
+            std::unique_ptr<char[]> buffer(new char[length + 1]);
+            std::memset(buffer.get(), '7', length);
+            buffer[length] = '\0';
+            CHECK_EQUAL(buffer.get() + length, CharScanner::skipDigits(buffer.get()));
+        }
+    }
+}
+
+TEST(CharScannerTest, parseDecimal)
+{
+    std::vector<std::pair<std::string, int64_t>> tests
+    {
+        {"0", 0},
+        {"7", 7},
+        {"1234567", 1234567},
+        {"12345678", 12345678},
+        {"123456789", 123456789},
+        {"0000000000000042", 42},
+        {"9876543210987654", 9876543210987654},
+        {"9223372036854775807", INT64_MAX},
+    };
+
+    for (const auto& test : tests)
+    {
+        int64_t value = -1;
+        CHECK_TRUE(CharScanner::parseDecimal(test.first.data(), test.first.data() + test.first.size(), value));
+        CHECK_EQUAL(test.second, value);
+    }
+}
+
+TEST(CharScannerTest, parseDecimalOutOfRange)
+{
+    for (std::string digits : {"9223372036854775808", "18446744073709551616", "99999999999999999999999999"})
+    {
+        int64_t value = 0;
+        CHECK_FALSE(CharScanner::parseDecimal(digits.data(), digits.data() + digits.size(), value));
+    }
+}
+
+int main(int ac, char** av)
+{
+    return CommandLineTestRunner::RunAllTests(ac, av);
+}
@@ -268,6 +268,17 @@ TEST(EvalTest, innermostValueReturnedInNestedBlocks)
     }
 }
 
+TEST(EvalTest, returnEndsProgram)
+{
+    auto evaluator = Evaluator();
+    CHECK_EQUAL(std::string("1"), evaluator.eval(parseProgram("1;"))->inspect());
+    CHECK_FALSE(evaluator.hasReturned());
+
+    auto other = Evaluator();
+    CHECK_EQUAL(std::string("2"), other.eval(parseProgram("if (true) { return 2; } 3;"))->inspect());
+    CHECK(other.hasReturned());
+}
+
 int main(int ac, char** av)
 {
     return CommandLineTestRunner::RunAllTests(ac, av);
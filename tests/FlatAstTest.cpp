@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include <string>
+#include "FlatAst.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+TEST_GROUP(FlatAstTest)
+{
+    void setup() override {}
+    void teardown() override {}
+
+    static std::shared_ptr<Program> parse(const std::string& input)
+    {
+        Lexer lexer(input.c_str());
+        Parser parser(lexer);
+        return parser.parseProgram();
+    }
+};
+
+TEST(FlatAstTest, emptyProgram)
+{
+    auto program = parse("");
+    FlatAst ast(*program);
+    LONGS_EQUAL(0, ast.size());
+    CHECK(ast.getStatements().empty());
+}
+
+TEST(FlatAstTest, sameString)
+{
+    auto program = parse("let add = fn(x, y) { return x + y; };\n"
+                         "add(1, -2 * 3);\n"
+                         "if (a < b) { true } else { !false };\n"
+                         "let f = fn() { if (x == 1) { 2 } };\n"
+                         "g();\n");
+    FlatAst ast(*program);
+    CHECK_EQUAL(program->string(), ast.string());
+}
+
+TEST(FlatAstTest, nodesInWalkOrder)
+{
+    auto program = parse("let x = 1 + y;");
+    FlatAst ast(*program);
+    LONGS_EQUAL(5, ast.size());
+
+    auto let = ast.getStatements()[0];
+    LONGS_EQUAL(0, let);
+    LONGS_EQUAL(FlatAst::LET, ast.kind(let));
+    LONGS_EQUAL(1, ast.first(let));
+    LONGS_EQUAL(2, ast.second(let));
+    CHECK_EQUAL("x", std::string(ast.name(1)));
+
+    LONGS_EQUAL(FlatAst::INFIX, ast.kind(2));
+    LONGS_EQUAL(Token::PLUS, ast.op(2));
+    LONGS_EQUAL(FlatAst::INTEGER, ast.kind(ast.first(2)));
+    LONGS_EQUAL(1, ast.integer(ast.first(2)));
+    CHECK_EQUAL("y", std::string(ast.name(ast.second(2))));
+}
+
+TEST(FlatAstTest, lists)
+{
+    auto program = parse("f(1, true, g(2));");
+    FlatAst ast(*program);
+    auto call = ast.first(ast.getStatements()[0]);
+    LONGS_EQUAL(FlatAst::CALL, ast.kind(call));
+    auto arguments = ast.children(call);
+    LONGS_EQUAL(3, arguments.size());
+    LONGS_EQUAL(1, ast.integer(arguments[0]));
+    CHECK(ast.boolean(arguments[1]));
+    LONGS_EQUAL(1, ast.children(arguments[2]).size());
+
+    // Elements follow their list's owner in walk order
+    CHECK(arguments[0] < arguments[1] && arguments[1] < arguments[2]);
+}
+
+TEST(FlatAstTest, missingAlternative)
+{
+    auto program = parse("if (x) { 1 };");
+    FlatAst ast(*program);
+    auto expression = ast.first(ast.getStatements()[0]);
+    LONGS_EQUAL(FlatAst::IF, ast.kind(expression));
+    LONGS_EQUAL(FlatAst::NONE, ast.third(expression));
+}
+
+TEST(FlatAstTest, outlivesProgram)
+{
+    auto program = parse("let name = other;");
+    FlatAst ast(*program);
+    program.reset();
+    CHECK_EQUAL("let name = other;\n", ast.string());
+}
+
+TEST(FlatAstTest, smallerThanProgram)
+{
+    std::string input;
+    for (int i = 0; i < 10000; ++i)
+    {
+        input += "let x = f(1 + 2, -y) * 3; if (x < 10) { return x; } else { x; };";
+    }
+    auto program = parse(input);
+    FlatAst ast(*program);
+    // The nodes of the program are compact too, but the flat form has no
+    // vtable pointers and 32-bit child numbers
+    CHECK(ast.memoryUsage() * 3 <= program->arena.bytesUsed() * 2);
+}
+
+TEST(FlatAstTest, toProgram)
+{
+    auto program = parse("let add = fn(x, y) { return x + y; };\n"
+                         "add(1, -2 * 3);\n"
+                         "if (a < b) { true } else { !false };\n"
+                         "let f = fn() { if (x == 1) { 2 } };\n");
+    auto copy = FlatAst(*program).toProgram();
+    CHECK_EQUAL(program->string(), copy->string());
+
+    auto let = dynamic_cast<LetStatement*>(copy->statements[0]);
+    CHECK(let != nullptr);
+    auto original = dynamic_cast<LetStatement*>(program->statements[0]);
+    LONGS_EQUAL(original->identifier->symbol, let->identifier->symbol);
+}
+
+TEST(FlatAstTest, serializeRoundTrip)
+{
+    auto program = parse("let add = fn(x, y) { return x + y; };\n"
+                         "add(1, -2 * 3, 9223372036854775807);\n"
+                         "if (a < b) { true } else { !false };\n"
+                         "fn() { }();\n");
+    auto data = FlatAst(*program).serialize();
+
+    SymbolTable symbols;
+    auto ast = FlatAst::deserialize(data, symbols);
+    CHECK(ast != nullptr);
+    CHECK_EQUAL(program->string(), ast->string());
+    CHECK_EQUAL(program->string(), ast->toProgram()->string());
+    LONGS_EQUAL(5, symbols.size());
+    CHECK_EQUAL(data, ast->serialize());
+}
+
+TEST(FlatAstTest, emptyRoundTrip)
+{
+    auto program = parse("");
+    auto ast = FlatAst::deserialize(FlatAst(*program).serialize());
+    CHECK(ast != nullptr);
+    LONGS_EQUAL(0, ast->size());
+}
+
+TEST(FlatAstTest, namesOfTheTreeOnly)
+{
+    // The symbols of the names are far apart in a large table
+    SymbolTable symbols;
+    for (int i = 0; i < 100000; ++i)
+    {
+        symbols.intern("name_" + std::string(1, static_cast<char>('a' + i % 26)) + std::to_string(i));
+    }
+    Lexer lexer("let x = y + x;");
+    lexer.setSymbolTable(symbols);
+    Parser parser(lexer);
+    auto program = parser.parseProgram();
+
+    FlatAst ast(*program);
+    CHECK(ast.memoryUsage() < 1024);
+    CHECK_EQUAL("x", std::string(ast.name(1)));
+    LONGS_EQUAL(symbols.intern("x"), ast.symbol(1));
+    LONGS_EQUAL(symbols.intern("y"), ast.symbol(ast.first(2)));
+    LONGS_EQUAL(ast.first(1), ast.first(ast.second(2)));
+
+    auto copy = FlatAst::deserialize(ast.serialize(), symbols);
+    CHECK(copy != nullptr);
+    LONGS_EQUAL(symbols.intern("y"), copy->symbol(copy->first(2)));
+    CHECK(copy->memoryUsage() < 1024);
+}
+
+TEST(FlatAstTest, deeplyNestedRoundTrip)
+{
+    const int depth = 100000;
+    auto program = parse("let x = " + std::string(depth, '-') + "1;");
+    auto copy = FlatAst::deserialize(FlatAst(*program).serialize())->toProgram();
+
+    Expression* expression = dynamic_cast<LetStatement*>(copy->statements[0])->expression;
+    int prefixes = 0;
+    while (auto* prefix = dynamic_cast<PrefixExpression*>(expression))
+    {
+        ++prefixes;
+        expression = prefix->right;
+    }
+    LONGS_EQUAL(depth, prefixes);
+}
+
+TEST(FlatAstTest, deeplyNestedString)
+{
+    const int depth = 100000;
+    FlatAst prefixes(*parse("let x = " + std::string(depth, '-') + "1;"));
+    std::string expected = "let x = ";
+    for (int i = 0; i < depth; ++i)
+    {
+        expected += "(-";
+    }
+    expected += "1" + std::string(depth, ')') + ";\n";
+    CHECK(prefixes.string() == expected);
+
+    std::string source = "x";
+    expected = std::string(depth, '(') + "x";
+    for (int i = 0; i < depth; ++i)
+    {
+        source += " + x";
+        expected += " + x)";
+    }
+    FlatAst infixes(*parse(source + ";"));
+    CHECK(infixes.string() == expected + "\n");
+}
+
+TEST(FlatAstTest, damagedDataIsRejected)
+{
+    auto program = parse("let f = fn(x) { if (x) { f(x - 1) } else { 0 } }; f(true);");
+    auto data = FlatAst(*program).serialize();
+
+    for (size_t size = 0; size < data.size(); ++size)
+    {
+        CHECK(FlatAst::deserialize(data.substr(0, size)) == nullptr);
+    }
+    CHECK(FlatAst::deserialize(data + "x") == nullptr);
+
+    auto otherVersion = data;
+    otherVersion[8] = static_cast<char>(FlatAst::formatVersion + 1);
+    CHECK(FlatAst::deserialize(otherVersion) == nullptr);
+
+    // Any single damaged byte either is found or still gives a valid tree
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+        for (int value : {0x00, 0x01, 0x7f, 0xff})
+        {
+            auto damaged = data;
+            damaged[i] = static_cast<char>(value);
+            auto ast = FlatAst::deserialize(damaged);
+            if (ast != nullptr)
+            {
+                ast->toProgram();
+            }
+        }
+    }
+}
+
+int main(int ac, char** av)
+{
+    return CommandLineTestRunner::RunAllTests(ac, av);
+}
@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <IncrementalLexer.h>
+#include <Lexer.h>
+#include <SymbolTable.h>
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+TEST_GROUP(IncrementalLexerTest)
+{
+    void setup() override {}
+    void teardown() override {}
+
+    // The tokens must be the same as when the edited source is read in full
+    static void checkTokens(const IncrementalLexer& lexer)
+    {
+        Lexer fullLexer(lexer.getSource());
+        fullLexer.setSymbolTable(lexer.getSymbolTable());
+        auto expected = fullLexer.tokenizeAll();
+        const auto& actual = lexer.getTokens();
+        CHECK_EQUAL(expected.size(), actual.size());
+        for (size_t i = 0; i < expected.size(); ++i)
+        {
+            CHECK_EQUAL(expected.type(i), actual.type(i));
+            CHECK_EQUAL(expected.offset(i), actual.offset(i));
+            CHECK_EQUAL(expected.length(i), actual.length(i));
+            CHECK_EQUAL(expected.value(i), actual.value(i));
+            CHECK_EQUAL(std::string(expected.literal(i)), std::string(actual.literal(i)));
+            CHECK_EQUAL(expected.location(i).line, lexer.location(actual.offset(i)).line);
+            CHECK_EQUAL(expected.location(i).column, lexer.location(actual.offset(i)).column);
+        }
+    }
+
+    static IncrementalLexer::Change edit(IncrementalLexer& lexer, size_t offset, size_t removed,
+                                         const std::string& inserted)
+    {
+        auto change = lexer.apply({offset, removed, inserted});
+        checkTokens(lexer);
+        return change;
+    }
+};
+
+TEST(IncrementalLexerTest, changeWithinIdentifier)
+{
+    IncrementalLexer lexer(std::make_shared<const SourceBuffer>("let abc = 5;\nlet d = abc + 1;"));
+    auto change = edit(lexer, 5, 1, "xyz");
+    CHECK_EQUAL("let axyzc = 5;\nlet d = abc + 1;", std::string(lexer.getSource()->text()));
+    CHECK_EQUAL(1, change.first);
+    CHECK_EQUAL(1, change.oldCount);
+    CHECK_EQUAL(1, change.newCount);
+}
+
+TEST(IncrementalLexerTest, joinTokens)
+{
+    IncrementalLexer lexer(std::make_shared<const SourceBuffer>("a = b;"));
+    auto change = edit(lexer, 3, 0, "=");
+    CHECK_EQUAL("a == b;", std::string(lexer.getSource()->text()));
+    CHECK_EQUAL(1, change.first);
+    CHECK_EQUAL(1, change.oldCount);
+    CHECK_EQUAL(1, change.newCount);
+
+    change = edit(lexer, 1, 1, "");
+    CHECK_EQUAL("a== b;", std::string(lexer.getSource()->text()));
+    CHECK_EQUAL(0, change.first);
+    CHECK_EQUAL(1, change.oldCount);
+    CHECK_EQUAL(1, change.newCount);
+}
+
+TEST(IncrementalLexerTest, joinIdentifiers)
+{
+    IncrementalLexer lexer(std::make_shared<const SourceBuffer>("x ab cd y"));
+    auto change = edit(lexer, 4, 1, "");
+    CHECK_EQUAL(1, change.first);
+    CHECK_EQUAL(2, change.oldCount);
+    CHECK_EQUAL(1, change.newCount);
+    CHECK_EQUAL("abcd", std::string(lexer.getTokens().literal(1)));
+}
+
+TEST(IncrementalLexerTest, splitToken)
+{
+    IncrementalLexer lexer(std::make_shared<const SourceBuffer>("let value = 12345;"));
+    auto change = edit(lexer, 14, 0, " + ");
+    CHECK_EQUAL("let value = 12 + 345;", std::string(lexer.getSource()->text()));
+    CHECK_EQUAL(3, change.first);
+    CHECK_EQUAL(1, change.oldCount);
+    CHECK_EQUAL(3, change.newCount);
+}
+
+TEST(IncrementalLexerTest, editInWhiteSpace)
+{
+    IncrementalLexer lexer(std::make_shared<const SourceBuffer>("a      b"));
+    auto change = edit(lexer, 3, 0, "c");
+    CHECK_EQUAL(1, change.first);
+    CHECK_EQUAL(0, change.oldCount);
+    CHECK_EQUAL(1, change.newCount);
+}
+
+TEST(IncrementalLexerTest, editAtEnds)
+{
+    IncrementalLexer lexer(std::make_shared<const SourceBuffer>("x + y"));
+    edit(lexer, 0, 0, "let z = ");
+    edit(lexer, lexer.size(), 0, ";");
+    edit(lexer, 0, lexer.size(), "");
+    CHECK_EQUAL(1, lexer.getTokens().size());
+    edit(lexer, 0, 0, "fn(a) { a }");
+}
+
+TEST(IncrementalLexerTest, editOutsideSource)
+{
+    IncrementalLexer lexer(std::make_shared<const SourceBuffer>("abc"));
+    for (IncrementalLexer::Edit outside : {IncrementalLexer::Edit{4, 0, "x"}, IncrementalLexer::Edit{2, 2, ""}})
+    {
+        bool thrown = false;
+        try
+        {
+            lexer.apply(outside);
+        }
+        catch (std::out_of_range&)
+        {
+            thrown = true;
+        }
+        CHECK_TRUE(thrown);
+    }
+    checkTokens(lexer);
+}
+
+TEST(IncrementalLexerTest, editCopiesOnlyReadText)
+{
+    std::string source;
+    for (int i = 0; i < 1000; ++i)
+    {
+        source += "let value = 12345;\n";
+    }
+    IncrementalLexer lexer(std::make_shared<const SourceBuffer>(source));
+    auto change = edit(lexer, 10000, 1, "xyz");
+    CHECK(lexer.getTokens().source(change.first)->size() < 1000);
+    CHECK(lexer.getTokens().source(0)->size() == source.size());
+
+    // A long token is copied in full. It is joined to the "let" before it.
+    std::string identifier(5000, 'a');
+    change = edit(lexer, 5000, 0, identifier);
+    CHECK_EQUAL(3 + 5000, lexer.getTokens().length(change.first));
+}
+
+TEST(IncrementalLexerTest, manyPiecesAreJoined)
+{
+    std::string source;
+    for (int i = 0; i < 1000; ++i)
+    {
+        source += "let value = 12345;\n";
+    }
+    IncrementalLexer lexer(std::make_shared<const SourceBuffer>(source));
+    auto original = lexer.getTokens().source(0);
+
+    // Edits all over the text, which leave the first token alone until the
+    // pieces are joined
+    size_t edits = 0;
+    while (lexer.getTokens().source(0) == original)
+    {
+        lexer.apply({100 + (edits * 7919) % (lexer.size() - 100), 1, edits % 2 == 0 ? "\n" : "8"});
+        ++edits;
+    }
+    checkTokens(lexer);
+    CHECK(edits > 500);
+    CHECK_EQUAL(lexer.size(), lexer.getTokens().source(0)->size());
+    edit(lexer, 150, 2, "x\ny");
+}
+
+TEST(IncrementalLexerTest, symbolTableOfItsOwn)
+{
+    auto globalSize = SymbolTable::global().size();
+    IncrementalLexer lexer(std::make_shared<const SourceBuffer>("let a = 1;"));
+    IncrementalLexer other(std::make_shared<const SourceBuffer>("let b = 1;"));
+    CHECK(&lexer.getSymbolTable() != &other.getSymbolTable());
+    for (const char* typed : {"f", "o", "o"})
+    {
+        edit(lexer, lexer.size(), 0, typed);
+    }
+    CHECK_EQUAL(4, lexer.getSymbolTable().size());
+    CHECK_EQUAL(globalSize, SymbolTable::global().size());
+
+    SymbolTable table;
+    IncrementalLexer shared(std::make_shared<const SourceBuffer>("x y"), table);
+    CHECK(&table == &shared.getSymbolTable());
+    CHECK_EQUAL(2, table.size());
+}
+
+TEST(IncrementalLexerTest, randomEdits)
+{
+    static const char* fragments[] = {"", "a", "let", " ", "\n", "=", "!", "==", "12", "x1", "(", "}", ";", " fn "};
+    std::mt19937 random(13);
+    IncrementalLexer lexer(std::make_shared<const SourceBuffer>(
+            "let add = fn(x, y) { x + y; };\nlet result = add(5, 10) != 15;\nif (result) { !true } else { 42 }"));
+    for (int i = 0; i < 2000; ++i)
+    {
+        auto size = lexer.size();
+        auto offset = random() % (size + 1);
+        auto removed = random() % (std::min<size_t>(size - offset, 4) + 1);
+        edit(lexer, offset, removed, fragments[random() % std::size(fragments)]);
+    }
+}
+
+int main(int ac, char** av)
+{
+    return CommandLineTestRunner::RunAllTests(ac, av);
+}
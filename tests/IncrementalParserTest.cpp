@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include <memory>
+#include <random>
+#include <string>
+#include <IncrementalLexer.h>
+#include <IncrementalParser.h>
+#include <Lexer.h>
+#include <Parser.h>
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+TEST_GROUP(IncrementalParserTest)
+{
+    void setup() override {}
+    void teardown() override {}
+
+    // The program and errors must be the same as when the source is parsed
+    // in full, the ranges must cover the tokens, and the blocks of each range
+    // must be those that the parser records
+    static void checkProgram(const IncrementalParser& incremental, const IncrementalLexer& lexer,
+                             size_t nestingLimit = Parser::defaultNestingLimit)
+    {
+        const auto& tokens = lexer.getTokens();
+        Parser parser(Lexer(lexer.getSource()).tokenizeAll());
+        parser.setNestingLimit(nestingLimit);
+        std::vector<Parser::BlockRecord> blocks;
+        parser.recordBlocks(&blocks);
+        auto expected = parser.parseProgram();
+        const auto& actual = incremental.getProgram();
+        CHECK_EQUAL(expected->statements.size(), actual->statements.size());
+        CHECK_EQUAL(expected->string(), actual->string());
+        CHECK(parser.diagnostics() == incremental.diagnostics(lexer));
+
+        size_t position = 0;
+        size_t statement = 0;
+        auto block = blocks.begin();
+        for (const auto& range : incremental.getRanges())
+        {
+            CHECK_EQUAL(position, range.first);
+            CHECK(range.end > range.first);
+            position = range.end;
+            if (range.statement != nullptr)
+            {
+                CHECK(range.statement == actual->statements[statement++]);
+            }
+
+            for (const auto& record : range.blocks)
+            {
+                CHECK(block != blocks.end());
+                CHECK_EQUAL(block->open, range.first + record.open);
+                CHECK_EQUAL(block->close, range.first + record.close);
+                CHECK_EQUAL(block->depth, record.depth);
+                CHECK_EQUAL(block->starts.size(), record.starts.size());
+                for (size_t i = 0; i < record.starts.size(); ++i)
+                {
+                    CHECK_EQUAL(block->starts[i], range.first + record.starts[i]);
+                }
+                CHECK_EQUAL(record.starts.size(), record.block->statements.size());
+                CHECK_EQUAL(block->block->string(), record.block->string());
+                ++block;
+            }
+            while (block != blocks.end() && block->open < range.end)
+            {
+                ++block;
+            }
+        }
+        CHECK_EQUAL(tokens.size() - 1, position);
+        CHECK_EQUAL(actual->statements.size(), statement);
+    }
+
+    static size_t edit(IncrementalLexer& lexer, IncrementalParser& parser, size_t offset, size_t removed,
+                       const std::string& inserted, size_t nestingLimit = Parser::defaultNestingLimit)
+    {
+        auto change = lexer.apply({offset, removed, inserted});
+        auto reparsed = parser.update(lexer.getTokens(), change);
+        checkProgram(parser, lexer, nestingLimit);
+        return reparsed;
+    }
+
+    static std::vector<Statement*> statementsOf(const BlockStatement* block)
+    {
+        return {block->statements.begin(), block->statements.end()};
+    }
+};
+
+TEST(IncrementalParserTest, initialParse)
+{
+    IncrementalLexer lexer(std::make_shared<const SourceBuffer>("let a = 1; let b 2; a + b;"));
+    IncrementalParser parser(lexer.getTokens());
+    checkProgram(parser, lexer);
+    CHECK_EQUAL(3, parser.getRanges().size());
+    CHECK(parser.getRanges()[1].statement == nullptr);
+    CHECK_EQUAL(1, parser.getRanges()[1].errorCount);
+}
+
+TEST(IncrementalParserTest, untouchedStatementsAreKept)
+{
+    IncrementalLexer lexer(std::make_shared<const SourceBuffer>("let a = 1;\nlet b = 2;\nlet c = a + b;\nc;"));
+    IncrementalParser parser(lexer.getTokens());
+    auto before = parser.getProgram()->statements;
+
+    CHECK_EQUAL(1, edit(lexer, parser, 19, 1, "20"));
+    const auto& after = parser.getProgram()->statements;
+    CHECK(before[0] == after[0]);
+    CHECK(before[1] != after[1]);
+    CHECK(before[2] == after[2]);
+    CHECK(before[3] == after[3]);
+    CHECK_EQUAL("let b = 20;", after[1]->string());
+}
+
+TEST(IncrementalParserTest, editJoinsStatements)
+{
+    IncrementalLexer lexer(std::make_shared<const SourceBuffer>("let a = 1;\nlet b = 2;\nlet c = 3;"));
+    IncrementalParser parser(lexer.getTokens());
+    edit(lexer, parser, 9, 1, " +");
+    edit(lexer, parser, 10, 2, ";");
+}
+
+TEST(IncrementalParserTest, statementEndDependsOnNextToken)
+{
+    // The first statement ends without a semicolon, so it changes when the
+    // token after it is made an operator
+    IncrementalLexer lexer(std::make_shared<const SourceBuffer>("a\nb;\nc;"));
+    IncrementalParser parser(lexer.getTokens());
+    CHECK_EQUAL(3, parser.getProgram()->statements.size());
+    edit(lexer, parser, 2, 0, "+ ");
+    CHECK_EQUAL(2, parser.getProgram()->statements.size());
+}
+
+TEST(IncrementalParserTest, editMakesBlockSwallowRest)
+{
+    IncrementalLexer lexer(std::make_shared<const SourceBuffer>("let f = fn() { 1 };\nf();\nlet x = 2;\nx;"));
+    IncrementalParser parser(lexer.getTokens());
+    edit(lexer, parser, 18, 1, "");
+    edit(lexer, parser, 18, 0, "}");
+}
+
+TEST(IncrementalParserTest, editsAtEnds)
+{
+    IncrementalLexer lexer(std::make_shared<const SourceBuffer>("a; b;"));
+    IncrementalParser parser(lexer.getTokens());
+    edit(lexer, parser, 0, 0, "let x = ");
+    edit(lexer, parser, lexer.size(), 0, " c");
+    edit(lexer, parser, lexer.size(), 0, "(");
+    edit(lexer, parser, 0, lexer.size(), "");
+    edit(lexer, parser, 0, 0, "1;");
+}
+
+TEST(IncrementalParserTest, editInFunctionBody)
+{
+    std::string source = "let f = fn(x) {\n";
+    for (int i = 0; i < 50; ++i)
+    {
+        source += "    let a = x + " + std::to_string(i) + ";\n";
+    }
+    source += "};\nf(1);\n";
+    IncrementalLexer lexer(std::make_shared<const SourceBuffer>(source));
+    IncrementalParser parser(lexer.getTokens());
+    auto statements = parser.getProgram()->statements;
+    auto body = parser.getRanges()[0].blocks[0].block;
+    auto before = statementsOf(body);
+
+    auto offset = source.find("x + 20;") + 4;
+    CHECK_EQUAL(1, edit(lexer, parser, offset, 2, "200"));
+    CHECK(parser.getProgram()->statements == statements);
+    CHECK(parser.getRanges()[0].blocks[0].block == body);
+    auto after = statementsOf(body);
+    for (size_t i = 0; i < before.size(); ++i)
+    {
+        CHECK(i == 20 ? before[i] != after[i] : before[i] == after[i]);
+    }
+    CHECK_EQUAL("let a = (x + 200);", after[20]->string());
+
+    // A new statement in the body, and one taken out again
+    CHECK_EQUAL(2, edit(lexer, parser, offset + 4, 0, " a;"));
+    CHECK_EQUAL(51, statementsOf(body).size());
+    CHECK_EQUAL(1, edit(lexer, parser, offset + 4, 3, ""));
+    CHECK_EQUAL(50, statementsOf(body).size());
+    CHECK(parser.getProgram()->statements == statements);
+}
+
+TEST(IncrementalParserTest, editInNestedBlock)
+{
+    IncrementalLexer lexer(std::make_shared<const SourceBuffer>(
+            "let f = fn(x) {\n    let y = 1;\n    if (x) { let z = 2; z } else { y };\n    y\n};\nf(1);\n"));
+    IncrementalParser parser(lexer.getTokens());
+    auto statements = parser.getProgram()->statements;
+    auto body = statementsOf(parser.getRanges()[0].blocks[0].block);
+
+    // The edit is in the consequence of the if, so the statements of the
+    // function body are kept
+    auto offset = lexer.getSource()->text().find("2;");
+    CHECK_EQUAL(1, edit(lexer, parser, offset, 1, "3"));
+    CHECK(parser.getProgram()->statements == statements);
+    CHECK(statementsOf(parser.getRanges()[0].blocks[0].block) == body);
+
+    // An edit that takes away a closing brace goes on past the block
+    offset = lexer.getSource()->text().find("} else");
+    edit(lexer, parser, offset, 1, "");
+    edit(lexer, parser, offset, 0, "}");
+    edit(lexer, parser, offset, 0, "};");
+}
+
+TEST(IncrementalParserTest, nestingLimitInBlock)
+{
+    // The function body is at depth 3, so the limit is reached in it
+    const size_t nestingLimit = 8;
+    IncrementalLexer lexer(std::make_shared<const SourceBuffer>("let f = fn() { let a = 1; a };\nf();"));
+    IncrementalParser parser(lexer.getTokens(), nestingLimit);
+    checkProgram(parser, lexer, nestingLimit);
+    auto offset = lexer.getSource()->text().find("1;");
+    size_t length = 1;
+    for (int i = 0; i < 8; ++i)
+    {
+        edit(lexer, parser, offset, 0, "(", nestingLimit);
+        edit(lexer, parser, offset + length + 1, 0, ")", nestingLimit);
+        length += 2;
+    }
+    CHECK(parser.getErrors().size() > 0);
+    for (int i = 0; i < 8; ++i)
+    {
+        edit(lexer, parser, offset, 1, "", nestingLimit);
+        edit(lexer, parser, offset + length - 2, 1, "", nestingLimit);
+        length -= 2;
+    }
+    CHECK_EQUAL(0, parser.getErrors().size());
+}
+
+TEST(IncrementalParserTest, randomEdits)
+{
+    static const char* fragments[] = {"", "a", "let", " ", "\n", "=", "!", "==", "12", "(", ")", "{", "}", ";", ";",
+                                      ",", " fn ", "if", "else", "+"};
+    std::mt19937 random(21);
+    std::string source;
+    for (int i = 0; i < 20; ++i)
+    {
+        source += "let f = fn(x, y) { if (x < y) { x } else { y + 1 } };\nf(1, 2);\n";
+    }
+    IncrementalLexer lexer(std::make_shared<const SourceBuffer>(source));
+    IncrementalParser parser(lexer.getTokens());
+    for (int i = 0; i < 2000; ++i)
+    {
+        auto size = lexer.size();
+        auto offset = random() % (size + 1);
+        auto removed = random() % (std::min<size_t>(size - offset, 6) + 1);
+        edit(lexer, parser, offset, removed, fragments[random() % std::size(fragments)]);
+    }
+}
+
+TEST(IncrementalParserTest, compactsAfterManyEdits)
+{
+    std::string source;
+    for (int i = 0; i < 100; ++i)
+    {
+        source += "let f = fn(x, y) { if (x < y) { x } else { y + 1 } };\n";
+    }
+    IncrementalLexer lexer(std::make_shared<const SourceBuffer>(source));
+    IncrementalParser parser(lexer.getTokens());
+    auto first = parser.getProgram()->statements.front();
+    auto used = parser.getProgram()->arena.bytesUsed();
+
+    // Only the last statement is replaced, so the other ones only move when
+    // the program is compacted
+    size_t maximumUsed = 0;
+    size_t maximumSources = 0;
+    for (int i = 0; i < 1000; ++i)
+    {
+        edit(lexer, parser, source.size() - 7, 1, i % 2 == 0 ? "2" : "1");
+        maximumUsed = std::max(maximumUsed, parser.getProgram()->arena.bytesUsed());
+        maximumSources = std::max(maximumSources, parser.getProgram()->sources.size());
+    }
+    CHECK(parser.getProgram()->statements.front() != first);
+    CHECK(maximumUsed < 3 * used + 64 * 1024);
+    CHECK(maximumSources < 100);
+}
+
+int main(int ac, char** av)
+{
+    return CommandLineTestRunner::RunAllTests(ac, av);
+}
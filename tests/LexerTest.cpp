@@ -6,9 +6,9 @@
  *
  */
 
+#include <vector>
 #include <Lexer.h>
 #include <Token.h>
-#include <Exceptions.h>
 #include "CppUTest/TestHarness.h"
 #include "CppUTest/CommandLineTestRunner.h"
 
@@ -30,21 +30,21 @@ TEST_GROUP(LexerTest)
     {
         token = lexer->nextToken();
         CHECK_EQUAL(type, token->type);
-        CHECK_EQUAL(std::string(1, c), *(token->literal.get()));
+        CHECK_EQUAL(std::string(1, c), std::string(token->literal));
     }
 
     void assertNextTokenDoubleCharToken(Token::TokenType type, const std::string& literal)
     {
         token = lexer->nextToken();
         CHECK_EQUAL(type, token->type);
-        CHECK_EQUAL(literal, *(token->literal.get()));
+        CHECK_EQUAL(literal, std::string(token->literal));
     }
 
     void assertNextToken(Token::TokenType type, const std::string& literal)
     {
         token = lexer->nextToken();
         CHECK_EQUAL(type, token->type);
-        CHECK_EQUAL(literal, *(token->literal.get()));
+        CHECK_EQUAL(literal, std::string(token->literal));
     }
 };
 
@@ -54,7 +54,7 @@ TEST(LexerTest, nextTokenEOF)
     token = lexer->nextToken();
 
     CHECK_EQUAL(Token::ENDOFFILE, token->type);
-    CHECK_EQUAL("EOF", *(token->literal.get()));
+    CHECK_EQUAL("EOF", std::string(token->literal));
 }
 
 // Make sure that the nextToken method does not proceed beyond EOF.
@@ -72,6 +72,14 @@ TEST(LexerTest, nextTokenIllegal)
     assertNextTokenSingleCharToken(Token::ILLEGAL, '?');
 }
 
+TEST(LexerTest, nextTokenIllegalHighByte)
+{
+    lexer = new Lexer("\xff=\x80");
+    assertNextToken(Token::ILLEGAL, std::string("\xff"));
+    assertNextToken(Token::ASSIGN, std::string("="));
+    assertNextToken(Token::ILLEGAL, std::string("\x80"));
+}
+
 TEST(LexerTest, nextTokenAssign)
 {
     lexer = new Lexer("=");
@@ -264,6 +272,63 @@ TEST(LexerTest, readTokenKeywordReturn)
     assertNextToken(Token::RETURN, std::string("return"));
 }
 
+TEST(LexerTest, integerValue)
+{
+    lexer = new Lexer("5 1234567890123 9223372036854775807 9223372036854775808");
+    for (int64_t expected : {int64_t(5), int64_t(1234567890123), INT64_MAX, Token::OUT_OF_RANGE})
+    {
+        auto token = lexer->nextToken();
+        CHECK_EQUAL(expected, token->value);
+    }
+}
+
+TEST(LexerTest, identifierSymbols)
+{
+    SymbolTable symbols;
+    lexer = new Lexer("alpha beta alpha let alpha");
+    lexer->setSymbolTable(symbols);
+    auto tokens = lexer->tokenizeAll();
+    CHECK_EQUAL(0, tokens.value(0));
+    CHECK_EQUAL(1, tokens.value(1));
+    CHECK_EQUAL(0, tokens.value(2));
+    CHECK_EQUAL(0, tokens.value(4));
+    CHECK_EQUAL(2, symbols.size());
+    CHECK_EQUAL("beta", std::string(symbols.name(1)));
+}
+
+TEST(LexerTest, tokenizeAll)
+{
+    lexer = new Lexer("let five = 5;\n  five != 10");
+    auto tokens = lexer->tokenizeAll();
+
+    std::vector<Token::TokenType> types {Token::LET, Token::IDENTIFIER, Token::ASSIGN, Token::INT,
+                                         Token::SEMICOLON, Token::IDENTIFIER, Token::NEQ, Token::INT,
+                                         Token::ENDOFFILE};
+    std::vector<uint32_t> offsets {0, 4, 9, 11, 12, 16, 21, 24, 26};
+    std::vector<std::string> literals {"let", "five", "=", "5", ";", "five", "!=", "10", "EOF"};
+
+    CHECK_EQUAL(types.size(), tokens.size());
+    for (size_t i = 0; i < tokens.size(); ++i)
+    {
+        CHECK_EQUAL(types[i], tokens.type(i));
+        CHECK_EQUAL(offsets[i], tokens.offset(i));
+        CHECK_EQUAL(literals[i], std::string(tokens.literal(i)));
+        CHECK_EQUAL(types[i], tokens.token(i).type);
+    }
+    CHECK_EQUAL(5, tokens.value(3));
+    CHECK_EQUAL(10, tokens.value(7));
+    CHECK_EQUAL(0, tokens.length(tokens.size() - 1));
+    POINTERS_EQUAL(nullptr, lexer->nextToken().get());
+}
+
+TEST(LexerTest, tokenizeAllEmpty)
+{
+    lexer = new Lexer("   ");
+    auto tokens = lexer->tokenizeAll();
+    CHECK_EQUAL(1, tokens.size());
+    CHECK_EQUAL(Token::ENDOFFILE, tokens.type(0));
+}
+
 int main(int ac, char** av)
 {
     return CommandLineTestRunner::RunAllTests(ac, av);
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include <memory>
+#include <random>
+#include <string>
+#include <Lexer.h>
+#include <ParallelLexer.h>
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+TEST_GROUP(ParallelLexerTest)
+{
+    void setup() override {}
+    void teardown() override {}
+
+    // Compare with the sequential lexer for several thread counts. Chunks of
+    // a single byte are allowed so that short inputs are split too.
+    static void checkSameTokens(const std::string& input)
+    {
+        auto source = std::make_shared<const SourceBuffer>(input);
+        auto expected = Lexer(source).tokenizeAll();
+
+        for (unsigned threads = 1; threads <= 8; ++threads)
+        {
+            auto actual = ParallelLexer::tokenize(source, threads, 1);
+            CHECK_EQUAL(expected.size(), actual.size());
+            for (size_t i = 0; i < expected.size(); ++i)
+            {
+                CHECK_EQUAL(expected.type(i), actual.type(i));
+                CHECK_EQUAL(expected.offset(i), actual.offset(i));
+                CHECK_EQUAL(expected.length(i), actual.length(i));
+                CHECK_EQUAL(expected.value(i), actual.value(i));
+            }
+        }
+    }
+
+    // Random programs made of token fragments, including ones that form two
+    // character tokens or longer identifiers and numbers when they are joined
+    static std::string randomProgram(std::mt19937& random, size_t pieces)
+    {
+        static const char* fragments[] = {
+            "let", "fn", "x", "value_1", "42", "9223372036854775808", "=", "==", "!", "!=",
+            "+", "-", "*", "/", "<", ">", "(", ")", "{", "}", ",", ";", "?", " ", "  ", "\t", "\n",
+        };
+        std::uniform_int_distribution<size_t> pick(0, std::size(fragments) - 1);
+        std::string program;
+        for (size_t i = 0; i < pieces; ++i)
+        {
+            program += fragments[pick(random)];
+        }
+        return program;
+    }
+};
+
+TEST(ParallelLexerTest, emptyInput)
+{
+    checkSameTokens("");
+    checkSameTokens("   \n\t ");
+}
+
+TEST(ParallelLexerTest, noWhiteSpace)
+{
+    checkSameTokens("let");
+    checkSameTokens("a==b!=c;fn(x,y){x+y}");
+}
+
+TEST(ParallelLexerTest, program)
+{
+    checkSameTokens("let five = 5;\nlet add = fn(x, y) {\n    x + y;\n};\nif (add(five, 10) != 15) { !true }");
+}
+
+TEST(ParallelLexerTest, zeroByteEndsInput)
+{
+    checkSameTokens(std::string("let a = 1;\0 let b = 2;", 22));
+}
+
+TEST(ParallelLexerTest, randomInputs)
+{
+    std::mt19937 random(2020);
+    for (int i = 0; i < 200; ++i)
+    {
+        checkSameTokens(randomProgram(random, 1 + i));
+    }
+}
+
+TEST(ParallelLexerTest, randomBytes)
+{
+    std::mt19937 random(7);
+    std::uniform_int_distribution<int> byte(1, 127);
+    for (int i = 0; i < 50; ++i)
+    {
+        std::string input;
+        for (int j = 0; j < 10 * i; ++j)
+        {
+            input += static_cast<char>(byte(random));
+        }
+        checkSameTokens(input);
+    }
+}
+
+TEST(ParallelLexerTest, splitPointsWithoutWhiteSpace)
+{
+    SourceBuffer source("aaaaaaaa bb");
+    auto points = ParallelLexer::splitPoints(source, 4);
+    CHECK_EQUAL(8, points[1]);
+    CHECK_EQUAL(8, points[2]);
+    CHECK_EQUAL(8, points[3]);
+    CHECK_EQUAL(11, points[4]);
+}
+
+TEST(ParallelLexerTest, largeSourceUsesDefaultChunkSize)
+{
+    std::string input;
+    while (input.size() < 4 * ParallelLexer::minimumChunkSize)
+    {
+        input += "let value = fn(x) { x * 2 + 1 };\n";
+    }
+    auto source = std::make_shared<const SourceBuffer>(input);
+    auto expected = Lexer(source).tokenizeAll();
+    auto actual = ParallelLexer::tokenize(source, 4);
+    CHECK_EQUAL(expected.size(), actual.size());
+    CHECK_EQUAL(expected.offset(expected.size() - 2), actual.offset(actual.size() - 2));
+    CHECK_EQUAL(Token::ENDOFFILE, actual.type(actual.size() - 1));
+}
+
+TEST(ParallelLexerTest, splitPointsAtWhiteSpace)
+{
+    SourceBuffer source("aaaa bbbb cccc");
+    auto points = ParallelLexer::splitPoints(source, 3);
+    CHECK_EQUAL(4, points.size());
+    CHECK_EQUAL(0, points[0]);
+    CHECK_EQUAL(4, points[1]);
+    CHECK_EQUAL(9, points[2]);
+    CHECK_EQUAL(14, points[3]);
+}
+
+int main(int ac, char** av)
+{
+    return CommandLineTestRunner::RunAllTests(ac, av);
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include <memory>
+#include <random>
+#include <string>
+#include <Lexer.h>
+#include <ParallelParser.h>
+#include <Parser.h>
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+TEST_GROUP(ParallelParserTest)
+{
+    void setup() override {}
+    void teardown() override {}
+
+    // Compare with the sequential parser for several thread counts. Slices
+    // of a single token are allowed so that short inputs are split too.
+    static void checkSameProgram(const std::string& input)
+    {
+        auto source = std::make_shared<const SourceBuffer>(input);
+        auto tokens = Lexer(source).tokenizeAll();
+        Parser parser(tokens);
+        auto expected = parser.parseProgram();
+
+        for (unsigned threads = 1; threads <= 8; ++threads)
+        {
+            ParserErrors errors;
+            auto actual = ParallelParser::parse(tokens, errors, threads, 1);
+            CHECK_EQUAL(expected->statements.size(), actual->statements.size());
+            CHECK_EQUAL(expected->string(), actual->string());
+            CHECK_EQUAL(parser.errors.size(), errors.size());
+            for (size_t i = 0; i < errors.size(); ++i)
+            {
+                CHECK_EQUAL(parser.errors.record(i).position, errors.record(i).position);
+                CHECK_EQUAL(parser.errors[i], errors[i]);
+            }
+        }
+    }
+
+    // Random programs made of tokens, with enough semicolons and braces to
+    // give split points and errors around them
+    static std::string randomProgram(std::mt19937& random, size_t tokens)
+    {
+        static const char* fragments[] = {
+            "let ", "fn", "x", "y", "42", "=", "==", "!", "+", "-", "*", "<", "(", ")", "{", "}", ",",
+            ";", ";", "; ", "if", "else", "return ", "true",
+        };
+        std::uniform_int_distribution<size_t> pick(0, std::size(fragments) - 1);
+        std::string program;
+        for (size_t i = 0; i < tokens; ++i)
+        {
+            program += fragments[pick(random)];
+            program += ' ';
+        }
+        return program;
+    }
+};
+
+TEST(ParallelParserTest, emptyInput)
+{
+    checkSameProgram("");
+    checkSameProgram(";;;");
+}
+
+TEST(ParallelParserTest, program)
+{
+    checkSameProgram("let five = 5;\nlet add = fn(x, y) {\n    x + y;\n};\n"
+                     "if (add(five, 10) != 15) { !true; } else { false; };\nadd(1, 2) * -3;\nreturn five;");
+}
+
+TEST(ParallelParserTest, errorsAtSlices)
+{
+    checkSameProgram("let x 5; (3 + 4; let y = 1;");
+    checkSameProgram("fn() { ) } ; 5; 6; 7;");
+    checkSameProgram("} ; let a = { ; b; } ; c;");
+    checkSameProgram("let a = fn() { 1; 2; 3 }; let b = 2; f(1; 2); 3;");
+    checkSameProgram("if (x) { 1; 2; ");
+}
+
+TEST(ParallelParserTest, unbalancedBraceRunsToTheEnd)
+{
+    // Every slice after the first is parsed again, in windows that grow
+    std::string input("if (x) { ");
+    for (int i = 0; i < 40; ++i)
+    {
+        input += "let a = " + std::to_string(i) + "; ";
+    }
+    checkSameProgram(input);
+    checkSameProgram("let b = 1; " + input + "} ; c;");
+}
+
+TEST(ParallelParserTest, randomInputs)
+{
+    std::mt19937 random(2020);
+    for (int i = 0; i < 300; ++i)
+    {
+        checkSameProgram(randomProgram(random, 1 + i));
+    }
+}
+
+TEST(ParallelParserTest, splitPointsAfterTopLevelSemicolons)
+{
+    auto tokens = Lexer("a; fn() { b; c; }; d; e;").tokenizeAll();
+    auto points = ParallelParser::splitPoints(tokens, 4);
+    CHECK_EQUAL(5, points.size());
+    CHECK_EQUAL(0, points[0]);
+    CHECK_EQUAL(12, points[1]);
+    CHECK_EQUAL(14, points[2]);
+    CHECK_EQUAL(16, points[3]);
+    CHECK_EQUAL(tokens.size(), points[4]);
+}
+
+TEST(ParallelParserTest, parserReadsAllTokens)
+{
+    std::string input;
+    while (input.size() < 64 * ParallelParser::minimumSliceSize)
+    {
+        input += "let value = fn(x) { x * 2 + 1 }; value(3;\n";
+    }
+    Lexer sequentialLexer(input.c_str());
+    Parser sequentialParser(sequentialLexer);
+    auto expected = sequentialParser.parseProgram();
+
+    Lexer lexer(input.c_str());
+    Parser parser(lexer);
+    auto actual = parser.parseProgramInParallel(4);
+    CHECK_EQUAL(expected->statements.size(), actual->statements.size());
+    CHECK_EQUAL(expected->string(), actual->string());
+    CHECK(sequentialParser.diagnostics() == parser.diagnostics());
+}
+
+int main(int ac, char** av)
+{
+    return CommandLineTestRunner::RunAllTests(ac, av);
+}
@@ -6,9 +6,12 @@
  *
  */
 
+#include <algorithm>
+#include <string>
 #include <vector>
 #include "Parser.h"
 #include "Ast.h"
+#include "StreamingLexer.h"
 #include "CppUTest/TestHarness.h"
 #include "CppUTest/CommandLineTestRunner.h"
 
@@ -23,9 +26,9 @@ struct BooleanTestSetup
 {
     std::string input;
     bool left;
-    const std::string& expectedOp;
+    std::string expectedOp;
     bool right;
-    const std::string& expectedOutput;
+    std::string expectedOutput;
 };
 
 TEST_GROUP(ParserTest)
@@ -40,39 +43,35 @@ TEST_GROUP(ParserTest)
         delete (lexer);
     }
 
-    void checkLetStatement(const std::shared_ptr<Statement>& statement, const std::string& name) const
+    void checkLetStatement(Statement* statement, const std::string& name) const
     {
-        auto* letStatement = dynamic_cast<LetStatement *>(statement.get());
-        CHECK(letStatement->token != nullptr);
-        CHECK_EQUAL(Token::LET, (letStatement->token->type));
-        CHECK_EQUAL("let", *letStatement->token->literal);
+        auto* letStatement = dynamic_cast<LetStatement *>(statement);
+        CHECK(letStatement != nullptr);
         CHECK(letStatement->identifier != nullptr);
-        CHECK_EQUAL(name, *letStatement->identifier->value);
+        CHECK_EQUAL(name, std::string(letStatement->identifier->value));
     }
 
-    void checkReturnStatement(const std::shared_ptr<Statement>& statement, std::string expected) const
+    void checkReturnStatement(Statement* statement, std::string expected) const
     {
-        auto* returnStatement = dynamic_cast<ReturnStatement *>(statement.get());
-        CHECK(returnStatement->token != nullptr);
-        CHECK_EQUAL(Token::RETURN, (returnStatement->token->type));
-        CHECK_EQUAL("return", *returnStatement->token->literal);
+        auto* returnStatement = dynamic_cast<ReturnStatement *>(statement);
+        CHECK(returnStatement != nullptr);
         CHECK(returnStatement->expression != nullptr);
         CHECK_EQUAL(expected, returnStatement->string());
     }
 
-    void checkIntegerExpression(const std::shared_ptr<Expression>& expression, int64_t value) const
+    void checkIntegerExpression(Expression* expression, int64_t value) const
     {
         CHECK(expression != nullptr);
-        auto* integer = dynamic_cast<Integer*>(expression.get());
+        auto* integer = dynamic_cast<Integer*>(expression);
         CHECK(integer != nullptr);
         CHECK_EQUAL(value, integer->value);
         CHECK_EQUAL(std::to_string(value), integer->string());
     }
 
-    void checkBooleanExpression(const std::shared_ptr<Expression>& expression, bool value) const
+    void checkBooleanExpression(Expression* expression, bool value) const
     {
         CHECK(expression != nullptr);
-        auto boolean = dynamic_cast<Boolean*>(expression.get());
+        auto boolean = dynamic_cast<Boolean*>(expression);
         CHECK(boolean != nullptr);
         CHECK_EQUAL(value, boolean->value);
         if (value)
@@ -95,18 +94,18 @@ TEST_GROUP(ParserTest)
         auto program = parser.parseProgram();
         CHECK_EQUAL_TEXT(0, parser.errors.size(), parser.errors[0].c_str());
         CHECK_EQUAL(1, program.get()->statements.size());
-        std::shared_ptr<Expression> expression = getAndCheckExpressionStatement(program->statements.front());
-        auto* infix = dynamic_cast<InfixExpression*>(expression.get());
+        Expression* expression = getAndCheckExpressionStatement(program->statements.front());
+        auto* infix = dynamic_cast<InfixExpression*>(expression);
         CHECK(infix != nullptr);
         checkIntegerExpression(infix->left, left);
-        CHECK_EQUAL(expectedOp, infix->op);
+        CHECK_EQUAL(expectedOp, std::string(Token::getLiteral(infix->op)));
         checkIntegerExpression(infix->right, right);
         CHECK_EQUAL(expectedOutput, infix->string());
     }
 
-    static std::shared_ptr<Expression> getAndCheckExpressionStatement(const std::shared_ptr<Statement>& statement)
+    static Expression* getAndCheckExpressionStatement(Statement* statement)
     {
-        auto* expressionStatement = dynamic_cast<ExpressionStatement*>(statement.get());
+        auto* expressionStatement = dynamic_cast<ExpressionStatement*>(statement);
         CHECK(expressionStatement != nullptr);
         CHECK(expressionStatement->expression != nullptr);
         return expressionStatement->expression;
@@ -212,6 +211,35 @@ TEST(ParserTest, letStatementErrorNonValidIdentifier)
     CHECK_EQUAL(message, parser.errors[0]);
 }
 
+TEST(ParserTest, errorLocations)
+{
+    auto parser = createParser("let x = 5;\nlet y 10;\n  let = 3;\n");
+    parser.parseProgram();
+    auto diagnostics = parser.diagnostics();
+    CHECK_EQUAL(2, diagnostics.size());
+    CHECK_EQUAL("2:7: Expected ASSIGN token. Got INT token (10)", diagnostics[0]);
+    CHECK_EQUAL("3:7: Expected IDENTIFIER token. Got ASSIGN token (=)", diagnostics[1]);
+}
+
+TEST(ParserTest, errorRecords)
+{
+    auto parser = createParser("let x 10; )\n");
+    parser.parseProgram();
+    CHECK_EQUAL(3, parser.errors.size());
+
+    auto& wrongToken = parser.errors.record(0);
+    CHECK_EQUAL(ParserError::WRONG_TOKEN, wrongToken.code);
+    CHECK_EQUAL(2, wrongToken.position);
+    CHECK_EQUAL(Token::ASSIGN, wrongToken.expected);
+    CHECK_EQUAL(Token::INT, wrongToken.actual);
+    CHECK_EQUAL("10", std::string(wrongToken.literal));
+
+    CHECK_EQUAL(ParserError::NO_PREFIX_PARSE_FUNCTION, parser.errors.record(1).code);
+    CHECK_EQUAL(Token::RPAREN, parser.errors.record(1).actual);
+    CHECK_EQUAL(ParserError::NO_MORE_TOKENS, parser.errors.record(2).code);
+    CHECK_EQUAL("Expected more tokens, but none present", parser.errors[2]);
+}
+
 TEST(ParserTest, parseSingleReturnStatement)
 {
     auto program = parse("return 5;");
@@ -243,11 +271,10 @@ TEST(ParserTest, parseIdentifierExpression)
     auto program = parser.parseProgram();
     CHECK_EQUAL_TEXT(0, parser.errors.size(), parser.errors[0].c_str());
     CHECK_EQUAL(1, program.get()->statements.size());
-    std::shared_ptr<Expression> expression = getAndCheckExpressionStatement(program->statements.front());
-    auto* identifier = dynamic_cast<Identifier*>(expression.get());
+    Expression* expression = getAndCheckExpressionStatement(program->statements.front());
+    auto* identifier = dynamic_cast<Identifier*>(expression);
     CHECK(identifier != nullptr);
-    CHECK_EQUAL(Token::IDENTIFIER, (identifier->token->type));
-    CHECK_EQUAL("foobar", *identifier->value);
+    CHECK_EQUAL("foobar", std::string(identifier->value));
     CHECK_EQUAL("foobar", identifier->string());
 }
 
@@ -257,20 +284,40 @@ TEST(ParserTest, parseIntegerLiteralExpression)
     auto program = parser.parseProgram();
     CHECK_EQUAL_TEXT(0, parser.errors.size(), parser.errors[0].c_str());
     CHECK_EQUAL(1, program.get()->statements.size());
-    std::shared_ptr<Expression> expression = getAndCheckExpressionStatement(program->statements.front());
+    Expression* expression = getAndCheckExpressionStatement(program->statements.front());
     checkIntegerExpression(expression, 5);
 }
 
+TEST(ParserTest, parseLargeIntegerLiteral)
+{
+    auto parser = createParser("9223372036854775807;");
+    auto program = parser.parseProgram();
+    CHECK_EQUAL_TEXT(0, parser.errors.size(), parser.errors[0].c_str());
+    Expression* expression = getAndCheckExpressionStatement(program->statements.front());
+    checkIntegerExpression(expression, INT64_MAX);
+}
+
+TEST(ParserTest, integerLiteralOutOfRange)
+{
+    auto parser = createParser("let x = 92233720368547758080; 5 + 99999999999999999999 * 2; 7;");
+    auto program = parser.parseProgram();
+    CHECK_EQUAL(2, parser.errors.size());
+    CHECK_EQUAL("Integer literal out of range (92233720368547758080)", parser.errors[0]);
+    CHECK_EQUAL("Integer literal out of range (99999999999999999999)", parser.errors[1]);
+    CHECK_EQUAL(1, program->statements.size());
+    CHECK_EQUAL("7\n", program->string());
+}
+
 TEST(ParserTest, parseBangPrefixExpression)
 {
     auto parser = createParser("!5;");
     auto program = parser.parseProgram();
     CHECK_EQUAL_TEXT(0, parser.errors.size(), parser.errors[0].c_str());
     CHECK_EQUAL(1, program.get()->statements.size());
-    std::shared_ptr<Expression> expression = getAndCheckExpressionStatement(program->statements.front());
-    auto* prefix = dynamic_cast<PrefixExpression*>(expression.get());
+    Expression* expression = getAndCheckExpressionStatement(program->statements.front());
+    auto* prefix = dynamic_cast<PrefixExpression*>(expression);
     CHECK(prefix != nullptr);
-    CHECK_EQUAL("!", prefix->op);
+    CHECK_EQUAL("!", std::string(Token::getLiteral(prefix->op)));
     checkIntegerExpression(prefix->right, 5);
     CHECK_EQUAL("(!5)", prefix->string());
 }
@@ -281,10 +328,10 @@ TEST(ParserTest, parseMinusPrefixExpression)
     auto program = parser.parseProgram();
     CHECK_EQUAL_TEXT(0, parser.errors.size(), parser.errors[0].c_str());
     CHECK_EQUAL(1, program.get()->statements.size());
-    std::shared_ptr<Expression> expression = getAndCheckExpressionStatement(program->statements.front());
-    auto* prefix = dynamic_cast<PrefixExpression*>(expression.get());
+    Expression* expression = getAndCheckExpressionStatement(program->statements.front());
+    auto* prefix = dynamic_cast<PrefixExpression*>(expression);
     CHECK(prefix != nullptr);
-    CHECK_EQUAL("-", prefix->op);
+    CHECK_EQUAL("-", std::string(Token::getLiteral(prefix->op)));
     checkIntegerExpression(prefix->right, 15);
     CHECK_EQUAL("(-15)", prefix->string());
 }
@@ -335,7 +382,7 @@ TEST(ParserTest, parseBooleanExpressionTrue)
     auto program = parser.parseProgram();
     CHECK_EQUAL_TEXT(0, parser.errors.size(), parser.errors[0].c_str());
     CHECK_EQUAL(1, program.get()->statements.size());
-    std::shared_ptr<Expression> expression = getAndCheckExpressionStatement(program->statements.front());
+    Expression* expression = getAndCheckExpressionStatement(program->statements.front());
     checkBooleanExpression(expression, true);
 }
 
@@ -345,7 +392,7 @@ TEST(ParserTest, parseBooleanExpressionFalse)
     auto program = parser.parseProgram();
     CHECK_EQUAL_TEXT(0, parser.errors.size(), parser.errors[0].c_str());
     CHECK_EQUAL(1, program.get()->statements.size());
-    std::shared_ptr<Expression> expression = getAndCheckExpressionStatement(program->statements.front());
+    Expression* expression = getAndCheckExpressionStatement(program->statements.front());
     checkBooleanExpression(expression, false);
 }
 
@@ -365,11 +412,11 @@ TEST(ParserTest, parseBooleanInfixExpressions)
         auto program = parser.parseProgram();
         CHECK_EQUAL_TEXT(0, parser.errors.size(), parser.errors[0].c_str());
         CHECK_EQUAL(1, program.get()->statements.size());
-        std::shared_ptr<Expression> expression = getAndCheckExpressionStatement(program->statements.front());
-        auto* infix = dynamic_cast<InfixExpression*>(expression.get());
+        Expression* expression = getAndCheckExpressionStatement(program->statements.front());
+        auto* infix = dynamic_cast<InfixExpression*>(expression);
         CHECK(infix != nullptr);
         checkBooleanExpression(infix->left, test.left);
-        CHECK_EQUAL(test.expectedOp, infix->op);
+        CHECK_EQUAL(test.expectedOp, std::string(Token::getLiteral(infix->op)));
         checkBooleanExpression(infix->right, test.right);
         CHECK_EQUAL(test.expectedOutput, infix->string());
     }
@@ -393,10 +440,10 @@ TEST(ParserTest, parseBooleanPrefixExpressions)
         auto program = parser.parseProgram();
         CHECK_EQUAL_TEXT(0, parser.errors.size(), parser.errors[0].c_str());
         CHECK_EQUAL(1, program.get()->statements.size());
-        std::shared_ptr<Expression> expression = getAndCheckExpressionStatement(program->statements.front());
-        auto *prefix = dynamic_cast<PrefixExpression *>(expression.get());
+        Expression* expression = getAndCheckExpressionStatement(program->statements.front());
+        auto *prefix = dynamic_cast<PrefixExpression *>(expression);
         CHECK(prefix != nullptr);
-        CHECK_EQUAL(test.expectedOp, prefix->op);
+        CHECK_EQUAL(test.expectedOp, std::string(Token::getLiteral(prefix->op)));
         checkBooleanExpression(prefix->right, test.right);
         CHECK_EQUAL(test.expectedOutput, prefix->string());
     }
@@ -474,12 +521,9 @@ TEST(ParserTest, parseIfNoElseExpression)
     auto program = parser.parseProgram();
     CHECK_EQUAL_TEXT(0, parser.errors.size(), parser.errors[0].c_str());
     CHECK_EQUAL(1, program.get()->statements.size());
-    std::shared_ptr<Expression> expression = getAndCheckExpressionStatement(program->statements.front());
-    auto* ifExpression = dynamic_cast<IfExpression*>(expression.get());
+    Expression* expression = getAndCheckExpressionStatement(program->statements.front());
+    auto* ifExpression = dynamic_cast<IfExpression*>(expression);
     CHECK(ifExpression != nullptr);
-    CHECK(ifExpression->token != nullptr);
-    CHECK_EQUAL(Token::IF, (ifExpression->token->type));
-    CHECK_EQUAL("if", *ifExpression->token->literal);
     CHECK(ifExpression->condition != nullptr);
     CHECK_EQUAL("(x < y)", ifExpression->condition->string());
     CHECK_EQUAL("x\n", ifExpression->consequence->string());
@@ -493,12 +537,9 @@ TEST(ParserTest, parseIfWithElseExpression)
     auto program = parser.parseProgram();
     CHECK_EQUAL_TEXT(0, parser.errors.size(), parser.errors[0].c_str());
     CHECK_EQUAL(1, program.get()->statements.size());
-    std::shared_ptr<Expression> expression = getAndCheckExpressionStatement(program->statements.front());
-    auto* ifExpression = dynamic_cast<IfExpression*>(expression.get());
+    Expression* expression = getAndCheckExpressionStatement(program->statements.front());
+    auto* ifExpression = dynamic_cast<IfExpression*>(expression);
     CHECK(ifExpression != nullptr);
-    CHECK(ifExpression->token != nullptr);
-    CHECK_EQUAL(Token::IF, (ifExpression->token->type));
-    CHECK_EQUAL("if", *ifExpression->token->literal);
     CHECK(ifExpression->condition != nullptr);
     CHECK_EQUAL("(x < y)", ifExpression->condition->string());
     CHECK_EQUAL("x\n", ifExpression->consequence->string());
@@ -512,30 +553,40 @@ TEST(ParserTest, parseFunctionLiteral)
     auto program = parser.parseProgram();
     CHECK_EQUAL_TEXT(0, parser.errors.size(), parser.errors[0].c_str());
     CHECK_EQUAL(1, program.get()->statements.size());
-    std::shared_ptr<Expression> expression = getAndCheckExpressionStatement(program->statements.front());
-    auto* fnExpression = dynamic_cast<Function*>(expression.get());
+    Expression* expression = getAndCheckExpressionStatement(program->statements.front());
+    auto* fnExpression = dynamic_cast<Function*>(expression);
     CHECK(fnExpression != nullptr);
-    CHECK(fnExpression->token != nullptr);
-    CHECK_EQUAL(Token::FUNCTION, fnExpression->token->type);
     CHECK(fnExpression->body != nullptr);
     CHECK_EQUAL("(x + y)\n", fnExpression->body->string());
     CHECK_EQUAL(2, fnExpression->parameters.size());
-    CHECK_EQUAL("x", *fnExpression->parameters[0]->value);
-    CHECK_EQUAL("y", *fnExpression->parameters[1]->value);
+    CHECK_EQUAL("x", std::string(fnExpression->parameters[0]->value));
+    CHECK_EQUAL("y", std::string(fnExpression->parameters[1]->value));
     CHECK_EQUAL("fn(x, y) { (x + y)\n }", fnExpression->string());
 }
 
+TEST(ParserTest, identifierSymbols)
+{
+    auto parser = createParser("fn(x, y) { x + y; }");
+    auto program = parser.parseProgram();
+    Expression* expression = getAndCheckExpressionStatement(program->statements.front());
+    auto* fnExpression = dynamic_cast<Function*>(expression);
+    CHECK(fnExpression != nullptr);
+    auto& x = *fnExpression->parameters[0];
+    auto& y = *fnExpression->parameters[1];
+    CHECK(x.symbol != y.symbol);
+    CHECK_EQUAL("x", std::string(SymbolTable::global().name(x.symbol)));
+    CHECK_EQUAL("y", std::string(SymbolTable::global().name(y.symbol)));
+}
+
 TEST(ParserTest, parseFunctionLiteralNoParameters)
 {
     auto parser = createParser("fn() { return 10; }");
     auto program = parser.parseProgram();
     CHECK_EQUAL_TEXT(0, parser.errors.size(), parser.errors[0].c_str());
     CHECK_EQUAL(1, program.get()->statements.size());
-    std::shared_ptr<Expression> expression = getAndCheckExpressionStatement(program->statements.front());
-    auto* fnExpression = dynamic_cast<Function*>(expression.get());
+    Expression* expression = getAndCheckExpressionStatement(program->statements.front());
+    auto* fnExpression = dynamic_cast<Function*>(expression);
     CHECK(fnExpression != nullptr);
-    CHECK(fnExpression->token != nullptr);
-    CHECK_EQUAL(Token::FUNCTION, fnExpression->token->type);
     CHECK_EQUAL(0, fnExpression->parameters.size());
     CHECK_EQUAL("fn() { return 10;\n }", fnExpression->string());
 }
@@ -546,11 +597,9 @@ TEST(ParserTest, parseFunctionLiteralOneParameter)
     auto program = parser.parseProgram();
     CHECK_EQUAL_TEXT(0, parser.errors.size(), parser.errors[0].c_str());
     CHECK_EQUAL(1, program.get()->statements.size());
-    std::shared_ptr<Expression> expression = getAndCheckExpressionStatement(program->statements.front());
-    auto* fnExpression = dynamic_cast<Function*>(expression.get());
+    Expression* expression = getAndCheckExpressionStatement(program->statements.front());
+    auto* fnExpression = dynamic_cast<Function*>(expression);
     CHECK(fnExpression != nullptr);
-    CHECK(fnExpression->token != nullptr);
-    CHECK_EQUAL(Token::FUNCTION, fnExpression->token->type);
     CHECK_EQUAL(1, fnExpression->parameters.size());
     CHECK_EQUAL(std::string("fn(x) { return (10 * x);\n }"), fnExpression->string());
 }
@@ -561,14 +610,12 @@ TEST(ParserTest, parseCallExpressionNoArguments)
     auto program = parser.parseProgram();
     CHECK_EQUAL_TEXT(0, parser.errors.size(), parser.errors[0].c_str());
     CHECK_EQUAL(1, program.get()->statements.size());
-    std::shared_ptr<Expression> expression = getAndCheckExpressionStatement(program->statements.front());
-    auto* callExpression = dynamic_cast<CallExpression*>(expression.get());
+    Expression* expression = getAndCheckExpressionStatement(program->statements.front());
+    auto* callExpression = dynamic_cast<CallExpression*>(expression);
     CHECK(callExpression != nullptr);
-    CHECK_EQUAL(Token::LPAREN, callExpression->token->type);
-    auto* identifier = dynamic_cast<Identifier*>(callExpression->function.get());
+    auto* identifier = dynamic_cast<Identifier*>(callExpression->function);
     CHECK(identifier != nullptr);
-    CHECK_EQUAL(Token::IDENTIFIER, (identifier->token->type));
-    CHECK_EQUAL(std::string("add"), *identifier->value);
+    CHECK_EQUAL(std::string("add"), std::string(identifier->value));
     CHECK_EQUAL(std::string("add()"), expression->string());
 }
 
@@ -578,31 +625,301 @@ TEST(ParserTest, parseCallExpressionWithArguments)
     auto program = parser.parseProgram();
     CHECK_EQUAL_TEXT(0, parser.errors.size(), parser.errors[0].c_str());
     CHECK_EQUAL(1, program.get()->statements.size());
-    std::shared_ptr<Expression> expression = getAndCheckExpressionStatement(program->statements.front());
-    auto* callExpression = dynamic_cast<CallExpression*>(expression.get());
+    Expression* expression = getAndCheckExpressionStatement(program->statements.front());
+    auto* callExpression = dynamic_cast<CallExpression*>(expression);
     CHECK(callExpression != nullptr);
-    CHECK_EQUAL(Token::LPAREN, callExpression->token->type);
-    auto* identifier = dynamic_cast<Identifier*>(callExpression->function.get());
+    auto* identifier = dynamic_cast<Identifier*>(callExpression->function);
     CHECK(identifier != nullptr);
-    CHECK_EQUAL(Token::IDENTIFIER, (identifier->token->type));
-    CHECK_EQUAL(std::string("calculate"), *identifier->value);
+    CHECK_EQUAL(std::string("calculate"), std::string(identifier->value));
     CHECK_EQUAL(3, callExpression->arguments.size());
     checkIntegerExpression(callExpression->arguments[0], 1);
-    auto* infix = dynamic_cast<InfixExpression*>(callExpression->arguments[1].get());
+    auto* infix = dynamic_cast<InfixExpression*>(callExpression->arguments[1]);
     CHECK(infix != nullptr);
     checkIntegerExpression(infix->left, 2);
-    CHECK_EQUAL(std::string("+"), infix->op);
+    CHECK_EQUAL(std::string("+"), std::string(Token::getLiteral(infix->op)));
     checkIntegerExpression(infix->right, 3);
     CHECK_EQUAL(std::string("(2 + 3)"), infix->string());
-    infix = dynamic_cast<InfixExpression*>(callExpression->arguments[2].get());
+    infix = dynamic_cast<InfixExpression*>(callExpression->arguments[2]);
     CHECK(infix != nullptr);
     checkIntegerExpression(infix->left, 4);
-    CHECK_EQUAL(std::string("*"), infix->op);
+    CHECK_EQUAL(std::string("*"), std::string(Token::getLiteral(infix->op)));
     checkIntegerExpression(infix->right, 5);
     CHECK_EQUAL(std::string("(4 * 5)"), infix->string());
     CHECK_EQUAL(std::string("calculate(1, (2 + 3), (4 * 5))"), expression->string());
 }
 
+TEST(ParserTest, errorInsideListIsDiscarded)
+{
+    auto program = parse("let a = f(fn(x, y) { 1 }, if); g(2, 3);");
+    LONGS_EQUAL(1, program->statements.size());
+    auto* call = dynamic_cast<CallExpression*>(getAndCheckExpressionStatement(program->statements.front()));
+    CHECK(call != nullptr);
+    LONGS_EQUAL(2, call->arguments.size());
+    checkIntegerExpression(call->arguments[0], 2);
+}
+
+TEST(ParserTest, largeProgramTakesFewBlocks)
+{
+    std::string input;
+    for (int i = 0; i < 100000; ++i)
+    {
+        input += "let x = f(1 + 2, -y) * 3;";
+    }
+    auto program = parse(input);
+    LONGS_EQUAL(100000, program->statements.size());
+    CHECK(program->arena.blockCount() <= 16);
+}
+
+TEST(ParserTest, deeplyNestedExpressions)
+{
+    const int depth = 100000;
+    auto lexer = Lexer((std::string(depth, '(') + "1" + std::string(depth, ')') + "; " +
+                        std::string(depth, '-') + "x;").c_str());
+    auto parser = Parser(lexer);
+    auto program = parser.parseProgram();
+    LONGS_EQUAL(0, parser.errors.size());
+    LONGS_EQUAL(2, program->statements.size());
+    checkIntegerExpression(getAndCheckExpressionStatement(program->statements[0]), 1);
+
+    auto expression = getAndCheckExpressionStatement(program->statements[1]);
+    int prefixes = 0;
+    while (auto* prefix = dynamic_cast<PrefixExpression*>(expression))
+    {
+        ++prefixes;
+        expression = prefix->right;
+    }
+    LONGS_EQUAL(depth, prefixes);
+    CHECK(dynamic_cast<Identifier*>(expression) != nullptr);
+}
+
+TEST(ParserTest, deeplyNestedBlocks)
+{
+    const int depth = 20000;
+    std::string input;
+    for (int i = 0; i < depth; ++i)
+    {
+        input += "fn(x) { if (x) { ";
+    }
+    input += "1";
+    for (int i = 0; i < depth; ++i)
+    {
+        input += " } }";
+    }
+    auto lexer = Lexer(input.c_str());
+    auto parser = Parser(lexer);
+    auto program = parser.parseProgram();
+    LONGS_EQUAL(0, parser.errors.size());
+    LONGS_EQUAL(1, program->statements.size());
+}
+
+TEST(ParserTest, nestingLimitIsReported)
+{
+    auto lexer = Lexer((std::string(1000, '(') + "1" + std::string(1000, ')') + "; 5;").c_str());
+    auto parser = Parser(lexer);
+    parser.setNestingLimit(100);
+    auto program = parser.parseProgram();
+    LONGS_EQUAL(1, parser.errors.size());
+    CHECK_EQUAL(std::string("Nesting too deep at LPAREN token (()"), parser.errors[0]);
+    LONGS_EQUAL(1, program->statements.size());
+    checkIntegerExpression(getAndCheckExpressionStatement(program->statements.front()), 5);
+}
+
+TEST(ParserTest, errorInsideBlockSkipsStatement)
+{
+    auto lexer = Lexer("fn() { ) ; 2 };");
+    auto parser = Parser(lexer);
+    auto program = parser.parseProgram();
+    LONGS_EQUAL(1, parser.errors.size());
+    CHECK_EQUAL(std::string("No prefix parse function for RPAREN found"), parser.errors[0]);
+    LONGS_EQUAL(1, program->statements.size());
+    auto* function = dynamic_cast<Function*>(getAndCheckExpressionStatement(program->statements.front()));
+    CHECK(function != nullptr);
+    CHECK_EQUAL(std::string("2\n"), function->body->string());
+}
+
+TEST(ParserTest, nextStatementReturnsEachStatement)
+{
+    auto lexer = Lexer("let a = 1; let b 2; a + b;");
+    auto parser = Parser(lexer);
+    auto first = parser.nextStatement();
+    LONGS_EQUAL(1, first->statements.size());
+    checkLetStatement(first->statements.front(), "a");
+    auto second = parser.nextStatement();
+    LONGS_EQUAL(1, second->statements.size());
+    CHECK_EQUAL(std::string("(a + b)"), second->statements.front()->string());
+    CHECK(parser.nextStatement() == nullptr);
+    LONGS_EQUAL(1, parser.errors.size());
+    CHECK(parser.diagnostics() == std::vector<std::string>{"1:18: Expected ASSIGN token. Got INT token (2)"});
+}
+
+TEST(ParserTest, nextStatementDropsReadTokens)
+{
+    std::string input;
+    for (int i = 0; i < 2000; ++i)
+    {
+        input += i % 10 == 0 ? "let x 5;\n" : "let value = fn(x) { x * 2 + 1 }(3);\n";
+    }
+    auto sequentialLexer = Lexer(input.c_str());
+    auto sequentialParser = Parser(sequentialLexer);
+    auto expected = sequentialParser.parseProgram();
+
+    // Read the input in small chunks, so that chunks are dropped with the tokens
+    size_t offset = 0;
+    auto lexer = StreamingLexer([&](char* buffer, size_t size)
+    {
+        size = std::min(size, input.size() - offset);
+        input.copy(buffer, size, offset);
+        offset += size;
+        return size;
+    }, 256);
+    auto parser = Parser(lexer);
+    std::string actual;
+    size_t statements = 0;
+    while (auto program = parser.nextStatement())
+    {
+        actual += program->string();
+        statements += program->statements.size();
+    }
+    LONGS_EQUAL(expected->statements.size(), statements);
+    CHECK_EQUAL(expected->string(), actual);
+    CHECK(sequentialParser.diagnostics() == parser.diagnostics());
+    CHECK_EQUAL(sequentialParser.errors[199], parser.errors[199]);
+}
+
+TEST(ParserTest, checkOnlyKeepsNoNodes)
+{
+    const char* input = "let a = 1; let b 2; let f = fn(x) { x +; x }; f(a, if (a) { b } else { -a });";
+    auto lexer = Lexer(input);
+    auto parser = Parser(lexer);
+    parser.setCheckOnly(true);
+    auto program = parser.parseProgram();
+    LONGS_EQUAL(0, program->statements.size());
+    LONGS_EQUAL(0, program->arena.bytesUsed());
+
+    auto fullLexer = Lexer(input);
+    auto fullParser = Parser(fullLexer);
+    fullParser.parseProgram();
+    LONGS_EQUAL(2, fullParser.errors.size());
+    CHECK(fullParser.diagnostics() == parser.diagnostics());
+}
+
+TEST(ParserTest, lazyFunctionBodiesAreParsedOnDemand)
+{
+    const char* input = "let f = fn(x) { let y = x * 2; fn(z) { y + z } };\nf(1)(2);";
+    auto eagerLexer = Lexer(input);
+    auto eager = Parser(eagerLexer).parseProgram();
+
+    auto lexer = Lexer(input);
+    auto parser = Parser(lexer);
+    parser.setLazyFunctionBodies(true);
+    auto program = parser.parseProgram();
+    LONGS_EQUAL(0, parser.errors.size());
+    LONGS_EQUAL(2, program->statements.size());
+    auto function = dynamic_cast<Function*>(dynamic_cast<LetStatement*>(program->statements[0])->expression);
+    CHECK(function->body == nullptr);
+    CHECK(function->lazyBody != nullptr);
+    CHECK(program->arena.bytesUsed() < eager->arena.bytesUsed());
+
+    // The inner function is only matched when the outer body is parsed
+    auto body = dynamic_cast<BlockStatement*>(function->getBody());
+    CHECK(function->lazyBody == nullptr);
+    LONGS_EQUAL(2, body->statements.size());
+    auto inner = dynamic_cast<Function*>(dynamic_cast<ExpressionStatement*>(body->statements[1])->expression);
+    CHECK(inner->lazyBody != nullptr);
+    CHECK_EQUAL(eager->string(), program->string());
+    CHECK(program->bodyDiagnostics.empty());
+
+    // The nodes of the body have the symbols of the first parse
+    auto let = dynamic_cast<LetStatement*>(body->statements[0]);
+    auto eagerFunction = dynamic_cast<Function*>(dynamic_cast<LetStatement*>(eager->statements[0])->expression);
+    auto eagerLet = dynamic_cast<LetStatement*>(dynamic_cast<BlockStatement*>(eagerFunction->body)->statements[0]);
+    LONGS_EQUAL(eagerLet->identifier->symbol, let->identifier->symbol);
+}
+
+TEST(ParserTest, lazyFunctionBodyErrorsAreDeferred)
+{
+    auto lexer = Lexer("let f = fn() { let = 1; 2 };\nf();");
+    auto parser = Parser(lexer);
+    parser.setLazyFunctionBodies(true);
+    auto program = parser.parseProgram();
+    LONGS_EQUAL(0, parser.errors.size());
+    LONGS_EQUAL(2, program->statements.size());
+
+    auto function = dynamic_cast<Function*>(dynamic_cast<LetStatement*>(program->statements[0])->expression);
+    CHECK_EQUAL(std::string("2\n"), function->getBody()->string());
+    CHECK(program->bodyDiagnostics == std::vector<std::string>{"1:20: Expected IDENTIFIER token. Got ASSIGN token (=)"});
+}
+
+TEST(ParserTest, lazyFunctionBodyWithUnmatchedBracketsIsParsedAtOnce)
+{
+    const char* input = "let f = fn() { (1 }; 2;";
+    auto eagerLexer = Lexer(input);
+    auto eagerParser = Parser(eagerLexer);
+    eagerParser.parseProgram();
+
+    auto lexer = Lexer(input);
+    auto parser = Parser(lexer);
+    parser.setLazyFunctionBodies(true);
+    auto program = parser.parseProgram();
+    CHECK(program->lazyBodies.empty());
+    CHECK(eagerParser.diagnostics() == parser.diagnostics());
+}
+
+TEST(ParserTest, lazyFunctionBodiesMoveWithTheirNodes)
+{
+    auto source = std::make_shared<const SourceBuffer>("let f = fn(x) { x + 1 };");
+    auto program = std::make_shared<Program>();
+    {
+        auto lexer = Lexer(source);
+        auto parser = Parser(lexer);
+        parser.setLazyFunctionBodies(true);
+        auto statement = parser.nextStatement();
+        program->append(*statement);
+    }
+    source.reset();
+    LONGS_EQUAL(1, program->lazyBodies.size());
+    CHECK(program->lazyBodies[0]->program == program.get());
+    CHECK_EQUAL(std::string("let f = fn(x) { (x + 1)\n };\n"), program->string());
+}
+
+TEST(ParserTest, lazyFunctionBodiesOverStreamedChunks)
+{
+    std::string input;
+    for (int i = 0; i < 200; ++i)
+    {
+        input += i % 10 == 0 ? "let g = fn() { let = 1; 2 };\n" : "let f = fn(x) { let y = x * 2; fn(z) { y + z } };\n";
+    }
+    auto fullLexer = Lexer(input.c_str());
+    auto fullParser = Parser(fullLexer);
+    fullParser.setLazyFunctionBodies(true);
+    auto expected = fullParser.parseProgram();
+
+    // The bodies are read again from chunks that start far into the input
+    size_t offset = 0;
+    auto lexer = StreamingLexer([&](char* buffer, size_t size)
+    {
+        size = std::min(size, input.size() - offset);
+        input.copy(buffer, size, offset);
+        offset += size;
+        return size;
+    }, 64);
+    auto parser = Parser(lexer);
+    parser.setLazyFunctionBodies(true);
+    auto program = parser.parseProgram();
+    CHECK(program->lazyBodies.size() > 100);
+    CHECK_EQUAL(expected->string(), program->string());
+
+    // A body cut by a chunk boundary is parsed eagerly, so its error is a
+    // parser error rather than a body diagnostic
+    auto diagnostics = parser.diagnostics();
+    diagnostics.insert(diagnostics.end(), program->bodyDiagnostics.begin(), program->bodyDiagnostics.end());
+    std::sort(diagnostics.begin(), diagnostics.end());
+    auto expectedDiagnostics = expected->bodyDiagnostics;
+    std::sort(expectedDiagnostics.begin(), expectedDiagnostics.end());
+    LONGS_EQUAL(20, diagnostics.size());
+    CHECK(expectedDiagnostics == diagnostics);
+}
+
 int main(int ac, char** av)
 {
     return CommandLineTestRunner::RunAllTests(ac, av);
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <system_error>
+#include <vector>
+#include <unistd.h>
+#include <SourceBuffer.h>
+#include <Lexer.h>
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+TEST_GROUP(SourceBufferTest)
+{
+    std::string filename;
+
+    void setup() override
+    {
+        filename = "source_buffer_test.monkey";
+    }
+
+    void teardown() override
+    {
+        std::remove(filename.c_str());
+    }
+
+    void writeFile(const std::string& content) const
+    {
+        std::ofstream file(filename, std::ios::binary);
+        file << content;
+    }
+
+    void checkFile(const std::string& content) const
+    {
+        writeFile(content);
+        auto buffer = SourceBuffer::fromFile(filename);
+        CHECK_EQUAL(content.size(), buffer->size());
+        CHECK(content == buffer->text());
+        CHECK_EQUAL(0, buffer->data()[buffer->size()]);
+    }
+};
+
+TEST(SourceBufferTest, fromString)
+{
+    SourceBuffer buffer("let x = 5;");
+    CHECK_EQUAL(10, buffer.size());
+    CHECK(std::string("let x = 5;") == buffer.text());
+    CHECK_EQUAL(0, buffer.data()[buffer.size()]);
+}
+
+TEST(SourceBufferTest, emptyBuffer)
+{
+    SourceBuffer buffer;
+    CHECK_EQUAL(0, buffer.size());
+    CHECK_EQUAL(0, buffer.data()[0]);
+}
+
+TEST(SourceBufferTest, fromFile)
+{
+    checkFile("let x = 5;\n");
+}
+
+TEST(SourceBufferTest, fromEmptyFile)
+{
+    checkFile("");
+}
+
+// A file that ends on a page boundary must still be followed by a zero byte
+TEST(SourceBufferTest, fromFileOfPageSize)
+{
+    auto pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    checkFile(std::string(pageSize, 'x'));
+    checkFile(std::string(2 * pageSize, ' '));
+}
+
+TEST(SourceBufferTest, fromMissingFile)
+{
+    bool thrown = false;
+    try
+    {
+        SourceBuffer::fromFile("no_such_file.monkey");
+    }
+    catch (std::system_error&)
+    {
+        thrown = true;
+    }
+    CHECK_TRUE(thrown);
+}
+
+TEST(SourceBufferTest, lexFromFile)
+{
+    writeFile("let five = 5;");
+    Lexer lexer(SourceBuffer::fromFile(filename));
+    std::vector<Token::TokenType> expected {Token::LET, Token::IDENTIFIER, Token::ASSIGN, Token::INT,
+                                            Token::SEMICOLON, Token::ENDOFFILE};
+    for (auto type : expected)
+    {
+        auto token = lexer.nextToken();
+        CHECK_EQUAL(type, token->type);
+    }
+}
+
+TEST(SourceBufferTest, location)
+{
+    SourceBuffer source("let a = 1;\nlet bb = 2;\n\n  x");
+    CHECK_EQUAL(1, source.location(0).line);
+    CHECK_EQUAL(1, source.location(0).column);
+    CHECK_EQUAL(1, source.location(10).line);
+    CHECK_EQUAL(11, source.location(10).column);
+    CHECK_EQUAL(2, source.location(15).line);
+    CHECK_EQUAL(5, source.location(15).column);
+    CHECK_EQUAL(4, source.location(26).line);
+    CHECK_EQUAL(3, source.location(26).column);
+    // The end of the text, where the EOF token is
+    CHECK_EQUAL(4, source.location(27).line);
+    CHECK_EQUAL(4, source.location(27).column);
+}
+
+TEST(SourceBufferTest, locationWithStartLocation)
+{
+    SourceBuffer source("ab\ncd");
+    source.setStartLocation({7, 5});
+    CHECK_EQUAL(7, source.location(1).line);
+    CHECK_EQUAL(6, source.location(1).column);
+    CHECK_EQUAL(8, source.location(4).line);
+    CHECK_EQUAL(2, source.location(4).column);
+}
+
+int main(int ac, char** av)
+{
+    return CommandLineTestRunner::RunAllTests(ac, av);
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <Evaluator.h>
+#include <Lexer.h>
+#include <Parser.h>
+#include <StreamingEvaluator.h>
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+TEST_GROUP(StreamingEvaluatorTest)
+{
+    void setup() override {}
+    void teardown() override {}
+
+    // The values of the statements, with "-" for those that have none
+    static std::vector<std::string> evaluate(const char* input)
+    {
+        auto lexer = Lexer(input);
+        auto parser = Parser(lexer);
+        auto evaluator = StreamingEvaluator(parser);
+        std::vector<std::string> values;
+        while (evaluator.step())
+        {
+            values.push_back(evaluator.result() != nullptr ? evaluator.result()->inspect() : "-");
+        }
+        CHECK(evaluator.result() == nullptr);
+        return values;
+    }
+};
+
+TEST(StreamingEvaluatorTest, valueOfEachStatement)
+{
+    std::vector<std::string> expected {"10", "-", "false", "20"};
+    CHECK(expected == evaluate("5 * 2; let x = 1; !true; if (1 > 2) { 10 } else { 20 };"));
+}
+
+TEST(StreamingEvaluatorTest, failedStatementsAreSkipped)
+{
+    std::vector<std::string> expected {"1", "3"};
+    CHECK(expected == evaluate("1; let 2; 3;"));
+}
+
+TEST(StreamingEvaluatorTest, returnEndsProgram)
+{
+    std::vector<std::string> expected {"1", "2"};
+    CHECK(expected == evaluate("1; return 2; 3; return 4;"));
+}
+
+TEST(StreamingEvaluatorTest, unsupportedStatementsHaveNoValue)
+{
+    // Identifiers, functions and calls are not evaluated yet, nor blocks
+    // without a value
+    std::vector<std::string> expected {"-", "-", "-", "-", "-", "4", "5"};
+    CHECK(expected == evaluate("let f = fn(x) { x }; f(1); 1 + x; -fn() { 2 }; if (true) { let a = 3; };\n"
+                               "if (true) { let a = b; 4 }; 5;"));
+}
+
+TEST(StreamingEvaluatorTest, unsupportedReturnEndsProgram)
+{
+    std::vector<std::string> expected {"1", "-"};
+    CHECK(expected == evaluate("1; return f(2); 3;"));
+}
+
+TEST(StreamingEvaluatorTest, emptyProgram)
+{
+    CHECK(evaluate("").empty());
+}
+
+TEST(StreamingEvaluatorTest, statementIsReleasedAfterEvaluation)
+{
+    auto lexer = Lexer("1 + 2; 3 * 4;");
+    auto parser = Parser(lexer);
+    auto evaluator = Evaluator();
+    std::weak_ptr<Program> previous;
+    while (auto statement = parser.nextStatement())
+    {
+        CHECK(previous.expired());
+        evaluator.eval(statement);
+        previous = statement;
+    }
+    CHECK(previous.expired());
+}
+
+int main(int ac, char** av)
+{
+    return CommandLineTestRunner::RunAllTests(ac, av);
+}
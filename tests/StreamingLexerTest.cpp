@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <Lexer.h>
+#include <Parser.h>
+#include <StreamingLexer.h>
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+// Hands out the input at most maxRead bytes at a time
+class StringReader
+{
+public:
+    StringReader(std::string input, size_t maxRead) : input(std::move(input)), position(0), maxRead(maxRead) {}
+
+    size_t operator()(char *buffer, size_t size)
+    {
+        auto count = std::min({size, maxRead, input.size() - position});
+        std::memcpy(buffer, input.data() + position, count);
+        position += count;
+        return count;
+    }
+
+private:
+    std::string input;
+    size_t position;
+    size_t maxRead;
+};
+
+TEST_GROUP(StreamingLexerTest)
+{
+    void setup() override {}
+    void teardown() override {}
+
+    static std::vector<Token> tokenize(Lexer& lexer)
+    {
+        std::vector<Token> tokens;
+        for (auto token = lexer.nextToken(); token != nullptr; token = lexer.nextToken())
+        {
+            tokens.push_back(*token);
+        }
+        return tokens;
+    }
+
+    // Compare the tokens with the ones from the ordinary lexer for a range of
+    // chunk and read sizes, so that tokens are split at every position
+    static void checkSameTokens(const std::string& input)
+    {
+        Lexer lexer(input.c_str());
+        auto expected = tokenize(lexer);
+
+        for (size_t chunkSize = 1; chunkSize <= 9; ++chunkSize)
+        {
+            for (size_t maxRead : {static_cast<size_t>(1), static_cast<size_t>(3), chunkSize})
+            {
+                StreamingLexer streamingLexer(StringReader(input, maxRead), chunkSize);
+                auto actual = tokenize(streamingLexer);
+                CHECK_EQUAL(expected.size(), actual.size());
+                for (size_t i = 0; i < expected.size(); ++i)
+                {
+                    CHECK_EQUAL(expected[i].type, actual[i].type);
+                    CHECK_EQUAL(std::string(expected[i].literal), std::string(actual[i].literal));
+                }
+            }
+        }
+    }
+};
+
+TEST(StreamingLexerTest, emptyInput)
+{
+    StreamingLexer lexer(StringReader("", 10));
+    auto token = lexer.nextToken();
+    CHECK_EQUAL(Token::ENDOFFILE, token->type);
+    POINTERS_EQUAL(nullptr, lexer.nextToken().get());
+}
+
+TEST(StreamingLexerTest, tokensAcrossChunks)
+{
+    checkSameTokens("let five = 5;");
+    checkSameTokens("a==b != !c = d");
+    checkSameTokens("longidentifier_that_spans_many_chunks 1234567890123 x");
+    checkSameTokens("  \t\n  fn(x, y) { return x + y; }  \n");
+    checkSameTokens("if (a < b) { true } else { false } ? end");
+}
+
+TEST(StreamingLexerTest, tokensKeepTheirChunk)
+{
+    StreamingLexer lexer(StringReader("alpha beta gamma delta", 2), 4);
+    auto tokens = tokenize(lexer);
+    CHECK_EQUAL(5, tokens.size());
+    CHECK_EQUAL("alpha", std::string(tokens[0].literal));
+    CHECK_EQUAL("delta", std::string(tokens[3].literal));
+}
+
+TEST(StreamingLexerTest, tokenizeAllAcrossChunks)
+{
+    std::string input("let x = 10;\nlet yy = x * 20;");
+    StreamingLexer lexer(StringReader(input, 5), 8);
+    auto tokens = lexer.tokenizeAll();
+    CHECK_EQUAL(13, tokens.size());
+    CHECK_EQUAL("yy", std::string(tokens.literal(6)));
+    CHECK_EQUAL(16, tokens.offset(6));
+    CHECK_EQUAL("20", std::string(tokens.literal(10)));
+    CHECK_EQUAL(25, tokens.offset(10));
+    CHECK_EQUAL(Token::ENDOFFILE, tokens.type(12));
+}
+
+TEST(StreamingLexerTest, parseStream)
+{
+    std::string input("let x = 5 * (3 + y); fn(a, b) { a + b }; if (x < 10) { x } else { !y };");
+    Lexer lexer(input.c_str());
+    Parser parser(lexer);
+    auto expected = parser.parseProgram()->string();
+
+    StreamingLexer streamingLexer(StringReader(input, 7), 16);
+    Parser streamingParser(streamingLexer);
+    auto program = streamingParser.parseProgram();
+    CHECK_EQUAL(0, streamingParser.errors.size());
+    CHECK_EQUAL(expected, program->string());
+}
+
+TEST(StreamingLexerTest, locationsAcrossChunks)
+{
+    std::string input("let x = 10;\n  let yy = x * 20;\nyy");
+    auto expected = Lexer(std::make_shared<const SourceBuffer>(input)).tokenizeAll();
+    for (size_t chunkSize = 1; chunkSize <= 9; ++chunkSize)
+    {
+        StreamingLexer lexer(StringReader(input, 3), chunkSize);
+        auto tokens = lexer.tokenizeAll();
+        CHECK_EQUAL(expected.size(), tokens.size());
+        for (size_t i = 0; i < tokens.size(); ++i)
+        {
+            CHECK_EQUAL(expected.location(i).line, tokens.location(i).line);
+            CHECK_EQUAL(expected.location(i).column, tokens.location(i).column);
+        }
+    }
+}
+
+TEST(StreamingLexerTest, longTokenGrowsChunk)
+{
+    std::string input(1 << 20, 'a');
+    input += " b";
+    size_t reads = 0;
+    StringReader reader(input, SIZE_MAX);
+    StreamingLexer lexer([&reads, &reader](char* buffer, size_t size)
+                         {
+                             ++reads;
+                             return reader(buffer, size);
+                         }, 16);
+    auto tokens = lexer.tokenizeAll();
+    CHECK_EQUAL(3, tokens.size());
+    CHECK_EQUAL(1 << 20, tokens.length(0));
+    CHECK_EQUAL("b", std::string(tokens.literal(1)));
+    CHECK_EQUAL((1 << 20) + 1, tokens.offset(1));
+
+    // The chunk doubles each time the token is read again
+    CHECK(reads < 32);
+}
+
+TEST(StreamingLexerTest, shortReadsKeepSmallChunks)
+{
+    // As from a producer that writes a line at a time
+    std::string input;
+    for (int i = 0; i < 500; ++i)
+    {
+        input += "let x = " + std::to_string(i) + ";\n";
+    }
+    StreamingLexer lexer(StringReader(input, 16));
+    auto tokens = lexer.tokenizeAll();
+    CHECK_EQUAL(2501, tokens.size());
+
+    size_t allocated = 0;
+    const SourceBuffer* last = nullptr;
+    for (size_t i = 0; i < tokens.size(); ++i)
+    {
+        if (tokens.source(i).get() != last)
+        {
+            last = tokens.source(i).get();
+            allocated += last->allocatedSize();
+        }
+    }
+    CHECK(allocated < 3 * input.size());
+}
+
+TEST(StreamingLexerTest, readErrorIsReported)
+{
+    // Reading a directory fails with EISDIR
+    int fd = open(".", O_RDONLY);
+    CHECK(fd >= 0);
+    StreamingLexer lexer(StreamingLexer::fileDescriptorReader(fd));
+    bool thrown = false;
+    try
+    {
+        lexer.tokenizeAll();
+    }
+    catch (std::system_error&)
+    {
+        thrown = true;
+    }
+    close(fd);
+    CHECK(thrown);
+}
+
+TEST(StreamingLexerTest, offsetsPast4GiB)
+{
+    // As for a chunk of a stream far into its input
+    size_t base = (size_t(5) << 30) + 3;
+    TokenBuffer tokens;
+    tokens.addSource(std::make_shared<const SourceBuffer>("let x"), base);
+    tokens.add(Token::LET, base, 3);
+    tokens.add(Token::IDENTIFIER, base + 4, 1);
+    CHECK_EQUAL(base + 4, tokens.offset(1));
+    CHECK_EQUAL("x", std::string(tokens.literal(1)));
+
+    bool thrown = false;
+    try
+    {
+        tokens.add(Token::IDENTIFIER, base + 5, size_t(1) << 32);
+    }
+    catch (std::length_error&)
+    {
+        thrown = true;
+    }
+    CHECK(thrown);
+    CHECK_EQUAL(2, tokens.size());
+}
+
+int main(int ac, char** av)
+{
+    return CommandLineTestRunner::RunAllTests(ac, av);
+}
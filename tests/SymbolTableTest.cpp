@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include <string>
+#include <SymbolTable.h>
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+TEST_GROUP(SymbolTableTest)
+{
+    void setup() override {}
+    void teardown() override {}
+};
+
+TEST(SymbolTableTest, denseSymbols)
+{
+    SymbolTable table;
+    CHECK_EQUAL(0, table.intern("x"));
+    CHECK_EQUAL(1, table.intern("y"));
+    CHECK_EQUAL(0, table.intern("x"));
+    CHECK_EQUAL(2, table.intern("xy"));
+    CHECK_EQUAL(3, table.size());
+}
+
+TEST(SymbolTableTest, namesAreCopied)
+{
+    SymbolTable table;
+    std::string name("value");
+    auto symbol = table.intern(name);
+    name = "other";
+    CHECK_EQUAL("value", std::string(table.name(symbol)));
+    CHECK_EQUAL(symbol, table.intern("value"));
+}
+
+TEST(SymbolTableTest, manyNames)
+{
+    SymbolTable table;
+    for (int i = 0; i < 100000; ++i)
+    {
+        CHECK_EQUAL(i, table.intern("name_" + std::to_string(i)));
+    }
+    for (int i = 0; i < 100000; i += 997)
+    {
+        auto name = "name_" + std::to_string(i);
+        CHECK_EQUAL(i, table.intern(name));
+        CHECK_EQUAL(name, std::string(table.name(i)));
+    }
+}
+
+TEST(SymbolTableTest, longNames)
+{
+    SymbolTable table;
+    std::string longName(200000, 'a');
+    auto a = table.intern("a");
+    auto symbol = table.intern(longName);
+    auto b = table.intern("b");
+    CHECK_EQUAL(longName, std::string(table.name(symbol)));
+    CHECK_EQUAL("a", std::string(table.name(a)));
+    CHECK_EQUAL("b", std::string(table.name(b)));
+}
+
+int main(int ac, char** av)
+{
+    return CommandLineTestRunner::RunAllTests(ac, av);
+}
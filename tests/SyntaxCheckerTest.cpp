@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include "Lexer.h"
+#include "Parser.h"
+#include "SyntaxChecker.h"
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+TEST_GROUP(SyntaxCheckerTest)
+{
+    std::string directory;
+
+    void setup() override
+    {
+        char name[] = "/tmp/syntax_checker_test_XXXXXX";
+        directory = mkdtemp(name);
+    }
+
+    void teardown() override
+    {
+        std::filesystem::remove_all(directory);
+    }
+
+    std::string writeFile(const std::string& name, const std::string& text) const
+    {
+        auto path = directory + "/" + name;
+        std::ofstream(path) << text;
+        return path;
+    }
+
+    // The diagnostics of a full parse, for comparison
+    static std::vector<std::string> parseDiagnostics(const std::string& text)
+    {
+        Lexer lexer(std::make_shared<const SourceBuffer>(text));
+        Parser parser(lexer);
+        parser.parseProgram();
+        return parser.diagnostics();
+    }
+
+    static void checkSameAsParse(const std::string& text)
+    {
+        auto expected = parseDiagnostics(text);
+        auto actual = SyntaxChecker::checkSource(std::make_shared<const SourceBuffer>(text));
+        CHECK_EQUAL(expected.size(), actual.size());
+        CHECK(expected == actual);
+    }
+};
+
+TEST(SyntaxCheckerTest, validSource)
+{
+    CHECK(SyntaxChecker::checkSource(std::make_shared<const SourceBuffer>(
+            "let f = fn(x, y) { if (x < y) { -x } else { f(y, x) } };\nf(1, 2 * 3);")).empty());
+}
+
+TEST(SyntaxCheckerTest, sameErrorsAsParse)
+{
+    checkSameAsParse("let = 5;\nlet x 5;\n(3 + 4;\n5 + * 2;\nadd(1, 2;\n");
+    checkSameAsParse("let y = 99999999999999999999;\nfn(a, 1) { a };\n");
+    checkSameAsParse("let f = fn() { let = 1; 2 + ; return 3; };\nif (x) { y } else { let ; }\nf(");
+    checkSameAsParse("{ 1 }; ) ; fn(x { x };");
+}
+
+TEST(SyntaxCheckerTest, errorsAfterDroppedTokens)
+{
+    // The check drops the tokens it has passed, so the errors far into a long
+    // source must be located before their tokens go
+    std::string text;
+    for (int i = 0; i < 3000; ++i)
+    {
+        text += i % 500 == 7 ? "let x 1;\n" : "let x = fn(a) { a * (2 + a) };\n";
+    }
+    text += "f(1, ;";
+    checkSameAsParse(text);
+    CHECK_EQUAL(7, SyntaxChecker::checkSource(std::make_shared<const SourceBuffer>(text)).size());
+}
+
+TEST(SyntaxCheckerTest, checkFiles)
+{
+    std::vector<std::string> files;
+    for (int i = 0; i < 20; ++i)
+    {
+        files.push_back(writeFile("file" + std::to_string(i) + ".mk",
+                                  i % 3 == 0 ? "let a = ;\n" : "let a = " + std::to_string(i) + ";\n"));
+    }
+    files.push_back(directory + "/missing.mk");
+
+    auto results = SyntaxChecker::check(files, 4);
+    CHECK_EQUAL(files.size(), results.size());
+    for (int i = 0; i < 20; ++i)
+    {
+        CHECK_EQUAL(files[i], results[i].filename);
+        CHECK(results[i].readable);
+        CHECK_EQUAL(i % 3 != 0, results[i].passed());
+    }
+    CHECK(!results.back().readable);
+    CHECK(!results.back().passed());
+    CHECK_EQUAL(1, results.back().diagnostics.size());
+}
+
+TEST(SyntaxCheckerTest, noFiles)
+{
+    CHECK(SyntaxChecker::check({}, 4).empty());
+}
+
+int main(int ac, char** av)
+{
+    return CommandLineTestRunner::RunAllTests(ac, av);
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2020 Blue Zephyr
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license.  See the LICENSE file for details.
+ *
+ */
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+#include "ThreadPool.h"
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+TEST_GROUP(ThreadPoolTest)
+{
+    void setup() override {}
+    void teardown() override {}
+};
+
+TEST(ThreadPoolTest, runsEachTaskOnce)
+{
+    ThreadPool pool(4);
+    CHECK_EQUAL(4, pool.threadCount());
+    for (size_t count : {0, 1, 3, 100})
+    {
+        std::vector<std::atomic<int>> runs(count);
+        pool.run(count, [&runs](size_t task) { ++runs[task]; });
+        for (const auto& taskRuns : runs)
+        {
+            CHECK_EQUAL(1, taskRuns.load());
+        }
+    }
+}
+
+TEST(ThreadPoolTest, keepsItsThreads)
+{
+    ThreadPool pool(3);
+    std::mutex mutex;
+    std::set<std::thread::id> threads;
+    for (int i = 0; i < 50; ++i)
+    {
+        pool.run(3, [&](size_t)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            threads.insert(std::this_thread::get_id());
+        });
+    }
+
+    // The calling thread and two workers, however often the pool runs
+    CHECK(threads.size() <= 3);
+}
+
+TEST(ThreadPoolTest, callersTakeTurns)
+{
+    ThreadPool pool(2);
+    std::atomic<size_t> total(0);
+    std::vector<std::thread> callers;
+    for (int caller = 0; caller < 4; ++caller)
+    {
+        callers.emplace_back([&]()
+        {
+            for (int i = 0; i < 20; ++i)
+            {
+                pool.run(10, [&total](size_t task) { total += task; });
+            }
+        });
+    }
+    for (auto& caller : callers)
+    {
+        caller.join();
+    }
+    CHECK_EQUAL(4 * 20 * 45, total.load());
+}
+
+TEST(ThreadPoolTest, singleThread)
+{
+    ThreadPool pool(1);
+    CHECK_EQUAL(1, pool.threadCount());
+    size_t sum = 0;
+    pool.run(5, [&sum](size_t task) { sum += task; });
+    CHECK_EQUAL(10, sum);
+}
+
+int main(int ac, char** av)
+{
+    return CommandLineTestRunner::RunAllTests(ac, av);
+}
@@ -27,6 +27,17 @@ TEST(TokenTest, lookUpToken)
     CHECK_EQUAL(Token::RETURN, Token("return").type);
 }
 
+TEST(TokenTest, lookUpIdentifier)
+{
+    CHECK_EQUAL(Token::IDENTIFIER, Token("x").type);
+    CHECK_EQUAL(Token::IDENTIFIER, Token("lets").type);
+    CHECK_EQUAL(Token::IDENTIFIER, Token("le").type);
+    CHECK_EQUAL(Token::IDENTIFIER, Token("fun").type);
+    CHECK_EQUAL(Token::IDENTIFIER, Token("True").type);
+    CHECK_EQUAL(Token::IDENTIFIER, Token("returns").type);
+    CHECK_EQUAL(Token::IDENTIFIER, Token("").type);
+}
+
 TEST(TokenTest, getTypeString)
 {
     CHECK_EQUAL("LET", Token::getTypeString(Token::LET));
@@ -58,6 +69,20 @@ TEST(TokenTest, getTypeString)
     CHECK_EQUAL("RBRACE", Token::getTypeString(Token::RBRACE));
 }
 
+TEST(TokenTest, getLiteral)
+{
+    for (auto type : {Token::LET, Token::FUNCTION, Token::TRUE, Token::FALSE, Token::IF, Token::ELSE, Token::RETURN})
+    {
+        CHECK_EQUAL(type, Token::lookUpType(Token::getLiteral(type)));
+    }
+    CHECK_EQUAL("==", std::string(Token::getLiteral(Token::EQ)));
+    CHECK_EQUAL("!=", std::string(Token::getLiteral(Token::NEQ)));
+    CHECK_EQUAL("*", std::string(Token::getLiteral(Token::ASTERISK)));
+    CHECK_EQUAL("(", std::string(Token::getLiteral(Token::LPAREN)));
+    CHECK(Token::getLiteral(Token::IDENTIFIER).empty());
+    CHECK(Token::getLiteral(Token::INT).empty());
+}
+
 int main(int ac, char** av)
 {
     return CommandLineTestRunner::RunAllTests(ac, av);